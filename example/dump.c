@@ -32,9 +32,8 @@ main (int argc, char *argv[])
 {
         char *filename;
 
-        gchar *orig, *trans;
-        g_autoptr(GHashTable) ht = NULL;
-        GHashTableIter iter;
+        MoFileIter iter;
+        MoEntry entry;
         g_autoptr(MoFile) mofile = NULL;
 
         GError *err = NULL;
@@ -63,20 +62,32 @@ main (int argc, char *argv[])
 
         g_print ("Dumping...\n");
 
-        ht = mo_file_get_translations (mofile, &err);
+        mo_file_iter_init (&iter, mofile);
 
-        if (!ht) {
+        while (mo_file_iter_next (&iter, &entry, &err)) {
+                if (entry.context)
+                        g_print ("Context: '%.*s'\n",
+                                 (int) entry.context_length,
+                                 entry.context);
+
+                g_print ("Orig: '%s'\n", entry.msgid);
+
+                if (entry.msgid_plural)
+                        g_print ("Plural: '%s'\n", entry.msgid_plural);
+
+                for (guint i = 0; i < entry.n_translations; ++i)
+                        g_print ("Translation: '%s'\n",
+                                 mo_entry_get_plural_form (&entry, i, NULL));
+
+                g_print ("\n");
+        }
+
+        if (err) {
                 g_printerr ("Error: File '%s' could not be read: %s\n", filename, err->message);
                 g_error_free (err);
                 return EXIT_FAILURE;
         }
 
-        g_hash_table_iter_init (&iter, ht);
-
-        while (g_hash_table_iter_next (&iter, (gpointer *) &orig, (gpointer *) &trans)) {
-                g_print ("Orig: '%s'\nTranslation: '%s'\n\n", g_strstrip(orig), g_strstrip(trans));
-        }
-
         return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,617 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+/*
+ * Export .mo files, or whole trees of them, as PO, JSON or TSV.
+ *
+ * Each file's entries are split into one range per thread. Every thread
+ * formats its range into a buffer of its own with a #MoFileIter, and the
+ * buffers are then written out in order, so the output is the same however
+ * many threads there are.
+ */
+
+#include <libmo/mo.h>
+
+#include <glib/gprintf.h>
+#include <glib/gstdio.h>
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef enum {
+        FORMAT_PO,
+        FORMAT_JSON,
+        FORMAT_TSV,
+} ExportFormat;
+
+static const gchar *format_extensions[] = { "po", "json", "tsv" };
+
+/* Give each file's buffers this much room to begin with */
+#define INITIAL_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+        MoFile *mofile;
+        ExportFormat format;
+        guint start;
+        guint end;
+        GString *out;
+        guint n_entries;
+        GError *error;
+} ExportRange;
+
+typedef struct {
+        GMutex lock;
+        GCond done;
+        guint pending;
+} ExportJob;
+
+static ExportJob job;
+
+static gchar *opt_format = NULL;
+static gchar *opt_output = NULL;
+static gint opt_threads = 0;
+static gchar **opt_paths = NULL;
+
+static GOptionEntry entries[] = {
+        { "format", 'f', 0, G_OPTION_ARG_STRING, &opt_format,
+          "Output format: po, json or tsv (default: json)", "FORMAT" },
+        { "output", 'o', 0, G_OPTION_ARG_FILENAME, &opt_output,
+          "Write one file per input into DIRECTORY instead of to standard output",
+          "DIRECTORY" },
+        { "threads", 't', 0, G_OPTION_ARG_INT, &opt_threads,
+          "Number of threads to use (default: one per processor)", "N" },
+        { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &opt_paths,
+          NULL, "PATH…" },
+        { NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+/*
+ * Append the @length bytes at @str to @out, escaped for @format.
+ */
+static void
+append_escaped (GString *out, ExportFormat format, const gchar *str, gsize length)
+{
+        for (gsize i = 0; i < length; ++i) {
+                guchar c = str[i];
+
+                switch (c) {
+                case '\\':
+                        g_string_append (out, "\\\\");
+                        break;
+                case '\n':
+                        g_string_append (out, "\\n");
+                        break;
+                case '\t':
+                        g_string_append (out, "\\t");
+                        break;
+                case '"':
+                        if (format == FORMAT_TSV)
+                                g_string_append_c (out, c);
+                        else
+                                g_string_append (out, "\\\"");
+                        break;
+                default:
+                        if (c < 0x20 && format == FORMAT_JSON)
+                                g_string_append_printf (out, "\\u%04x", c);
+                        else if (c < 0x20)
+                                g_string_append_printf (out, "\\%03o", c);
+                        else
+                                g_string_append_c (out, c);
+                        break;
+                }
+        }
+}
+
+static void
+append_po_string (GString *out,
+                  const gchar *keyword,
+                  const gchar *str,
+                  gsize length)
+{
+        g_string_append (out, keyword);
+        g_string_append (out, " \"");
+        append_escaped (out, FORMAT_PO, str, length);
+        g_string_append (out, "\"\n");
+}
+
+static void
+append_po (GString *out, const MoEntry *entry)
+{
+        const gchar *form;
+        gsize length;
+        gchar keyword[32];
+
+        if (entry->context)
+                append_po_string (out, "msgctxt", entry->context, entry->context_length);
+
+        append_po_string (out, "msgid", entry->msgid, entry->msgid_length);
+
+        if (!entry->msgid_plural) {
+                append_po_string (out,
+                                  "msgstr",
+                                  entry->translation,
+                                  entry->translation_length);
+                g_string_append_c (out, '\n');
+                return;
+        }
+
+        append_po_string (out,
+                          "msgid_plural",
+                          entry->msgid_plural,
+                          entry->msgid_plural_length);
+
+        for (guint i = 0; i < entry->n_translations; ++i) {
+                form = mo_entry_get_plural_form (entry, i, &length);
+                g_snprintf (keyword, sizeof (keyword), "msgstr[%u]", i);
+                append_po_string (out, keyword, form, length);
+        }
+
+        g_string_append_c (out, '\n');
+}
+
+static void
+append_json_member (GString *out,
+                    const gchar *name,
+                    const gchar *str,
+                    gsize length)
+{
+        g_string_append_printf (out, ", \"%s\": \"", name);
+        append_escaped (out, FORMAT_JSON, str, length);
+        g_string_append_c (out, '"');
+}
+
+/*
+ * Every entry starts with a separator from the one before it; the very first
+ * one's is dropped when the buffers are written out.
+ */
+static void
+append_json (GString *out, const MoEntry *entry)
+{
+        const gchar *form;
+        gsize length;
+
+        g_string_append_printf (out, ",\n  {\"index\": %u", entry->index);
+
+        if (entry->context)
+                append_json_member (out, "msgctxt", entry->context, entry->context_length);
+
+        append_json_member (out, "msgid", entry->msgid, entry->msgid_length);
+
+        if (!entry->msgid_plural) {
+                append_json_member (out,
+                                    "msgstr",
+                                    entry->translation,
+                                    entry->translation_length);
+                g_string_append_c (out, '}');
+                return;
+        }
+
+        append_json_member (out,
+                            "msgid_plural",
+                            entry->msgid_plural,
+                            entry->msgid_plural_length);
+
+        g_string_append (out, ", \"msgstr\": [");
+
+        for (guint i = 0; i < entry->n_translations; ++i) {
+                form = mo_entry_get_plural_form (entry, i, &length);
+
+                if (i > 0)
+                        g_string_append (out, ", ");
+
+                g_string_append_c (out, '"');
+                append_escaped (out, FORMAT_JSON, form, length);
+                g_string_append_c (out, '"');
+        }
+
+        g_string_append (out, "]}");
+}
+
+/*
+ * One line per entry: the context, the msgid, the plural msgid and then
+ * every form of the translation, separated by tabs.
+ */
+static void
+append_tsv (GString *out, const MoEntry *entry)
+{
+        const gchar *form;
+        gsize length;
+
+        if (entry->context)
+                append_escaped (out, FORMAT_TSV, entry->context, entry->context_length);
+
+        g_string_append_c (out, '\t');
+        append_escaped (out, FORMAT_TSV, entry->msgid, entry->msgid_length);
+        g_string_append_c (out, '\t');
+
+        if (entry->msgid_plural)
+                append_escaped (out,
+                                FORMAT_TSV,
+                                entry->msgid_plural,
+                                entry->msgid_plural_length);
+
+        for (guint i = 0; i < entry->n_translations; ++i) {
+                form = mo_entry_get_plural_form (entry, i, &length);
+                g_string_append_c (out, '\t');
+                append_escaped (out, FORMAT_TSV, form, length);
+        }
+
+        g_string_append_c (out, '\n');
+}
+
+static void
+export_range_func (gpointer data, gpointer user_data G_GNUC_UNUSED)
+{
+        ExportRange *range = data;
+        MoFileIter iter;
+        MoEntry entry;
+
+        mo_file_iter_init_range (&iter, range->mofile, range->start, range->end);
+
+        while (mo_file_iter_next (&iter, &entry, &range->error)) {
+                switch (range->format) {
+                case FORMAT_PO:
+                        append_po (range->out, &entry);
+                        break;
+                case FORMAT_JSON:
+                        append_json (range->out, &entry);
+                        break;
+                case FORMAT_TSV:
+                        append_tsv (range->out, &entry);
+                        break;
+                default:
+                        g_assert_not_reached ();
+                }
+
+                range->n_entries++;
+        }
+
+        g_mutex_lock (&job.lock);
+
+        if (--job.pending == 0)
+                g_cond_signal (&job.done);
+
+        g_mutex_unlock (&job.lock);
+}
+
+/*
+ * Export @filename to @output, using @ranges, which has one buffer for each
+ * of the pool's threads. Returns how many bytes were written, or -1 on
+ * failure.
+ */
+static gssize
+export_file (const gchar *filename,
+             FILE *output,
+             ExportFormat format,
+             GThreadPool *pool,
+             GPtrArray *ranges,
+             guint *n_entries,
+             GError **error)
+{
+        g_autoptr(MoFile) mofile = NULL;
+        ExportRange *range;
+        gsize written = 0;
+        gboolean first = TRUE;
+        guint n, per_range;
+        GString *out;
+
+        /* PO files say which charset they are in; the others are UTF-8 */
+        if (format == FORMAT_PO)
+                mofile = mo_file_new (filename, error);
+        else
+                mofile = g_initable_new (MO_TYPE_FILE,
+                                         NULL,
+                                         error,
+                                         "filename", filename,
+                                         "target-charset", "UTF-8",
+                                         NULL);
+
+        if (!mofile)
+                return -1;
+
+        n = mo_file_get_n_entries (mofile);
+        per_range = (n + ranges->len - 1) / ranges->len;
+
+        job.pending = ranges->len;
+
+        for (guint i = 0; i < ranges->len; ++i) {
+                range = g_ptr_array_index (ranges, i);
+
+                range->mofile = mofile;
+                range->format = format;
+                range->start = MIN (i * per_range, n);
+                range->end = MIN (range->start + per_range, n);
+                range->n_entries = 0;
+                g_string_truncate (range->out, 0);
+
+                g_thread_pool_push (pool, range, NULL);
+        }
+
+        g_mutex_lock (&job.lock);
+
+        while (job.pending > 0)
+                g_cond_wait (&job.done, &job.lock);
+
+        g_mutex_unlock (&job.lock);
+
+        if (format == FORMAT_JSON) {
+                fputs ("[", output);
+                written += 1;
+        }
+
+        for (guint i = 0; i < ranges->len; ++i) {
+                range = g_ptr_array_index (ranges, i);
+                out = range->out;
+
+                if (range->error) {
+                        g_propagate_error (error, range->error);
+                        range->error = NULL;
+                        return -1;
+                }
+
+                *n_entries += range->n_entries;
+
+                if (format == FORMAT_JSON && first && out->len > 0) {
+                        /* drop the leading ',' */
+                        fwrite (out->str + 1, 1, out->len - 1, output);
+                        written += out->len - 1;
+                        first = FALSE;
+                } else {
+                        fwrite (out->str, 1, out->len, output);
+                        written += out->len;
+                }
+        }
+
+        if (format == FORMAT_JSON) {
+                fputs ("\n]\n", output);
+                written += 3;
+        }
+
+        return written;
+}
+
+/*
+ * Find every .mo file under @path, which may itself be one, and add it to
+ * @files. The name of the file to export each one to, relative to the output
+ * directory, is added to @names.
+ */
+static void
+find_mo_files (const gchar *path,
+               const gchar *relative,
+               GPtrArray *files,
+               GPtrArray *names)
+{
+        g_autoptr(GDir) dir = NULL;
+        const gchar *name;
+
+        if (!g_file_test (path, G_FILE_TEST_IS_DIR)) {
+                if (!relative)
+                        relative = path;
+
+                g_ptr_array_add (files, g_strdup (path));
+                g_ptr_array_add (names, g_strdup (relative));
+                return;
+        }
+
+        dir = g_dir_open (path, 0, NULL);
+
+        if (!dir)
+                return;
+
+        while ((name = g_dir_read_name (dir))) {
+                g_autofree gchar *child = g_build_filename (path, name, NULL);
+                g_autofree gchar *child_relative = NULL;
+
+                if (!g_file_test (child, G_FILE_TEST_IS_DIR) &&
+                    !g_str_has_suffix (name, ".mo"))
+                        continue;
+
+                child_relative = relative ?
+                        g_build_filename (relative, name, NULL) :
+                        g_strdup (name);
+
+                find_mo_files (child, child_relative, files, names);
+        }
+}
+
+/*
+ * Open the file @name, relative to @directory, with its extension replaced
+ * by @format's. Its full name is returned in @filename.
+ */
+static FILE *
+open_output (const gchar *directory,
+             const gchar *name,
+             ExportFormat format,
+             gchar **filename)
+{
+        g_autofree gchar *base = NULL;
+        g_autofree gchar *parent = NULL;
+
+        base = g_path_is_absolute (name) ? g_path_get_basename (name) : g_strdup (name);
+
+        if (g_str_has_suffix (base, ".mo"))
+                base[strlen (base) - 3] = '\0';
+
+        *filename = g_strdup_printf ("%s" G_DIR_SEPARATOR_S "%s.%s",
+                                     directory,
+                                     base,
+                                     format_extensions[format]);
+        parent = g_path_get_dirname (*filename);
+
+        if (g_mkdir_with_parents (parent, 0755) < 0) {
+                g_printerr ("Error: Couldn't create '%s'\n", parent);
+                return NULL;
+        }
+
+        return g_fopen (*filename, "w");
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_autoptr(GOptionContext) context = NULL;
+        g_autoptr(GPtrArray) files = NULL;
+        g_autoptr(GPtrArray) names = NULL;
+        g_autoptr(GPtrArray) ranges = NULL;
+        GThreadPool *pool;
+        ExportFormat format = FORMAT_JSON;
+        ExportRange *range;
+        GError *err = NULL;
+        FILE *output;
+        gint64 start, elapsed;
+        guint64 bytes_read = 0, bytes_written = 0;
+        guint n_files = 0, n_entries = 0, n_threads;
+        GStatBuf buf;
+        gssize written;
+        gdouble seconds;
+        int ret = EXIT_SUCCESS;
+
+        setlocale (LC_ALL, "");
+
+        context = g_option_context_new ("- export .mo files");
+        g_option_context_add_main_entries (context, entries, NULL);
+
+        if (!g_option_context_parse (context, &argc, &argv, &err)) {
+                g_printerr ("Error: %s\n", err->message);
+                g_error_free (err);
+                return EXIT_FAILURE;
+        }
+
+        if (!opt_paths || !opt_paths[0]) {
+                g_printerr ("Usage: %s [--format=po|json|tsv] [--output=DIRECTORY] [--threads=N] PATH…\n",
+                            argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        if (opt_format) {
+                for (format = FORMAT_PO; format <= FORMAT_TSV; ++format) {
+                        if (g_str_equal (opt_format, format_extensions[format]))
+                                break;
+                }
+
+                if (format > FORMAT_TSV) {
+                        g_printerr ("Error: Unknown format '%s'\n", opt_format);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        n_threads = opt_threads > 0 ? (guint) opt_threads : g_get_num_processors ();
+
+        files = g_ptr_array_new_with_free_func (g_free);
+        names = g_ptr_array_new_with_free_func (g_free);
+
+        for (guint i = 0; opt_paths[i]; ++i) {
+                if (!g_file_test (opt_paths[i], G_FILE_TEST_EXISTS)) {
+                        g_printerr ("Error: '%s' does not exist\n", opt_paths[i]);
+                        return EXIT_FAILURE;
+                }
+
+                find_mo_files (opt_paths[i], NULL, files, names);
+        }
+
+        ranges = g_ptr_array_new ();
+
+        for (guint i = 0; i < n_threads; ++i) {
+                range = g_new0 (ExportRange, 1);
+                range->out = g_string_sized_new (INITIAL_BUFFER_SIZE);
+                g_ptr_array_add (ranges, range);
+        }
+
+        pool = g_thread_pool_new (export_range_func, NULL, n_threads, FALSE, NULL);
+
+        start = g_get_monotonic_time ();
+
+        for (guint i = 0; i < files->len; ++i) {
+                const gchar *filename = g_ptr_array_index (files, i);
+                g_autofree gchar *output_filename = NULL;
+
+                if (opt_output)
+                        output = open_output (opt_output,
+                                              g_ptr_array_index (names, i),
+                                              format,
+                                              &output_filename);
+                else
+                        output = stdout;
+
+                if (!output) {
+                        g_printerr ("Error: Couldn't write the export of '%s'\n", filename);
+                        ret = EXIT_FAILURE;
+                        continue;
+                }
+
+                written = export_file (filename,
+                                       output,
+                                       format,
+                                       pool,
+                                       ranges,
+                                       &n_entries,
+                                       &err);
+
+                if (output != stdout)
+                        fclose (output);
+
+                if (written < 0) {
+                        if (output_filename)
+                                g_unlink (output_filename);
+
+                        g_printerr ("Error: File '%s' could not be read: %s\n",
+                                    filename,
+                                    err->message);
+                        g_clear_error (&err);
+                        ret = EXIT_FAILURE;
+                        continue;
+                }
+
+                if (g_stat (filename, &buf) == 0)
+                        bytes_read += buf.st_size;
+
+                bytes_written += written;
+                n_files++;
+        }
+
+        fflush (stdout);
+
+        elapsed = g_get_monotonic_time () - start;
+        seconds = MAX (elapsed, 1) / (gdouble) G_USEC_PER_SEC;
+
+        g_thread_pool_free (pool, FALSE, TRUE);
+
+        for (guint i = 0; i < ranges->len; ++i) {
+                range = g_ptr_array_index (ranges, i);
+                g_string_free (range->out, TRUE);
+                g_free (range);
+        }
+
+        g_printerr ("Exported %u entries from %u files with %u threads in %.3f s: "
+                    "read %.2f MB (%.2f MB/s), wrote %.2f MB (%.2f MB/s)\n",
+                    n_entries,
+                    n_files,
+                    n_threads,
+                    seconds,
+                    bytes_read / 1e6,
+                    bytes_read / 1e6 / seconds,
+                    bytes_written / 1e6,
+                    bytes_written / 1e6 / seconds);
+
+        return ret;
+}
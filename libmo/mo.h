@@ -25,6 +25,8 @@
 /*< private >*/
 #define _IN_MO_H
 
+#include <libmo/mokey.h>
+#include <libmo/moview.h>
 #include <libmo/mofile.h>
 #include <libmo/mogroup.h>
 
@@ -0,0 +1,291 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "moarena.h"
+
+#include <string.h>
+
+/*
+ * A bump allocator for memory which lives exactly as long as its owner.
+ *
+ * Allocations are carved out of large chunks one after the other and are
+ * never freed individually; everything goes at once in mo_arena_free(). This
+ * keeps many small, long lived allocations from fragmenting the heap, and
+ * makes each of them a pointer bump. An allocation too big to share a chunk
+ * gets a chunk of its own.
+ *
+ * For memory which does come and go, such as the keys of a cache, there are
+ * also slab allocations: these are rounded up to a power of two size class,
+ * and given back with mo_arena_free_slab() onto a free list for that class,
+ * from which the next allocation of the class is taken. They are still only
+ * returned to the system when the arena is freed. Slab allocations too big
+ * for any class are ordinary heap allocations.
+ *
+ * The arena may be allocated from by several threads at once, unless it was
+ * made with mo_arena_new_unlocked(), in which case its owner must make sure
+ * that only one thread at a time uses it.
+ */
+
+/* Every allocation is aligned to this */
+#define ARENA_ALIGNMENT 8
+
+/* The slab size classes are the powers of two from MIN_SLAB_SIZE up */
+#define N_SLAB_CLASSES 6
+#define MIN_SLAB_SIZE 16
+#define MAX_SLAB_SIZE (MIN_SLAB_SIZE << (N_SLAB_CLASSES - 1))
+
+typedef struct _FreeBlock FreeBlock;
+
+struct _FreeBlock {
+        FreeBlock *next;
+};
+
+struct _MoArena {
+        GMutex lock;            /* unused if !locked */
+        gboolean locked;
+        GPtrArray *chunks;
+        guint8 *next;           /* the free space of the current chunk */
+        gsize left;
+        gsize chunk_size;
+        FreeBlock *free_blocks[N_SLAB_CLASSES];
+
+        gsize size;             /* bytes taken from the heap */
+        gsize used;             /* bytes currently handed out */
+};
+
+MoArena *
+mo_arena_new (gsize chunk_size)
+{
+        MoArena *arena;
+
+        arena = mo_arena_new_unlocked (chunk_size);
+        arena->locked = TRUE;
+
+        return arena;
+}
+
+/*
+ * Create an arena which doesn't lock, for an owner which already serialises
+ * its use of it.
+ */
+MoArena *
+mo_arena_new_unlocked (gsize chunk_size)
+{
+        MoArena *arena;
+
+        arena = g_new0 (MoArena, 1);
+        g_mutex_init (&arena->lock);
+        arena->chunks = g_ptr_array_new_with_free_func (g_free);
+        arena->chunk_size = MAX (chunk_size, 256);
+
+        return arena;
+}
+
+static inline void
+arena_lock (MoArena *arena)
+{
+        if (arena->locked)
+                g_mutex_lock (&arena->lock);
+}
+
+static inline void
+arena_unlock (MoArena *arena)
+{
+        if (arena->locked)
+                g_mutex_unlock (&arena->lock);
+}
+
+void
+mo_arena_free (MoArena *arena)
+{
+        if (!arena)
+                return;
+
+        g_ptr_array_unref (arena->chunks);
+        g_mutex_clear (&arena->lock);
+        g_free (arena);
+}
+
+/* Called with the arena's lock held */
+static gpointer
+bump_alloc (MoArena *arena, gsize size)
+{
+        guint8 *mem;
+
+        size = (size + ARENA_ALIGNMENT - 1) & ~((gsize) ARENA_ALIGNMENT - 1);
+        arena->used += size;
+
+        if (size > arena->left) {
+                /* Don't throw away the rest of the current chunk for a big
+                 * allocation; give that its own */
+                if (size > arena->chunk_size / 4) {
+                        mem = g_malloc (size);
+                        g_ptr_array_add (arena->chunks, mem);
+                        arena->size += size;
+
+                        return mem;
+                }
+
+                arena->next = g_malloc (arena->chunk_size);
+                arena->left = arena->chunk_size;
+                g_ptr_array_add (arena->chunks, arena->next);
+                arena->size += arena->chunk_size;
+        }
+
+        mem = arena->next;
+        arena->next += size;
+        arena->left -= size;
+
+        return mem;
+}
+
+/*
+ * Allocate @size bytes from @arena, which stay valid until the arena is
+ * freed. The memory is not cleared.
+ */
+gpointer
+mo_arena_alloc (MoArena *arena, gsize size)
+{
+        gpointer mem;
+
+        arena_lock (arena);
+        mem = bump_alloc (arena, size);
+        arena_unlock (arena);
+
+        return mem;
+}
+
+/*
+ * Copy @str into @arena.
+ */
+gchar *
+mo_arena_strdup (MoArena *arena, const gchar *str)
+{
+        gsize size = strlen (str) + 1;
+
+        return memcpy (mo_arena_alloc (arena, size), str, size);
+}
+
+static guint
+get_slab_class (gsize size)
+{
+        guint slab_class = 0;
+
+        while ((gsize) MIN_SLAB_SIZE << slab_class < size)
+                slab_class++;
+
+        return slab_class;
+}
+
+/*
+ * Allocate @size bytes from @arena, which can be given back with
+ * mo_arena_free_slab() to be reused. The memory is not cleared.
+ */
+gpointer
+mo_arena_alloc_slab (MoArena *arena, gsize size)
+{
+        FreeBlock *block;
+        guint slab_class;
+
+        if (size > MAX_SLAB_SIZE) {
+                arena_lock (arena);
+                arena->size += size;
+                arena->used += size;
+                arena_unlock (arena);
+
+                return g_malloc (size);
+        }
+
+        slab_class = get_slab_class (size);
+
+        arena_lock (arena);
+
+        block = arena->free_blocks[slab_class];
+
+        if (block) {
+                arena->free_blocks[slab_class] = block->next;
+                arena->used += MIN_SLAB_SIZE << slab_class;
+        } else {
+                block = bump_alloc (arena, MIN_SLAB_SIZE << slab_class);
+        }
+
+        arena_unlock (arena);
+
+        return block;
+}
+
+/*
+ * Give back @mem, which was allocated with mo_arena_alloc_slab() for @size
+ * bytes.
+ */
+void
+mo_arena_free_slab (MoArena *arena, gpointer mem, gsize size)
+{
+        FreeBlock *block = mem;
+        guint slab_class;
+
+        if (!mem)
+                return;
+
+        if (size > MAX_SLAB_SIZE) {
+                arena_lock (arena);
+                arena->size -= size;
+                arena->used -= size;
+                arena_unlock (arena);
+
+                g_free (mem);
+                return;
+        }
+
+        slab_class = get_slab_class (size);
+
+        arena_lock (arena);
+
+        block->next = arena->free_blocks[slab_class];
+        arena->free_blocks[slab_class] = block;
+        arena->used -= MIN_SLAB_SIZE << slab_class;
+
+        arena_unlock (arena);
+}
+
+/*
+ * How many bytes @arena has taken from the heap, and how many of those are
+ * currently allocated from it.
+ */
+void
+mo_arena_get_usage (MoArena *arena, gsize *size, gsize *used)
+{
+        gsize arena_size = 0, arena_used = 0;
+
+        if (arena) {
+                arena_lock (arena);
+                arena_size = arena->size;
+                arena_used = arena->used;
+                arena_unlock (arena);
+        }
+
+        if (size)
+                *size = arena_size;
+
+        if (used)
+                *used = arena_used;
+}
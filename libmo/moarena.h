@@ -0,0 +1,55 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#if !defined(MO_COMPILATION)
+#error "moarena.h is private to libmo"
+#endif
+
+G_BEGIN_DECLS
+
+typedef struct _MoArena MoArena;
+
+G_GNUC_INTERNAL
+MoArena *mo_arena_new (gsize chunk_size);
+G_GNUC_INTERNAL
+MoArena *mo_arena_new_unlocked (gsize chunk_size);
+G_GNUC_INTERNAL
+void mo_arena_free (MoArena *arena);
+
+G_GNUC_INTERNAL
+gpointer mo_arena_alloc (MoArena *arena, gsize size);
+G_GNUC_INTERNAL
+gchar *mo_arena_strdup (MoArena *arena, const gchar *str);
+
+G_GNUC_INTERNAL
+gpointer mo_arena_alloc_slab (MoArena *arena, gsize size);
+G_GNUC_INTERNAL
+void mo_arena_free_slab (MoArena *arena, gpointer mem, gsize size);
+
+G_GNUC_INTERNAL
+void mo_arena_get_usage (MoArena *arena, gsize *size, gsize *used);
+
+G_END_DECLS
@@ -0,0 +1,442 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "mobundle.h"
+#include "mofile-private.h"
+#include "mogroup.h"
+
+#include <string.h>
+
+/*
+ * A bundle holds every locale of a translation domain in one file, so that a
+ * #MoGroup can map a single file and find a string's translations into all
+ * of its locales with one hash table probe.
+ *
+ * Its layout, with every number a 32-bit word in the byte order indicated by
+ * the magic number, is:
+ *
+ *   - the bundle header: MO_BUNDLE_MAGIC, the revision (0), the number of
+ *     locales, the offset of the locale table, and the length and offset of
+ *     the domain name;
+ *   - the locale table: for each locale, the length and offset of its name
+ *     and the offset of its .mo header;
+ *   - one ordinary .mo header per locale. These all share the same table of
+ *     original strings, which is the union of those of every locale, sorted,
+ *     and the same hash table, but each has its own table of translations;
+ *   - the tables, followed by all of the strings.
+ *
+ * A locale which has no translation for one of the shared original strings
+ * has an empty translation in its table. Since msgfmt never writes empty
+ * translations, #MoFiles created for a bundle treat those as missing.
+ */
+
+#define MO_BUNDLE_MAGIC 0x4d4f4231
+#define MO_BUNDLE_MAGIC_SWAPPED 0x31424f4d
+#define MO_FILE_MAGIC 0x950412de
+
+typedef struct {
+        guint32 magic;
+        guint32 revision;
+        guint32 n_locales;
+        guint32 locale_tab_offset;
+        guint32 domain_length;
+        guint32 domain_offset;
+} MoBundleHeader;
+
+/* The words of each locale table entry, and of each locale's .mo header */
+#define LOCALE_ENTRY_WORDS 3
+#define MO_HEADER_WORDS 7
+
+typedef struct {
+        const gchar *orig;      /* borrowed from the MoFile it came from */
+        gsize orig_length;
+        guint32 index;
+} BundleKey;
+
+typedef struct {
+        const gchar *str;       /* borrowed from the MoFile it came from */
+        gsize length;
+} BundleString;
+
+static gboolean
+is_prime (guint64 n)
+{
+        for (guint64 d = 3; d * d <= n; d += 2) {
+                if (n % d == 0)
+                        return FALSE;
+        }
+
+        return n % 2 != 0;
+}
+
+/*
+ * Size the hash table as msgfmt does: the smallest odd prime at least 4/3 of
+ * the number of strings.
+ */
+static guint64
+hash_table_size (guint64 n_strings)
+{
+        guint64 size = MAX ((n_strings * 4) / 3, 3) | 1;
+
+        while (!is_prime (size))
+                size += 2;
+
+        return size;
+}
+
+static gint
+compare_keys (gconstpointer a, gconstpointer b)
+{
+        const BundleKey *key_a = *(const BundleKey * const *) a;
+        const BundleKey *key_b = *(const BundleKey * const *) b;
+
+        return strcmp (key_a->orig, key_b->orig);
+}
+
+static void
+append_word (GByteArray *out, guint32 word)
+{
+        g_byte_array_append (out, (const guint8 *) &word, sizeof (word));
+}
+
+/*
+ * Append @length bytes at @str and a NUL to @strings, returning where they
+ * start.
+ */
+static guint64
+append_string (GByteArray *strings, const gchar *str, gsize length)
+{
+        guint64 offset = strings->len;
+
+        g_byte_array_append (strings, (const guint8 *) str, length);
+        g_byte_array_append (strings, (const guint8 *) "", 1);
+
+        return offset;
+}
+
+/*
+ * Write the locales @names, whose catalogues are @files, to a new bundle at
+ * @filename.
+ */
+gboolean
+mo_bundle_write (const gchar *filename,
+                 const gchar *domain,
+                 const gchar * const *names,
+                 MoFile * const *files,
+                 guint n_files,
+                 GError **error)
+{
+        g_autoptr(GHashTable) keys_by_msgid = NULL;
+        g_autoptr(GPtrArray) keys = NULL;
+        g_autoptr(GByteArray) strings = NULL;
+        g_autoptr(GByteArray) out = NULL;
+        g_autofree BundleString *columns = NULL;
+        g_autofree guint32 *hash_tab = NULL;
+        g_autofree guint64 *orig_offsets = NULL;
+        guint64 locale_tab_offset, headers_offset, orig_tab_offset;
+        guint64 hash_tab_offset, trans_tabs_offset, strings_offset;
+        guint64 n_keys, hash_size, total, empty_offset;
+        const gchar *orig, *trans;
+        gsize orig_length, trans_length;
+        BundleKey *key;
+        BundleString *column;
+
+        if (!domain)
+                domain = "";
+
+        keys_by_msgid = g_hash_table_new (g_str_hash, g_str_equal);
+        keys = g_ptr_array_new_with_free_func (g_free);
+
+        /* Collect the union of the original strings of every locale, keyed by
+         * msgid so that entries with plural forms are only stored once */
+        for (guint f = 0; f < n_files; ++f) {
+                for (guint32 i = 0; i < _mo_file_get_n_strings (files[f]); ++i) {
+                        if (!_mo_file_get_entry (files[f], i,
+                                                 &orig, &orig_length,
+                                                 &trans, &trans_length,
+                                                 error))
+                                return FALSE;
+
+                        if (trans_length == 0 ||
+                            g_hash_table_contains (keys_by_msgid, orig))
+                                continue;
+
+                        key = g_new (BundleKey, 1);
+                        key->orig = orig;
+                        key->orig_length = orig_length;
+                        g_ptr_array_add (keys, key);
+                        g_hash_table_insert (keys_by_msgid, (gpointer) orig, key);
+                }
+        }
+
+        /* Sorted, so that the bundle can also be binary searched */
+        g_ptr_array_sort (keys, compare_keys);
+
+        n_keys = keys->len;
+
+        for (guint i = 0; i < keys->len; ++i)
+                ((BundleKey *) g_ptr_array_index (keys, i))->index = i;
+
+        /* Then fill in each locale's column of translations */
+        columns = g_new0 (BundleString, n_files * n_keys);
+
+        for (guint f = 0; f < n_files; ++f) {
+                for (guint32 i = 0; i < _mo_file_get_n_strings (files[f]); ++i) {
+                        if (!_mo_file_get_entry (files[f], i,
+                                                 &orig, &orig_length,
+                                                 &trans, &trans_length,
+                                                 error))
+                                return FALSE;
+
+                        if (trans_length == 0)
+                                continue;
+
+                        key = g_hash_table_lookup (keys_by_msgid, orig);
+                        column = &columns[f * n_keys + key->index];
+
+                        if (!column->str) {
+                                column->str = trans;
+                                column->length = trans_length;
+                        }
+                }
+        }
+
+        hash_size = hash_table_size (n_keys);
+        hash_tab = g_new0 (guint32, hash_size);
+
+        for (guint i = 0; i < keys->len; ++i) {
+                guint32 V, cursor, increment;
+
+                key = g_ptr_array_index (keys, i);
+                V = hashpjw (key->orig, strlen (key->orig));
+                cursor = V % hash_size;
+                increment = 1 + (V % (hash_size - 2));
+
+                while (hash_tab[cursor] != 0) {
+                        cursor += increment;
+                        if (cursor >= hash_size)
+                                cursor -= hash_size;
+                }
+
+                hash_tab[cursor] = i + 1;
+        }
+
+        locale_tab_offset = sizeof (MoBundleHeader);
+        headers_offset = locale_tab_offset + (guint64) n_files * LOCALE_ENTRY_WORDS * sizeof (guint32);
+        orig_tab_offset = headers_offset + (guint64) n_files * MO_HEADER_WORDS * sizeof (guint32);
+        hash_tab_offset = orig_tab_offset + n_keys * 2 * sizeof (guint32);
+        trans_tabs_offset = hash_tab_offset + hash_size * sizeof (guint32);
+        strings_offset = trans_tabs_offset + (guint64) n_files * n_keys * 2 * sizeof (guint32);
+
+        /* The domain goes first, and its NUL doubles as every missing
+         * translation */
+        strings = g_byte_array_new ();
+        append_string (strings, domain, strlen (domain));
+        empty_offset = strings_offset + strlen (domain);
+
+        for (guint f = 0; f < n_files; ++f)
+                append_string (strings, names[f], strlen (names[f]));
+
+        orig_offsets = g_new (guint64, n_keys);
+
+        for (guint i = 0; i < keys->len; ++i) {
+                key = g_ptr_array_index (keys, i);
+                orig_offsets[i] = strings_offset +
+                                  append_string (strings, key->orig, key->orig_length);
+        }
+
+        total = strings_offset + strings->len;
+
+        for (guint64 c = 0; c < n_files * n_keys; ++c)
+                total += columns[c].str ? columns[c].length + 1 : 0;
+
+        if (total > G_MAXUINT32) {
+                g_set_error (error,
+                             MO_GROUP_ERROR,
+                             MO_GROUP_INVALID_BUNDLE_ERROR,
+                             "The catalogues of '%s' are too large for a bundle.", domain,
+                             NULL);
+                return FALSE;
+        }
+
+        out = g_byte_array_sized_new (total);
+
+        append_word (out, MO_BUNDLE_MAGIC);
+        append_word (out, 0);
+        append_word (out, n_files);
+        append_word (out, locale_tab_offset);
+        append_word (out, strlen (domain));
+        append_word (out, strings_offset);
+
+        for (guint f = 0, name_offset = strlen (domain) + 1; f < n_files; ++f) {
+                append_word (out, strlen (names[f]));
+                append_word (out, strings_offset + name_offset);
+                append_word (out, headers_offset + f * MO_HEADER_WORDS * sizeof (guint32));
+                name_offset += strlen (names[f]) + 1;
+        }
+
+        for (guint f = 0; f < n_files; ++f) {
+                append_word (out, MO_FILE_MAGIC);
+                append_word (out, 0);
+                append_word (out, n_keys);
+                append_word (out, orig_tab_offset);
+                append_word (out, trans_tabs_offset + f * n_keys * 2 * sizeof (guint32));
+                append_word (out, hash_size);
+                append_word (out, hash_tab_offset);
+        }
+
+        for (guint i = 0; i < keys->len; ++i) {
+                key = g_ptr_array_index (keys, i);
+                append_word (out, key->orig_length);
+                append_word (out, orig_offsets[i]);
+        }
+
+        g_byte_array_append (out, (const guint8 *) hash_tab, hash_size * sizeof (guint32));
+
+        /* The translations are appended after the other strings as their
+         * offsets are handed out */
+        for (guint64 c = 0; c < n_files * n_keys; ++c) {
+                if (!columns[c].str) {
+                        append_word (out, 0);
+                        append_word (out, empty_offset);
+                        continue;
+                }
+
+                append_word (out, columns[c].length);
+                append_word (out, strings_offset +
+                                  append_string (strings, columns[c].str, columns[c].length));
+        }
+
+        g_assert (out->len == strings_offset);
+
+        g_byte_array_append (out, strings->data, strings->len);
+
+        return g_file_set_contents (filename, (const gchar *) out->data, out->len, error);
+}
+
+static inline guint32
+read_word (const guint8 *data, gsize offset, gboolean swapped)
+{
+        guint32 word;
+
+        memcpy (&word, data + offset, sizeof (word));
+
+        return swapped ? GUINT32_SWAP_LE_BE (word) : word;
+}
+
+/*
+ * Get the NUL-terminated string of @length bytes at @offset in @data, or NULL
+ * if it isn't one.
+ */
+static const gchar *
+read_string (const guint8 *data, gsize size, guint32 offset, guint32 length)
+{
+        if ((guint64) offset + length + 1 > size || data[offset + length] != '\0')
+                return NULL;
+
+        return (const gchar *) data + offset;
+}
+
+static void
+clear_locale (gpointer data)
+{
+        MoBundleLocale *locale = data;
+
+        g_free (locale->name);
+}
+
+/*
+ * Read the header and locale table of the bundle in @bytes. Returns an array
+ * of #MoBundleLocale, and sets @domain to the bundle's domain.
+ */
+GArray *
+mo_bundle_read_locales (GBytes *bytes, gchar **domain, GError **error)
+{
+        g_autoptr(GArray) locales = NULL;
+        MoBundleHeader header;
+        const guint8 *data;
+        const gchar *name;
+        gboolean swapped;
+        gsize size;
+        MoBundleLocale locale;
+        guint64 entry;
+
+        data = g_bytes_get_data (bytes, &size);
+
+        if (!data || size < sizeof (MoBundleHeader))
+                goto invalid;
+
+        memcpy (&header, data, sizeof (MoBundleHeader));
+
+        if (header.magic == MO_BUNDLE_MAGIC)
+                swapped = FALSE;
+        else if (header.magic == MO_BUNDLE_MAGIC_SWAPPED)
+                swapped = TRUE;
+        else
+                goto invalid;
+
+        if (swapped) {
+                header.revision = GUINT32_SWAP_LE_BE (header.revision);
+                header.n_locales = GUINT32_SWAP_LE_BE (header.n_locales);
+                header.locale_tab_offset = GUINT32_SWAP_LE_BE (header.locale_tab_offset);
+                header.domain_length = GUINT32_SWAP_LE_BE (header.domain_length);
+                header.domain_offset = GUINT32_SWAP_LE_BE (header.domain_offset);
+        }
+
+        if (header.revision != 0 ||
+            (guint64) header.locale_tab_offset +
+            (guint64) header.n_locales * LOCALE_ENTRY_WORDS * sizeof (guint32) > size ||
+            !(name = read_string (data, size, header.domain_offset, header.domain_length)))
+                goto invalid;
+
+        locales = g_array_sized_new (FALSE, FALSE, sizeof (MoBundleLocale), header.n_locales);
+        g_array_set_clear_func (locales, clear_locale);
+
+        *domain = g_strdup (name);
+
+        for (guint32 i = 0; i < header.n_locales; ++i) {
+                entry = header.locale_tab_offset + (guint64) i * LOCALE_ENTRY_WORDS * sizeof (guint32);
+
+                name = read_string (data,
+                                    size,
+                                    read_word (data, entry + sizeof (guint32), swapped),
+                                    read_word (data, entry, swapped));
+                if (!name) {
+                        g_clear_pointer (domain, g_free);
+                        goto invalid;
+                }
+
+                locale.name = g_strdup (name);
+                locale.header_offset = read_word (data, entry + 2 * sizeof (guint32), swapped);
+                g_array_append_val (locales, locale);
+        }
+
+        return g_steal_pointer (&locales);
+
+invalid:
+        g_set_error (error,
+                     MO_GROUP_ERROR,
+                     MO_GROUP_INVALID_BUNDLE_ERROR,
+                     "Not a valid translation bundle.",
+                     NULL);
+        return NULL;
+}
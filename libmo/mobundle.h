@@ -0,0 +1,51 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include "mofile.h"
+
+#if !defined(MO_COMPILATION)
+#error "mobundle.h is private to libmo"
+#endif
+
+G_BEGIN_DECLS
+
+typedef struct {
+        gchar *name;
+        guint32 header_offset;
+} MoBundleLocale;
+
+G_GNUC_INTERNAL
+gboolean mo_bundle_write (const gchar *filename,
+                          const gchar *domain,
+                          const gchar * const *names,
+                          MoFile * const *files,
+                          guint n_files,
+                          GError **error);
+
+G_GNUC_INTERNAL
+GArray *mo_bundle_read_locales (GBytes *bytes,
+                                gchar **domain,
+                                GError **error);
+
+G_END_DECLS
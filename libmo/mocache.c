@@ -0,0 +1,385 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "mocache.h"
+
+#include "moarena.h"
+
+#include <string.h>
+
+/*
+ * A bounded cache from untranslated strings to translations, used by #MoFile.
+ *
+ * The cache is split into shards, chosen by the hashpjw value of the key,
+ * which the caller has already computed, mixed so that every bit of it
+ * counts: its low bits only come from the key's last character. Each shard holds two fixed size
+ * rings: one for strings which were found and one for strings which were
+ * not, so that a flood of misses cannot push out useful entries. When a ring
+ * is full, entries are evicted using the CLOCK algorithm: lookups set an
+ * entry's reference bit, and the clock hand clears reference bits until it
+ * finds an entry which has not been used since the hand last passed it.
+ *
+ * Lookups only take a shard's lock for reading. The reference bit is set
+ * atomically, so many threads can hit the same shard concurrently.
+ *
+ * The keys are slab allocated from an arena of the ring's own, so that a busy
+ * cache recycles the memory of evicted keys instead of going back to malloc
+ * for every insertion. The arena is only touched with the ring's writer lock
+ * held, so needs no lock of its own, and rings never contend over it.
+ */
+
+#define N_CACHE_SHARD_BITS 4
+#define N_CACHE_SHARDS (1 << N_CACHE_SHARD_BITS)
+
+#define KEY_ARENA_CHUNK_SIZE 1024
+
+typedef struct {
+        gchar *key;             /* owned, or NULL if the slot is unused */
+        gsize key_size;
+        const gchar *value;     /* borrowed from the MoFile's data */
+        gint referenced;
+} MoCacheSlot;
+
+typedef struct {
+        GRWLock lock;
+        MoArena *keys;          /* guarded by the writer lock */
+        GHashTable *index;      /* key (owned by the slot) -> slot number + 1 */
+        MoCacheSlot *slots;
+        guint n_slots;
+        guint n_used;
+        guint hand;
+} MoCacheRing;
+
+typedef struct {
+        MoCacheRing found;
+        MoCacheRing missing;
+} MoCacheShard;
+
+struct _MoCache {
+        MoCacheShard shards[N_CACHE_SHARDS];
+};
+
+static MoCacheShard *
+get_shard (MoCache *cache, guint32 hash)
+{
+        return &cache->shards[(guint32) (hash * 0x9e3779b1u) >> (32 - N_CACHE_SHARD_BITS)];
+}
+
+/*
+ * Split @max_entries between the shards, the first of them getting one more
+ * until the remainder is used up, so that the cache as a whole never holds
+ * more than asked for. With fewer entries than shards, some shards don't
+ * cache anything.
+ */
+static guint
+get_shard_slots (guint max_entries, guint shard)
+{
+        return max_entries / N_CACHE_SHARDS +
+               (shard < max_entries % N_CACHE_SHARDS ? 1 : 0);
+}
+
+static void
+ring_init (MoCacheRing *ring, guint n_slots)
+{
+        g_rw_lock_init (&ring->lock);
+
+        ring->n_slots = n_slots;
+        ring->n_used = 0;
+        ring->hand = 0;
+
+        if (ring->n_slots == 0) {
+                ring->slots = NULL;
+                ring->index = NULL;
+                return;
+        }
+
+        ring->slots = g_new0 (MoCacheSlot, ring->n_slots);
+        ring->index = g_hash_table_new (g_str_hash, g_str_equal);
+        ring->keys = mo_arena_new_unlocked (KEY_ARENA_CHUNK_SIZE);
+}
+
+static void
+slot_clear_key (MoCacheRing *ring, MoCacheSlot *slot)
+{
+        mo_arena_free_slab (ring->keys, slot->key, slot->key_size);
+        slot->key = NULL;
+}
+
+static void
+ring_clear (MoCacheRing *ring)
+{
+        if (ring->n_slots == 0)
+                return;
+
+        g_rw_lock_writer_lock (&ring->lock);
+
+        g_hash_table_remove_all (ring->index);
+
+        for (guint i = 0; i < ring->n_used; ++i)
+                slot_clear_key (ring, &ring->slots[i]);
+
+        ring->n_used = 0;
+        ring->hand = 0;
+
+        g_rw_lock_writer_unlock (&ring->lock);
+}
+
+static void
+ring_destroy (MoCacheRing *ring)
+{
+        ring_clear (ring);
+
+        g_clear_pointer (&ring->index, g_hash_table_destroy);
+        g_clear_pointer (&ring->slots, g_free);
+        g_clear_pointer (&ring->keys, mo_arena_free);
+        g_rw_lock_clear (&ring->lock);
+}
+
+static gboolean
+ring_lookup (MoCacheRing *ring, const gchar *key, const gchar **value)
+{
+        MoCacheSlot *slot;
+        guint n;
+
+        if (ring->n_slots == 0)
+                return FALSE;
+
+        g_rw_lock_reader_lock (&ring->lock);
+
+        n = GPOINTER_TO_UINT (g_hash_table_lookup (ring->index, key));
+
+        if (n == 0) {
+                g_rw_lock_reader_unlock (&ring->lock);
+                return FALSE;
+        }
+
+        slot = &ring->slots[n - 1];
+
+        /* Avoid dirtying the cache line when the bit is already set */
+        if (!g_atomic_int_get (&slot->referenced))
+                g_atomic_int_set (&slot->referenced, 1);
+
+        *value = slot->value;
+
+        g_rw_lock_reader_unlock (&ring->lock);
+
+        return TRUE;
+}
+
+/* Called with the ring's writer lock held */
+static MoCacheSlot *
+ring_evict (MoCacheRing *ring)
+{
+        MoCacheSlot *slot;
+
+        while (1) {
+                slot = &ring->slots[ring->hand];
+
+                ring->hand = (ring->hand + 1) % ring->n_slots;
+
+                if (!slot->referenced)
+                        break;
+
+                slot->referenced = 0;
+        }
+
+        g_hash_table_remove (ring->index, slot->key);
+        slot_clear_key (ring, slot);
+
+        return slot;
+}
+
+static void
+ring_insert (MoCacheRing *ring, const gchar *key, const gchar *value)
+{
+        MoCacheSlot *slot;
+
+        if (ring->n_slots == 0)
+                return;
+
+        g_rw_lock_writer_lock (&ring->lock);
+
+        /* Another thread might have got here first */
+        if (g_hash_table_contains (ring->index, key)) {
+                g_rw_lock_writer_unlock (&ring->lock);
+                return;
+        }
+
+        if (ring->n_used < ring->n_slots)
+                slot = &ring->slots[ring->n_used++];
+        else
+                slot = ring_evict (ring);
+
+        slot->key_size = strlen (key) + 1;
+        slot->key = memcpy (mo_arena_alloc_slab (ring->keys, slot->key_size),
+                            key,
+                            slot->key_size);
+        slot->value = value;
+        slot->referenced = 0;
+
+        g_hash_table_insert (ring->index,
+                             slot->key,
+                             GUINT_TO_POINTER ((guint) (slot - ring->slots) + 1));
+
+        g_rw_lock_writer_unlock (&ring->lock);
+}
+
+/*
+ * Create a cache holding at most @max_entries translations which were found
+ * and at most @max_negative_entries strings which were not. Either budget may
+ * be 0, in which case that kind of entry is never cached.
+ */
+MoCache *
+mo_cache_new (guint max_entries, guint max_negative_entries)
+{
+        MoCache *cache;
+
+        if (max_entries == 0 && max_negative_entries == 0)
+                return NULL;
+
+        cache = g_new0 (MoCache, 1);
+
+        for (guint i = 0; i < N_CACHE_SHARDS; ++i) {
+                ring_init (&cache->shards[i].found,
+                           get_shard_slots (max_entries, i));
+                ring_init (&cache->shards[i].missing,
+                           get_shard_slots (max_negative_entries, i));
+        }
+
+        return cache;
+}
+
+void
+mo_cache_free (MoCache *cache)
+{
+        if (!cache)
+                return;
+
+        for (guint i = 0; i < N_CACHE_SHARDS; ++i) {
+                ring_destroy (&cache->shards[i].found);
+                ring_destroy (&cache->shards[i].missing);
+        }
+
+        g_free (cache);
+}
+
+void
+mo_cache_clear (MoCache *cache)
+{
+        if (!cache)
+                return;
+
+        for (guint i = 0; i < N_CACHE_SHARDS; ++i) {
+                ring_clear (&cache->shards[i].found);
+                ring_clear (&cache->shards[i].missing);
+        }
+}
+
+/*
+ * Look @key up. Returns TRUE if the cache knows about it, in which case
+ * @value is set to the translation, or to NULL if @key is known to have no
+ * translation.
+ */
+gboolean
+mo_cache_lookup (MoCache *cache,
+                 const gchar *key,
+                 guint32 hash,
+                 const gchar **value)
+{
+        MoCacheShard *shard;
+
+        if (!cache)
+                return FALSE;
+
+        shard = get_shard (cache, hash);
+
+        if (ring_lookup (&shard->found, key, value))
+                return TRUE;
+
+        if (ring_lookup (&shard->missing, key, value)) {
+                *value = NULL;
+                return TRUE;
+        }
+
+        return FALSE;
+}
+
+/*
+ * Remember that @key translates to @value, or that it has no translation if
+ * @value is NULL.
+ */
+void
+mo_cache_insert (MoCache *cache,
+                 const gchar *key,
+                 guint32 hash,
+                 const gchar *value)
+{
+        MoCacheShard *shard;
+
+        if (!cache)
+                return;
+
+        shard = get_shard (cache, hash);
+
+        ring_insert (value ? &shard->found : &shard->missing, key, value);
+}
+
+/*
+ * How many bytes the cached keys take from the heap, and how many of those
+ * are in use.
+ */
+static void
+ring_add_memory_usage (MoCacheRing *ring, gsize *size, gsize *used)
+{
+        gsize ring_size, ring_used;
+
+        if (ring->n_slots == 0)
+                return;
+
+        g_rw_lock_reader_lock (&ring->lock);
+        mo_arena_get_usage (ring->keys, &ring_size, &ring_used);
+        g_rw_lock_reader_unlock (&ring->lock);
+
+        *size += ring_size;
+        *used += ring_used;
+}
+
+void
+mo_cache_get_memory_usage (MoCache *cache, gsize *size, gsize *used)
+{
+        gsize cache_size = 0, cache_used = 0;
+
+        for (guint i = 0; cache && i < N_CACHE_SHARDS; ++i) {
+                ring_add_memory_usage (&cache->shards[i].found,
+                                       &cache_size,
+                                       &cache_used);
+                ring_add_memory_usage (&cache->shards[i].missing,
+                                       &cache_size,
+                                       &cache_used);
+        }
+
+        if (size)
+                *size = cache_size;
+
+        if (used)
+                *used = cache_used;
+}
@@ -0,0 +1,56 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#if !defined(MO_COMPILATION)
+#error "mocache.h is private to libmo"
+#endif
+
+G_BEGIN_DECLS
+
+typedef struct _MoCache MoCache;
+
+G_GNUC_INTERNAL
+MoCache *mo_cache_new (guint max_entries, guint max_negative_entries);
+G_GNUC_INTERNAL
+void mo_cache_free (MoCache *cache);
+G_GNUC_INTERNAL
+void mo_cache_clear (MoCache *cache);
+
+G_GNUC_INTERNAL
+gboolean mo_cache_lookup (MoCache *cache,
+                          const gchar *key,
+                          guint32 hash,
+                          const gchar **value);
+G_GNUC_INTERNAL
+void mo_cache_insert (MoCache *cache,
+                      const gchar *key,
+                      guint32 hash,
+                      const gchar *value);
+
+G_GNUC_INTERNAL
+void mo_cache_get_memory_usage (MoCache *cache, gsize *size, gsize *used);
+
+G_END_DECLS
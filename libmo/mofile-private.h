@@ -0,0 +1,138 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include "mofile.h"
+#include "mokey.h"
+
+#if !defined(MO_COMPILATION)
+#error "mofile-private.h is private to libmo"
+#endif
+
+G_BEGIN_DECLS
+
+// This is just the common hashpjw routine, pasted in, but taking an explicit
+// length so that keys don't need to be NUL-terminated, and able to carry on
+// from the value of a previous part of the key:
+
+#define HASHWORDBITS 32
+
+static inline guint32 hashpjw_update (guint32 hval, const gchar *str_param, gsize len)
+{
+        guint32 g;
+        const gchar *s, *end;
+
+        s = str_param;
+        end = s + len;
+
+        while (s < end) {
+                hval <<= 4;
+                hval += (unsigned char) *s++;
+                g = hval & ((guint32) 0xf << (HASHWORDBITS - 4));
+                if (g != 0) {
+                        hval ^= g >> (HASHWORDBITS - 8);
+                        hval ^= g;
+                }
+        }
+
+        return hval;
+}
+
+static inline guint32 hashpjw (const gchar *str_param, gsize len)
+{
+        g_return_val_if_fail (str_param != NULL, 0);
+
+        return hashpjw_update (0, str_param, len);
+}
+
+// The hash of the key "context\004str" that msgfmt stores entries with a
+// msgctxt under, without building it:
+
+#define CONTEXT_SEPARATOR '\004'
+
+static inline guint32 hashpjw_context (const gchar *context,
+                                       gsize context_len,
+                                       const gchar *str,
+                                       gsize len)
+{
+        const gchar separator = CONTEXT_SEPARATOR;
+        guint32 hval;
+
+        hval = hashpjw_update (0, context, context_len);
+        hval = hashpjw_update (hval, &separator, 1);
+
+        return hashpjw_update (hval, str, len);
+}
+
+struct _MoKey {
+        gchar *msgid;           /* owned, unless the key is static */
+        gsize length;
+        guint32 hash;           /* hashpjw() */
+        guint64 index_hash;     /* mo_index_hash() */
+        gboolean is_static;
+};
+
+G_GNUC_INTERNAL
+MoFile *_mo_file_new_for_bundle (GBytes *bytes,
+                                 gsize header_offset,
+                                 GError **error);
+
+G_GNUC_INTERNAL
+guint32 _mo_file_get_n_strings (MoFile *self);
+G_GNUC_INTERNAL
+gboolean _mo_file_get_entry (MoFile *self,
+                             guint32 index,
+                             const gchar **orig,
+                             gsize *orig_length,
+                             const gchar **trans,
+                             gsize *trans_length,
+                             GError **error);
+
+G_GNUC_INTERNAL
+gboolean _mo_file_find_index (MoFile *self,
+                              const gchar *context,
+                              gsize context_length,
+                              const gchar *str,
+                              gsize str_length,
+                              guint32 hash,
+                              guint64 index_hash,
+                              guint32 *index);
+G_GNUC_INTERNAL
+const gchar *_mo_file_lookup_hashed (MoFile *self,
+                                     const gchar *context,
+                                     gsize context_length,
+                                     const gchar *str,
+                                     gsize str_length,
+                                     guint32 hash,
+                                     guint64 index_hash,
+                                     gsize *length);
+G_GNUC_INTERNAL
+const gchar *_mo_file_get_translation_at (MoFile *self,
+                                          guint32 index,
+                                          gsize *length);
+G_GNUC_INTERNAL
+gsize _mo_file_get_reverse_index_size (MoFile *self);
+G_GNUC_INTERNAL
+gsize _mo_file_get_search_index_size (MoFile *self);
+
+G_END_DECLS
@@ -21,6 +21,14 @@
  */
 
 #include "mofile.h"
+#include "mofile-private.h"
+#include "moarena.h"
+#include "mocache.h"
+#include "moindex.h"
+#include "moplural.h"
+#include "mosearch.h"
+#include "mosysdep.h"
+#include "moview-private.h"
 
 #include <glib/gprintf.h>
 
@@ -63,6 +71,50 @@
  *    }
  * </programlisting>
  * </example>
+ *
+ * Once it has been constructed, a #MoFile can be shared between threads: all
+ * of the lookup functions may be called concurrently on the same instance.
+ * mo_file_lookup_translation() only reads the file's data and takes no locks
+ * at all. mo_file_get_translation() additionally consults a cache which is
+ * split into independently locked shards, so that threads looking up
+ * different strings rarely contend with each other.
+ *
+ * That cache is bounded: it holds at most #MoFile:cache-size translations
+ * and, separately, at most #MoFile:negative-cache-size strings which were
+ * not found, evicting the least recently used ones with the CLOCK
+ * algorithm. Setting both to 0 turns the cache off entirely, which is
+ * worthwhile on validated files where the lookup itself is cheap.
+ *
+ * Lookups normally probe the hash table stored in the file, which msgfmt
+ * builds with the rather weak hashpjw function. Catalogues whose hash table
+ * is small or badly sized can need long probe sequences. Setting
+ * #MoFile:build-index makes the file build its own, more compact index when
+ * it is loaded and use it for every lookup instead; mo_file_get_stats()
+ * reports what that costs, so it can be decided per file.
+ *
+ * Messages with plural forms are looked up with mo_file_lookup_plural(),
+ * which picks the right form for a number using the catalogue's
+ * "Plural-Forms:" header, as ngettext() does. Messages with a context are
+ * looked up with mo_file_lookup_translation_with_context(), as pgettext()
+ * does.
+ *
+ * The system dependent strings of revision 1 files, such as format strings
+ * using &lt;PRIu64&gt;, are expanded for the running platform when the file
+ * is loaded, and can then be looked up like any other string.
+ *
+ * The catalogue's header, the translation of the empty string, is parsed the
+ * first time it is needed and kept, so its fields can be read cheaply with
+ * mo_file_get_header_value(), mo_file_get_charset() and friends.
+ *
+ * To read every entry of a file, walk it with a #MoFileIter. This copies
+ * nothing, and splits each entry into its context, msgid, plural msgid and
+ * translations.
+ *
+ * mo_file_lookup_originals() goes the other way, from a translation to the
+ * entries which have it, using an index built on its first call.
+ *
+ * mo_file_search() finds the entries containing a string, or something
+ * close to it, which mo_file_build_search_index() can make much faster.
  */
 
 typedef struct {
@@ -73,24 +125,124 @@ typedef struct {
         guint32 trans_tab_offset;
         guint32 hash_tab_size;
         guint32 hash_tab_offset;
-        /* there are also 'sysdep' strings, which we don't handle currently */
+        /* revision 1 files follow this with the tables of their system
+         * dependent strings; see read_sysdep_strings() */
 } MoFileHeader;
 
+#define DEFAULT_CACHE_SIZE 1024
+#define DEFAULT_NEGATIVE_CACHE_SIZE 256
+
+/* How many keys mo_file_lookup_translations() keeps in flight at once */
+#define LOOKUP_BATCH_SIZE 16
+
+#if defined(__GNUC__)
+#define MO_PREFETCH(addr) __builtin_prefetch ((addr), 0 /* read */, 1 /* low locality */)
+#else
+#define MO_PREFETCH(addr) ((void) (addr))
+#endif
+
+typedef struct {
+        GHashTable *fields;
+        gchar *charset;
+} MoFileMetadata;
+
+/* A translation converted to the target charset */
+typedef struct {
+        gsize length;
+        gchar str[];
+} MoConverted;
+
+/* Converted translations are allocated in chunks of this size */
+#define CONVERTED_CHUNK_SIZE 16384
+
+/*
+ * An index from translations back to the entries which have them. There is
+ * a node for every form of every translation, as each form of a plural
+ * entry can have a different one. Several entries can share a translation:
+ * the index gives the node of the first of them, and @next chains each node
+ * to the node of the next entry with the same translation.
+ */
+typedef struct {
+        MoIndex *index;
+        guint32 *next;          /* node -> next node, or NO_ENTRY */
+        guint32 *entries;       /* node -> entry */
+        guint32 n_nodes;
+} MoReverseIndex;
+
+#define NO_ENTRY G_MAXUINT32
+
 struct _MoFile {
         GObject parent_instance;
 
         gchar *filename;
-        GHashTable *translations_cache;
+        MoCache *translations_cache;
+        guint cache_size;
+        guint negative_cache_size;
         MoFileHeader header;
         gboolean swapped;
         GBytes *bytes;
         guint8 *data;
         off_t length;
+
+        /* Set for the locales of a #MoGroup bundle, which are a header
+         * somewhere inside a shared file rather than at its start. In a
+         * bundle an empty translation means that there is none. */
+        gsize header_offset;
+        gboolean sparse;
+        GBytes *owned_bytes;
+
+        /* Only set once validate_mo_file() has checked the whole file. These
+         * are native-endian views of the tables, either pointing into @data
+         * or into @owned_tables. */
+        gboolean validate;
+        const guint32 *orig_tab;
+        const guint32 *trans_tab;
+        const guint32 *hash_tab;
+        guint32 *owned_tables;
+
+        /* Our own index, replacing the file's hash table for lookups */
+        gboolean build_index;
+        MoIndex *index;
+        gint64 index_build_time;
+
+        /* The system dependent strings of a revision 1 file, expanded for
+         * this platform. They come after the file's own strings, so have
+         * indices from header.nstrings on. */
+        MoSysdep *sysdep;
+        guint32 n_sysdep_strings;
+
+        /* Parsed from the header, and compiled from its Plural-Forms field,
+         * on first use */
+        MoFileMetadata *metadata;
+        MoPlural *plural;
+
+        /* Only set up if the file's translations aren't in @target_charset
+         * already. @converted holds a MoConverted in @arena for each entry,
+         * filled in atomically the first time it is looked up. */
+        gchar *target_charset;
+        const gchar *source_charset;
+        MoConverted **converted;
+        MoArena *arena;
+
+        /* Built on the first reverse lookup */
+        MoReverseIndex *reverse;
+
+        /* Built by mo_file_build_search_index(), perhaps a few entries at a
+         * time; entries from @n_search_indexed on aren't in it yet */
+        GRWLock search_lock;
+        MoSearchIndex *search;
+        MoSearchFlags search_fields;
+        guint32 n_search_indexed;
 };
 
 enum {
         PROP_FILENAME = 1,
         PROP_BYTES,
+        PROP_VALIDATE,
+        PROP_CACHE_SIZE,
+        PROP_NEGATIVE_CACHE_SIZE,
+        PROP_BUILD_INDEX,
+        PROP_TARGET_CHARSET,
         N_PROPERTIES
 };
 
@@ -99,6 +251,10 @@ static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
 /* forward declarations */
 static void mo_file_initable_init (GInitableIface *iface);
 static gboolean read_mo_file (MoFile *self, GError **error);
+static gboolean read_header (MoFile *self, GError **error);
+static void mo_file_metadata_free (MoFileMetadata *metadata);
+static void reverse_index_free (MoReverseIndex *reverse);
+static const MoFileMetadata *get_metadata (MoFile *self);
 
 G_DEFINE_TYPE_WITH_CODE (MoFile, mo_file, G_TYPE_OBJECT,
                          G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE,
@@ -128,6 +284,26 @@ mo_file_get_property (GObject    *object,
             g_value_set_pointer (value, self->bytes);
             break;
 
+        case PROP_VALIDATE:
+            g_value_set_boolean (value, self->validate);
+            break;
+
+        case PROP_CACHE_SIZE:
+            g_value_set_uint (value, self->cache_size);
+            break;
+
+        case PROP_NEGATIVE_CACHE_SIZE:
+            g_value_set_uint (value, self->negative_cache_size);
+            break;
+
+        case PROP_BUILD_INDEX:
+            g_value_set_boolean (value, self->build_index);
+            break;
+
+        case PROP_TARGET_CHARSET:
+            g_value_set_string (value, self->target_charset);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -152,6 +328,26 @@ mo_file_set_property (GObject      *object,
             self->bytes = (GBytes *) g_value_get_pointer (value);
             break;
 
+        case PROP_VALIDATE:
+            self->validate = g_value_get_boolean (value);
+            break;
+
+        case PROP_CACHE_SIZE:
+            self->cache_size = g_value_get_uint (value);
+            break;
+
+        case PROP_NEGATIVE_CACHE_SIZE:
+            self->negative_cache_size = g_value_get_uint (value);
+            break;
+
+        case PROP_BUILD_INDEX:
+            self->build_index = g_value_get_boolean (value);
+            break;
+
+        case PROP_TARGET_CHARSET:
+            self->target_charset = g_value_dup_string (value);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -170,8 +366,23 @@ clear_file (MoFile *self)
                 self->data = NULL;
         }
 
+        self->orig_tab = self->trans_tab = self->hash_tab = NULL;
+        g_clear_pointer (&self->owned_tables, g_free);
+        g_clear_pointer (&self->index, mo_index_free);
+        self->index_build_time = 0;
+        g_clear_pointer (&self->reverse, reverse_index_free);
+        g_clear_pointer (&self->search, mo_search_index_free);
+        self->n_search_indexed = 0;
+        g_clear_pointer (&self->plural, mo_plural_free);
+        g_clear_pointer (&self->metadata, mo_file_metadata_free);
+        self->source_charset = NULL;
+        g_clear_pointer (&self->converted, g_free);
+        g_clear_pointer (&self->arena, mo_arena_free);
+        g_clear_pointer (&self->sysdep, mo_sysdep_free);
+        self->n_sysdep_strings = 0;
+
         g_free (self->filename);
-        g_hash_table_remove_all (self->translations_cache);
+        mo_cache_clear (self->translations_cache);
 }
 
 
@@ -187,7 +398,10 @@ mo_file_finalize (GObject *object)
         MoFile *self = MO_FILE (object);
 
         clear_file (self);
-        g_clear_pointer (&self->translations_cache, g_hash_table_destroy);
+        g_clear_pointer (&self->translations_cache, mo_cache_free);
+        g_clear_pointer (&self->owned_bytes, g_bytes_unref);
+        g_free (self->target_charset);
+        g_rw_lock_clear (&self->search_lock);
 
         G_OBJECT_CLASS (mo_file_parent_class)->finalize (object);
 }
@@ -218,42 +432,14 @@ mo_file_initable_init_bytes (GInitable *init,
 
         g_clear_pointer (&self->filename, g_free);
 
-        if ((size_t) length <= sizeof (MoFileHeader)) {
-                g_set_error (error,
-                             MO_FILE_ERROR,
-                             MO_FILE_INVALID_FILE_ERROR,
-                             "'%s' doesn't contain a valid header, cannot read.", self->filename,
-                             NULL);
-                goto fail;
-        }
-
-        self->header = *(MoFileHeader *) b;
-
-        if (self->header.hash_tab_offset == 0) {
-                g_set_error (error,
-                             MO_FILE_ERROR,
-                             MO_FILE_INVALID_FILE_ERROR,
-                             "'%s' doesn't contain a hash table, cannot read.", self->filename,
-                             NULL);
-                goto fail;
-        }
+        self->length = (off_t) length;
+        self->data = (guint8 *) b;
 
-        if (self->header.magic == 0x950412de) {
-                self->swapped = FALSE;
-        } else if (self->header.magic == 0xde120495) {
-                self->swapped = TRUE;
-        } else {
-                g_set_error (error,
-                             MO_FILE_ERROR,
-                             MO_FILE_INVALID_FILE_ERROR,
-                             "'%s' contains unrecognisable magic bits, cannot read.", self->filename,
-                             NULL);
+        if (!read_header (self, error)) {
+                self->data = NULL;
                 goto fail;
         }
 
-        self->length = (off_t) length;
-        self->data = (guint8 *) b;
-
         return TRUE;
 
 fail:
@@ -300,6 +486,14 @@ mo_file_initable_init_real (GInitable *init,
 
         self = MO_FILE (init);
 
+        /* The index stores pointers into the file, so they must be checked */
+        if (self->build_index)
+                self->validate = TRUE;
+
+        if (!self->translations_cache)
+                self->translations_cache = mo_cache_new (self->cache_size,
+                                                         self->negative_cache_size);
+
         if (self->bytes)
                 return mo_file_initable_init_bytes (init, cancellable, error);
         else if (self->filename)
@@ -352,6 +546,100 @@ mo_file_class_init (MoFileClass *klass)
                                       G_PARAM_READWRITE |
                                       G_PARAM_STATIC_STRINGS);
 
+        /**
+         * MoFile::validate:
+         *
+         * Whether to check the whole file when it is loaded. Every table
+         * entry, string and hash table slot is checked once, which makes
+         * loading slower, but lookups on a file which passed can then skip
+         * all bounds and overflow checks.
+         */
+        obj_properties[PROP_VALIDATE] =
+                g_param_spec_boolean ("validate",
+                                      "Validate",
+                                      "Whether to validate the whole file when loading it.",
+                                      FALSE  /* default value */,
+                                      G_PARAM_CONSTRUCT_ONLY |
+                                      G_PARAM_READWRITE |
+                                      G_PARAM_STATIC_STRINGS);
+
+        /**
+         * MoFile::cache-size:
+         *
+         * The maximum number of translations which
+         * mo_file_get_translation() remembers. 0 disables caching of
+         * translations.
+         */
+        obj_properties[PROP_CACHE_SIZE] =
+                g_param_spec_uint ("cache-size",
+                                   "Cache size",
+                                   "Maximum number of cached translations.",
+                                   0,
+                                   G_MAXUINT,
+                                   DEFAULT_CACHE_SIZE  /* default value */,
+                                   G_PARAM_CONSTRUCT_ONLY |
+                                   G_PARAM_READWRITE |
+                                   G_PARAM_STATIC_STRINGS);
+
+        /**
+         * MoFile::negative-cache-size:
+         *
+         * The maximum number of strings without a translation which
+         * mo_file_get_translation() remembers. These are kept apart from the
+         * translations, so that looking up many unknown strings does not
+         * evict known ones. 0 disables caching of misses.
+         */
+        obj_properties[PROP_NEGATIVE_CACHE_SIZE] =
+                g_param_spec_uint ("negative-cache-size",
+                                   "Negative cache size",
+                                   "Maximum number of cached misses.",
+                                   0,
+                                   G_MAXUINT,
+                                   DEFAULT_NEGATIVE_CACHE_SIZE  /* default value */,
+                                   G_PARAM_CONSTRUCT_ONLY |
+                                   G_PARAM_READWRITE |
+                                   G_PARAM_STATIC_STRINGS);
+
+        /**
+         * MoFile::build-index:
+         *
+         * Whether to build an in-memory index of the file's strings when it
+         * is loaded, and use it for lookups instead of the hash table stored
+         * in the file. This costs some memory and load time, see
+         * mo_file_get_stats(), but makes lookups faster, particularly on
+         * files whose own hash table is small or missing. Implies
+         * #MoFile:validate.
+         */
+        obj_properties[PROP_BUILD_INDEX] =
+                g_param_spec_boolean ("build-index",
+                                      "Build index",
+                                      "Whether to build an in-memory index of the file when loading it.",
+                                      FALSE  /* default value */,
+                                      G_PARAM_CONSTRUCT_ONLY |
+                                      G_PARAM_READWRITE |
+                                      G_PARAM_STATIC_STRINGS);
+
+        /**
+         * MoFile::target-charset:
+         *
+         * The character set to return translations in, such as "UTF-8". If
+         * the file's translations are in another one, given by the charset
+         * of its Content-Type header field, each is converted the first time
+         * it is looked up and kept, so the returned strings are still
+         * borrowed from @self. Files which are in this charset already, and
+         * files whose charset isn't known, such as templates which still say
+         * "CHARSET", are read exactly as if it were not set. %NULL, the
+         * default, means translations are returned as they are in the file.
+         */
+        obj_properties[PROP_TARGET_CHARSET] =
+                g_param_spec_string ("target-charset",
+                                     "Target charset",
+                                     "The character set to convert translations to.",
+                                     NULL  /* default value */,
+                                     G_PARAM_CONSTRUCT_ONLY |
+                                     G_PARAM_READWRITE |
+                                     G_PARAM_STATIC_STRINGS);
+
         g_object_class_install_properties (object_class,
                                            N_PROPERTIES,
                                            obj_properties);
@@ -360,10 +648,9 @@ mo_file_class_init (MoFileClass *klass)
 static void
 mo_file_init (MoFile *self)
 {
-        self->translations_cache = g_hash_table_new_full (g_str_hash /* owned */,
-                                                          g_str_equal,
-                                                          g_free,
-                                                          NULL); /* pointer to the mmapped file or in-memory bytes */
+        self->cache_size = DEFAULT_CACHE_SIZE;
+        self->negative_cache_size = DEFAULT_NEGATIVE_CACHE_SIZE;
+        g_rw_lock_init (&self->search_lock);
 }
 
 static gboolean
@@ -415,389 +702,2628 @@ read_mo_file (MoFile *self, GError **error)
 
         close (fd);
 
-        memcpy (&self->header, self->data, sizeof (MoFileHeader));
-
-        if (self->header.hash_tab_offset == 0) {
-                g_set_error (error,
-                             MO_FILE_ERROR,
-                             MO_FILE_INVALID_FILE_ERROR,
-                             "'%s' doesn't contain a hash table, cannot read.", self->filename,
-                             NULL);
+        if (!read_header (self, error))
                 goto fail;
-        }
 
-        if (self->header.magic == 0x950412de) {
-                self->swapped = FALSE;
-        } else if (self->header.magic == 0xde120495) {
-                self->swapped = TRUE;
-        } else {
+        return TRUE;
+
+fail:
+        memset (&self->header, 0, sizeof (MoFileHeader));
+        return FALSE;
+}
+
+/*
+ * Checks that @offset + @n_words 32-bit words fits inside the file.
+ */
+static gboolean
+check_table_bounds (MoFile *self,
+                    guint32 offset,
+                    guint64 n_words,
+                    GError **error)
+{
+        if ((guint64) offset + n_words * sizeof (guint32) > (guint64) self->length) {
                 g_set_error (error,
                              MO_FILE_ERROR,
                              MO_FILE_INVALID_FILE_ERROR,
-                             "'%s' contains unrecognisable magic bits, cannot read.", self->filename,
+                             "File is truncated.",
                              NULL);
-                goto fail;
+                return FALSE;
         }
 
         return TRUE;
+}
 
-fail:
-        memset (&self->header, 0, sizeof (MoFileHeader));
-        return FALSE;
+/*
+ * Whether the table at @offset can't be used where it is, because it is in
+ * the other byte order or isn't suitably aligned.
+ */
+static gboolean
+table_needs_copy (MoFile *self, guint32 offset)
+{
+        return self->swapped || (guintptr) (self->data + offset) % sizeof (guint32) != 0;
 }
 
-/**
- * mo_file_get_name:
- * @self: An initialised #MoFile.
- *
- * Get the filename of this #MoFile instance.
- *
- * Returns: (transfer none): The filename.
+/*
+ * Returns a native-endian view of the @n_words 32-bit words at @offset,
+ * which check_table_bounds() has accepted. If the table doesn't need a copy,
+ * this points straight at the data; otherwise the words are copied to @copy
+ * and swapped if needed.
  */
-const gchar *
-mo_file_get_name (MoFile *self)
+static const guint32 *
+get_native_table (MoFile *self,
+                  guint32 offset,
+                  guint64 n_words,
+                  guint32 *copy)
 {
-        if (!MO_IS_FILE (self))
-                return NULL;
+        const guint8 *table = self->data + offset;
 
-        return self->filename;
-}
+        if (!table_needs_copy (self, offset))
+                return (const guint32 *) (gconstpointer) table;
 
-// This is just the common hashpjw routine, pasted in:
+        memcpy (copy, table, n_words * sizeof (guint32));
+
+        if (self->swapped) {
+                for (guint64 i = 0; i < n_words; ++i)
+                        copy[i] = GUINT32_SWAP_LE_BE (copy[i]);
+        }
 
-#define HASHWORDBITS 32
+        return copy;
+}
 
-static inline guint32 hashpjw (const gchar *str_param)
+static gboolean
+validate_string_table (MoFile *self,
+                       const guint32 *table,
+                       GError **error)
 {
-        guint32 hval = 0;
-        guint32 g;
-        const gchar *s;
+        guint64 string_offset, string_length;
 
-        g_return_val_if_fail (str_param != NULL, 0);
+        for (guint32 i = 0; i < self->header.nstrings; ++i) {
+                string_length = table[2 * i];
+                string_offset = table[2 * i + 1];
 
-        s = str_param;
+                if (string_offset + string_length + 1 > (guint64) self->length) {
+                        g_set_error (error,
+                                     MO_FILE_ERROR,
+                                     MO_FILE_INVALID_FILE_ERROR,
+                                     "File is truncated.",
+                                     NULL);
+                        return FALSE;
+                }
 
-        while (*s) {
-                hval <<= 4;
-                hval += (unsigned char) *s++;
-                g = hval & ((guint32) 0xf << (HASHWORDBITS - 4));
-                if (g != 0) {
-                        hval ^= g >> (HASHWORDBITS - 8);
-                        hval ^= g;
+                if (self->data[string_offset + string_length] != '\0') {
+                        g_set_error (error,
+                                     MO_FILE_ERROR,
+                                     MO_FILE_INVALID_FILE_ERROR,
+                                     "File contains a non-NUL terminated string.",
+                                     NULL);
+                        return FALSE;
                 }
         }
 
-        return hval;
+        return TRUE;
 }
 
-static inline size_t
-osum (size_t a, size_t b)
+/*
+ * Check every table entry, string and hash table slot in the file once, so
+ * that lookups can trust them from now on. On success the native-endian table
+ * views in @self are filled in, which is what enables the unchecked lookup
+ * path.
+ */
+static gboolean
+validate_mo_file (MoFile *self, GError **error)
 {
-        size_t sum = a + b;
+        const guint32 *orig_tab, *trans_tab, *hash_tab;
+        guint64 n_table_words, n_hash_words, n_copy_words = 0;
+        guint32 *copy = NULL, *next;
+
+        n_table_words = (guint64) self->header.nstrings * 2;
+        n_hash_words = self->header.hash_tab_size;
+
+        /* The sizes come from the header, so are checked before anything
+         * is allocated for them */
+        if (!check_table_bounds (self, self->header.orig_tab_offset, n_table_words, error) ||
+            !check_table_bounds (self, self->header.trans_tab_offset, n_table_words, error) ||
+            !check_table_bounds (self, self->header.hash_tab_offset, n_hash_words, error))
+                return FALSE;
 
-        return sum >= a ? sum : G_MAXSIZE;
+        if (table_needs_copy (self, self->header.orig_tab_offset))
+                n_copy_words += n_table_words;
+        if (table_needs_copy (self, self->header.trans_tab_offset))
+                n_copy_words += n_table_words;
+        if (n_hash_words > 0 && table_needs_copy (self, self->header.hash_tab_offset))
+                n_copy_words += n_hash_words;
+
+        if (n_copy_words > 0)
+                copy = g_new (guint32, n_copy_words);
+
+        next = copy;
+        orig_tab = get_native_table (self, self->header.orig_tab_offset, n_table_words, next);
+        if (orig_tab == next)
+                next += n_table_words;
+        trans_tab = get_native_table (self, self->header.trans_tab_offset, n_table_words, next);
+        if (trans_tab == next)
+                next += n_table_words;
+        hash_tab = NULL;
+        if (n_hash_words > 0)
+                hash_tab = get_native_table (self, self->header.hash_tab_offset, n_hash_words, next);
+
+        if (!validate_string_table (self, orig_tab, error) ||
+            !validate_string_table (self, trans_tab, error))
+                goto fail;
+
+        /* Without a hash table we binary search, which needs sorted strings */
+        for (guint32 i = 1; n_hash_words == 0 && i < self->header.nstrings; ++i) {
+                if (strcmp ((const gchar *) self->data + orig_tab[2 * (i - 1) + 1],
+                            (const gchar *) self->data + orig_tab[2 * i + 1]) > 0) {
+                        g_set_error (error,
+                                     MO_FILE_ERROR,
+                                     MO_FILE_INVALID_FILE_ERROR,
+                                     "'%s' has no hash table and its strings are not sorted.",
+                                     self->filename,
+                                     NULL);
+                        goto fail;
+                }
+        }
+
+        for (guint32 i = 0; i < self->header.hash_tab_size; ++i) {
+                if (hash_tab[i] > self->header.nstrings + self->n_sysdep_strings) {
+                        g_set_error (error,
+                                     MO_FILE_ERROR,
+                                     MO_FILE_INVALID_FILE_ERROR,
+                                     "'%s' contains an out of range hash table entry.",
+                                     self->filename,
+                                     NULL);
+                        goto fail;
+                }
+        }
+
+        self->orig_tab = orig_tab;
+        self->trans_tab = trans_tab;
+        self->hash_tab = hash_tab;
+
+        self->owned_tables = copy;
+
+        return TRUE;
+
+fail:
+        g_free (copy);
+        return FALSE;
 }
 
-static inline size_t
-osum3 (size_t a, size_t b, size_t c)
+/*
+ * The number of entries in the file, including any expanded system dependent
+ * strings.
+ */
+static inline guint32
+get_n_entries (MoFile *self)
 {
-        return osum (osum (a, b), c);
+        return self->header.nstrings + (self->sysdep ? mo_sysdep_get_n_strings (self->sysdep) : 0);
 }
 
-static inline guint32
-get_uint32 (const guint8 *data,
-            size_t offset,
-            gboolean swap,
-            off_t length,
-            GError **error)
+/*
+ * Index every original string of a validated file by its msgid, which for
+ * entries with plural forms is the part before the NUL. The expanded system
+ * dependent strings are indexed alongside the file's own.
+ */
+static void
+build_index (MoFile *self)
 {
-        guint32 b0, b1, b2, b3, res;
-        size_t sum;
+        gint64 start = g_get_monotonic_time ();
+        guint32 n_entries = get_n_entries (self);
+        const gchar *orig;
+        gsize len;
 
-        sum = osum (offset, sizeof(guint8) * 4);
+        g_assert (self->orig_tab);
 
-        g_return_val_if_fail (length >= 0, G_MAXUINT32);
+        self->index = mo_index_new (n_entries);
 
-        if (sum == G_MAXSIZE || sum > (size_t) length) {
-                g_set_error (error,
-                             MO_FILE_ERROR,
-                             MO_FILE_INVALID_FILE_ERROR,
-                             "File is truncated.",
-                             NULL);
-                return G_MAXUINT32;
-        }
+        for (guint32 i = 0; i < n_entries; ++i) {
+                if (i < self->header.nstrings)
+                        orig = (const gchar *) self->data + self->orig_tab[2 * i + 1];
+                else
+                        orig = mo_sysdep_get_orig (self->sysdep, i - self->header.nstrings, NULL);
 
-        b0 = *(guint8 *) (data + offset);
-        b1 = *(guint8 *) (data + offset + sizeof (guint8));
-        b2 = *(guint8 *) (data + offset + sizeof (guint8) * 2);
-        b3 = *(guint8 *) (data + offset + sizeof (guint8) * 3);
+                len = strlen (orig);
 
-        res = b0 | (b1 << 8) | (b2 << 16) | (b3 << 24);
+                mo_index_insert (self->index, orig, len, mo_index_hash (orig, len), i);
+        }
 
-        if (swap)
-                res = GUINT32_SWAP_LE_BE (res);
+        self->index_build_time = g_get_monotonic_time () - start;
+}
 
-        if (res == G_MAXUINT32) {
+/*
+ * Revision 1 files may also have system dependent strings, whose tables are
+ * described by five more words after the usual header. Expand those for this
+ * platform. Such files are always validated and indexed, as the file's hash
+ * table can't be used to find the expanded strings.
+ */
+static gboolean
+read_sysdep_strings (MoFile *self, GError **error)
+{
+        guint32 fields[5];
+        gsize offset = self->header_offset + sizeof (MoFileHeader);
+
+        if ((guint64) self->length < (guint64) offset + sizeof (fields)) {
                 g_set_error (error,
                              MO_FILE_ERROR,
                              MO_FILE_INVALID_FILE_ERROR,
-                             "File is truncated.",
+                             "'%s' doesn't contain a valid header, cannot read.", self->filename,
                              NULL);
+                return FALSE;
         }
 
-        return res;
-}
+        memcpy (fields, self->data + offset, sizeof (fields));
 
-static inline const gchar *
-get_string (const guint8 *data,
-            guint32 offset,
-            guint32 index,
-            gboolean swapped,
-            off_t length,
-            size_t *lengthp,
-            GError **error)
-{
-        size_t string_length, string_offset, string_end;
+        for (guint i = 0; self->swapped && i < G_N_ELEMENTS (fields); ++i)
+                fields[i] = GUINT32_SWAP_LE_BE (fields[i]);
 
-        g_return_val_if_fail (data != NULL, NULL);
-        g_return_val_if_fail (length >= 0, NULL);
+        /* fields are: number of segments, segment table offset, number of
+         * strings, original and translated string table offsets */
+        if (fields[2] == 0)
+                return TRUE;
 
-        string_length = get_uint32 (data, offset + index * sizeof (char *), swapped, length, error);
-        if (string_length == G_MAXUINT) {
-                return NULL;
-        }
+        self->sysdep = mo_sysdep_new (self->data,
+                                      self->length,
+                                      self->swapped,
+                                      fields[0],
+                                      fields[1],
+                                      fields[2],
+                                      fields[3],
+                                      fields[4],
+                                      error);
 
-        string_offset = get_uint32 (data,
-                                    offset + index * sizeof (char *) + sizeof (guint32),
-                                    swapped,
-                                    length,
-                                    error);
-        if (string_offset == G_MAXUINT) {
-                return NULL;
+        if (!self->sysdep)
+                return FALSE;
+
+        self->n_sysdep_strings = fields[2];
+        self->validate = TRUE;
+        self->build_index = TRUE;
+
+        return TRUE;
+}
+
+/*
+ * Compare two charset names, ignoring case and punctuation, so that "utf8"
+ * is the same as "UTF-8".
+ */
+static gboolean
+charsets_equal (const gchar *a, const gchar *b)
+{
+        while (*a || *b) {
+                if (*a == '-' || *a == '_') {
+                        a++;
+                } else if (*b == '-' || *b == '_') {
+                        b++;
+                } else if (g_ascii_tolower (*a) != g_ascii_tolower (*b)) {
+                        return FALSE;
+                } else {
+                        a++;
+                        b++;
+                }
+        }
+
+        return TRUE;
+}
+
+/*
+ * Get ready to convert translations to the target charset, if the file's
+ * charset is a different one. A file which doesn't say what its charset is
+ * is left alone.
+ */
+static gboolean
+setup_conversion (MoFile *self, GError **error)
+{
+        const gchar *charset = get_metadata (self)->charset;
+        GIConv conv;
+
+        if (!charset || charsets_equal (charset, self->target_charset))
+                return TRUE;
+
+        conv = g_iconv_open (self->target_charset, charset);
+
+        if (conv != (GIConv) -1) {
+                g_iconv_close (conv);
+        } else if ((conv = g_iconv_open (self->target_charset, "UTF-8")) != (GIConv) -1) {
+                /* The file's own charset is the one that is unknown, such as
+                 * the "CHARSET" of a template: read it as it is, as if no
+                 * conversion had been asked for */
+                g_iconv_close (conv);
+                g_debug ("Not converting '%s' from unknown charset %s.",
+                         self->filename ? self->filename : "(bytes)",
+                         charset);
+                return TRUE;
+        } else {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_UNSUPPORTED_CHARSET_ERROR,
+                             "Can't convert '%s' from %s to %s.",
+                             self->filename,
+                             charset,
+                             self->target_charset,
+                             NULL);
+                return FALSE;
+        }
+
+        self->source_charset = charset;
+        self->converted = g_new0 (MoConverted *, get_n_entries (self));
+        self->arena = mo_arena_new (CONVERTED_CHUNK_SIZE);
+
+        return TRUE;
+}
+
+/*
+ * Parse the header at the start of the file's data, in whichever byte order
+ * the file was written in.
+ */
+static gboolean
+read_header (MoFile *self, GError **error)
+{
+        if ((guint64) self->length < (guint64) self->header_offset + sizeof (MoFileHeader)) {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_INVALID_FILE_ERROR,
+                             "'%s' doesn't contain a valid header, cannot read.", self->filename,
+                             NULL);
+                return FALSE;
+        }
+
+        memcpy (&self->header, self->data + self->header_offset, sizeof (MoFileHeader));
+
+        if (self->header.magic == 0x950412de) {
+                self->swapped = FALSE;
+        } else if (self->header.magic == 0xde120495) {
+                self->swapped = TRUE;
+        } else {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_INVALID_FILE_ERROR,
+                             "'%s' contains unrecognisable magic bits, cannot read.", self->filename,
+                             NULL);
+                return FALSE;
+        }
+
+        if (self->swapped) {
+                self->header.revision = GUINT32_SWAP_LE_BE (self->header.revision);
+                self->header.nstrings = GUINT32_SWAP_LE_BE (self->header.nstrings);
+                self->header.orig_tab_offset = GUINT32_SWAP_LE_BE (self->header.orig_tab_offset);
+                self->header.trans_tab_offset = GUINT32_SWAP_LE_BE (self->header.trans_tab_offset);
+                self->header.hash_tab_size = GUINT32_SWAP_LE_BE (self->header.hash_tab_size);
+                self->header.hash_tab_offset = GUINT32_SWAP_LE_BE (self->header.hash_tab_offset);
+        }
+
+        /* Files written with msgfmt --no-hash have no hash table, but their
+         * strings are sorted so we can binary search them instead */
+        if (self->header.hash_tab_offset == 0)
+                self->header.hash_tab_size = 0;
+
+        /* The probe increment is taken modulo (size - 2) */
+        if (self->header.hash_tab_size != 0 && self->header.hash_tab_size < 3) {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_INVALID_FILE_ERROR,
+                             "'%s' has an invalid hash table size, cannot read.", self->filename,
+                             NULL);
+                return FALSE;
+        }
+
+        if (self->header.revision >> 16 == 0 && (self->header.revision & 0xffff) >= 1 &&
+            !read_sysdep_strings (self, error))
+                return FALSE;
+
+        if (self->validate && !validate_mo_file (self, error))
+                return FALSE;
+
+        if (self->build_index)
+                build_index (self);
+
+        if (self->target_charset && !setup_conversion (self, error))
+                return FALSE;
+
+        return TRUE;
+}
+
+/**
+ * mo_file_get_name:
+ * @self: An initialised #MoFile.
+ *
+ * Get the filename of this #MoFile instance.
+ *
+ * Returns: (transfer none): The filename.
+ */
+const gchar *
+mo_file_get_name (MoFile *self)
+{
+        if (!MO_IS_FILE (self))
+                return NULL;
+
+        return self->filename;
+}
+
+static inline size_t
+osum (size_t a, size_t b)
+{
+        size_t sum = a + b;
+
+        return sum >= a ? sum : G_MAXSIZE;
+}
+
+static inline size_t
+osum3 (size_t a, size_t b, size_t c)
+{
+        return osum (osum (a, b), c);
+}
+
+static inline guint32
+get_uint32 (const guint8 *data,
+            size_t offset,
+            gboolean swap,
+            off_t length,
+            GError **error)
+{
+        guint32 b0, b1, b2, b3, res;
+        size_t sum;
+
+        sum = osum (offset, sizeof(guint8) * 4);
+
+        g_return_val_if_fail (length >= 0, G_MAXUINT32);
+
+        if (sum == G_MAXSIZE || sum > (size_t) length) {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_INVALID_FILE_ERROR,
+                             "File is truncated.",
+                             NULL);
+                return G_MAXUINT32;
+        }
+
+        b0 = *(guint8 *) (data + offset);
+        b1 = *(guint8 *) (data + offset + sizeof (guint8));
+        b2 = *(guint8 *) (data + offset + sizeof (guint8) * 2);
+        b3 = *(guint8 *) (data + offset + sizeof (guint8) * 3);
+
+        res = b0 | (b1 << 8) | (b2 << 16) | (b3 << 24);
+
+        if (swap)
+                res = GUINT32_SWAP_LE_BE (res);
+
+        if (res == G_MAXUINT32) {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_INVALID_FILE_ERROR,
+                             "File is truncated.",
+                             NULL);
+        }
+
+        return res;
+}
+
+static inline const gchar *
+get_string (const guint8 *data,
+            guint32 offset,
+            guint32 index,
+            gboolean swapped,
+            off_t length,
+            size_t *lengthp,
+            GError **error)
+{
+        size_t string_length, string_offset, string_end;
+
+        g_return_val_if_fail (data != NULL, NULL);
+        g_return_val_if_fail (length >= 0, NULL);
+
+        string_length = get_uint32 (data, offset + index * 2 * sizeof (guint32), swapped, length, error);
+        if (string_length == G_MAXUINT) {
+                return NULL;
+        }
+
+        string_offset = get_uint32 (data,
+                                    offset + index * 2 * sizeof (guint32) + sizeof (guint32),
+                                    swapped,
+                                    length,
+                                    error);
+        if (string_offset == G_MAXUINT) {
+                return NULL;
+        }
+
+        /* See if we're overflowed or pointed off the end of the file */
+        string_end = osum3 (string_offset, string_length, 1);
+
+        if (string_end == G_MAXSIZE || string_end > (size_t) length) {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_INVALID_FILE_ERROR,
+                             "File is truncated.",
+                             NULL);
+                return NULL;
+        }
+
+        if (data[string_offset + string_length] != '\0') {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_INVALID_FILE_ERROR,
+                             "File contains a non-NUL terminated string.",
+                             NULL);
+                return NULL;
+        }
+
+        /* We think we're ok now */
+        if (lengthp)
+                *lengthp = string_length + 1;
+
+        return (const gchar *) data + string_offset;
+}
+
+/*
+ * Fetch the original or translated string at @index, along with its length
+ * (not including the trailing NUL). On a validated file this is a direct read
+ * from the native tables; otherwise every offset is checked.
+ */
+static inline const gchar *
+get_entry_string (MoFile *self,
+                  const guint32 *native_tab,
+                  guint32 tab_offset,
+                  guint32 index,
+                  gsize *lengthp,
+                  GError **error)
+{
+        const gchar *str;
+        size_t length;
+
+        if (G_LIKELY (native_tab)) {
+                if (lengthp)
+                        *lengthp = native_tab[2 * index];
+
+                return (const gchar *) self->data + native_tab[2 * index + 1];
+        }
+
+        str = get_string (self->data,
+                          tab_offset,
+                          index,
+                          self->swapped,
+                          self->length,
+                          &length,
+                          error);
+
+        if (str && lengthp)
+                *lengthp = length - 1;
+
+        return str;
+}
+
+static const gchar *
+get_orig_string (MoFile *self, guint32 index, gsize *lengthp, GError **error)
+{
+        if (G_UNLIKELY (index >= self->header.nstrings) && self->sysdep)
+                return mo_sysdep_get_orig (self->sysdep, index - self->header.nstrings, lengthp);
+
+        return get_entry_string (self,
+                                 self->orig_tab,
+                                 self->header.orig_tab_offset,
+                                 index,
+                                 lengthp,
+                                 error);
+}
+
+static const gchar *
+get_trans_string (MoFile *self, guint32 index, gsize *lengthp, GError **error)
+{
+        if (G_UNLIKELY (index >= self->header.nstrings) && self->sysdep)
+                return mo_sysdep_get_trans (self->sysdep, index - self->header.nstrings, lengthp);
+
+        return get_entry_string (self,
+                                 self->trans_tab,
+                                 self->header.trans_tab_offset,
+                                 index,
+                                 lengthp,
+                                 error);
+}
+
+/*
+ * Whether a translation of @trans_len bytes stands for no translation at all,
+ * which is how a bundle records that one of its locales lacks an entry.
+ */
+static inline gboolean
+is_missing (MoFile *self, gsize trans_len)
+{
+        return self->sparse && trans_len == 0;
+}
+
+/*
+ * Convert the translation @trans, of *@length bytes, of the entry at @index
+ * to the target charset, or fetch the result of having done so before. Two
+ * threads may race to convert the same entry; one of them wins, and the
+ * other's copy is simply left unused in the arena.
+ */
+static const gchar *
+convert_translation (MoFile *self,
+                     guint32 index,
+                     const gchar *trans,
+                     gsize *length)
+{
+        g_autoptr(GError) error = NULL;
+        g_autofree gchar *str = NULL;
+        MoConverted *converted;
+        gsize len = 0;
+
+        converted = g_atomic_pointer_get (&self->converted[index]);
+
+        if (!converted) {
+                str = g_convert_with_fallback (trans,
+                                               *length,
+                                               self->target_charset,
+                                               self->source_charset,
+                                               "?",
+                                               NULL,
+                                               &len,
+                                               &error);
+
+                /* Serve the bytes as they are rather than nothing */
+                if (!str) {
+                        g_debug ("Couldn't convert translation %u of '%s': %s",
+                                 index,
+                                 self->filename,
+                                 error->message);
+                        len = *length;
+                }
+
+                converted = mo_arena_alloc (self->arena, sizeof (MoConverted) + len + 1);
+                converted->length = len;
+                memcpy (converted->str, str ? str : trans, len);
+                converted->str[len] = '\0';
+
+                if (!g_atomic_pointer_compare_and_exchange (&self->converted[index],
+                                                            NULL,
+                                                            converted))
+                        converted = g_atomic_pointer_get (&self->converted[index]);
+        }
+
+        *length = converted->length;
+
+        return converted->str;
+}
+
+/*
+ * Fetch the translation of the entry at @index, in the target charset if one
+ * was asked for, as get_trans_string() does. An entry which stands for no
+ * translation returns NULL without setting @error.
+ */
+static inline const gchar *
+get_translation_string (MoFile *self, guint32 index, gsize *lengthp, GError **error)
+{
+        const gchar *trans;
+        gsize len;
+
+        trans = get_trans_string (self, index, &len, error);
+
+        if (!trans || is_missing (self, len))
+                return NULL;
+
+        if (G_UNLIKELY (self->converted))
+                trans = convert_translation (self, index, trans, &len);
+
+        if (lengthp)
+                *lengthp = len;
+
+        return trans;
+}
+
+/*
+ * Does the original string @orig, of @orig_len bytes, match the key @str of
+ * @str_len bytes? Entries with plural forms are stored as
+ * "msgid\0msgid_plural" but looked up by msgid alone, so a longer original
+ * matches if it has a NUL just after the key. The lengths are compared before
+ * any of the string's bytes are touched.
+ *
+ * If @context is not %NULL, the key is "@context\004@str" instead, which is
+ * how entries with a msgctxt are stored; it is compared a part at a time.
+ */
+static inline gboolean
+key_matches (const gchar *orig,
+             gsize orig_len,
+             const gchar *context,
+             gsize context_len,
+             const gchar *str,
+             gsize str_len)
+{
+        if (context) {
+                if (orig_len < context_len + 1 + str_len ||
+                    orig[context_len] != CONTEXT_SEPARATOR ||
+                    memcmp (orig, context, context_len) != 0)
+                        return FALSE;
+
+                orig += context_len + 1;
+                orig_len -= context_len + 1;
+        }
+
+        if (orig_len < str_len)
+                return FALSE;
+
+        if (orig_len > str_len && orig[str_len] != '\0')
+                return FALSE;
+
+        return memcmp (orig, str, str_len) == 0;
+}
+
+/*
+ * Order the key @str of @str_len bytes, with an optional @context as for
+ * key_matches(), against the original string @orig, in the same way as
+ * strcmp() would. msgfmt sorts the original strings with strcmp(), which
+ * stops at the NUL separating a msgid from its msgid_plural.
+ */
+static inline gint
+key_compare (const gchar *orig,
+             gsize orig_len,
+             const gchar *context,
+             gsize context_len,
+             const gchar *str,
+             gsize str_len)
+{
+        gint res;
+
+        if (context) {
+                res = memcmp (context, orig, MIN (orig_len, context_len));
+
+                if (res != 0)
+                        return res;
+
+                /* The original ends within or just after the context */
+                if (orig_len <= context_len)
+                        return 1;
+
+                if (orig[context_len] != CONTEXT_SEPARATOR)
+                        return CONTEXT_SEPARATOR - (guchar) orig[context_len];
+
+                orig += context_len + 1;
+                orig_len -= context_len + 1;
+        }
+
+        res = memcmp (str, orig, MIN (orig_len, str_len));
+
+        if (res != 0 || orig_len == str_len)
+                return res;
+
+        if (str_len < orig_len)
+                return orig[str_len] == '\0' ? 0 : -1;
+
+        return 1;
+}
+
+/*
+ * Binary search the sorted original strings table, for files which have no
+ * hash table.
+ */
+static gboolean
+find_translation_index_sorted (MoFile *self,
+                               const gchar *context,
+                               gsize context_len,
+                               const gchar *str,
+                               gsize str_len,
+                               guint32 *indexp,
+                               GError **error)
+{
+        guint32 lo = 0, hi = self->header.nstrings, mid;
+        const gchar *orig;
+        gsize orig_len;
+        gint res;
+
+        while (lo < hi) {
+                mid = lo + (hi - lo) / 2;
+
+                orig = get_orig_string (self, mid, &orig_len, error);
+                if (!orig)
+                        return FALSE;
+
+                res = key_compare (orig, orig_len, context, context_len, str, str_len);
+
+                if (res == 0) {
+                        *indexp = mid;
+                        return TRUE;
+                }
+
+                if (res < 0)
+                        hi = mid;
+                else
+                        lo = mid + 1;
+        }
+
+        return FALSE;
+}
+
+/*
+ * The hash table probe for files which passed validate_mo_file(): every slot
+ * and string offset is already known to be good, so nothing is rechecked.
+ */
+static gboolean
+find_translation_index_validated (MoFile *self,
+                                  const gchar *context,
+                                  gsize context_len,
+                                  const gchar *str,
+                                  gsize str_len,
+                                  guint32 V,
+                                  guint32 *indexp)
+{
+        const guint32 *hash_tab = self->hash_tab;
+        const guint32 *orig_tab = self->orig_tab;
+        guint32 S, hash_cursor, orig_hash_cursor, increment, index;
+
+        S = self->header.hash_tab_size;
+
+        hash_cursor = V % S;
+        orig_hash_cursor = hash_cursor;
+        increment = 1 + (V % (S - 2));
+
+        while ((index = hash_tab[hash_cursor]) != 0) {
+                index--;
+
+                if (key_matches ((const gchar *) self->data + orig_tab[2 * index + 1],
+                                 orig_tab[2 * index],
+                                 context,
+                                 context_len,
+                                 str,
+                                 str_len)) {
+                        *indexp = index;
+                        return TRUE;
+                }
+
+                hash_cursor += increment;
+                if (hash_cursor >= S)
+                        hash_cursor -= S;
+
+                if (hash_cursor == orig_hash_cursor)
+                        break;
+        }
+
+        return FALSE;
+}
+
+/*
+ * Find the index of the @str_len bytes at @str, whose hashpjw() value is @V,
+ * in the original strings table, using our own index if we built one, or else
+ * by probing the file's hash table, or by binary search if it has none.
+ * Returns TRUE and sets @indexp if found. A missing string returns FALSE
+ * without setting @error; @error is only set if the file turns out to be
+ * malformed while probing.
+ *
+ * If @context is not %NULL, the key is "@context\004@str", and @V must be
+ * the hashpjw_context() of it.
+ */
+static gboolean
+find_translation_index (MoFile *self,
+                        const gchar *context,
+                        gsize context_len,
+                        const gchar *str,
+                        gsize str_len,
+                        guint32 V,
+                        guint32 *indexp,
+                        GError **error)
+{
+        guint32 S, hash_cursor, orig_hash_cursor, increment, index;
+        const gchar *orig;
+        gsize orig_len;
+
+        g_return_val_if_fail (MO_IS_FILE (self), FALSE);
+        g_return_val_if_fail (self->filename != NULL || self->data != NULL, FALSE);
+
+        if (self->index && context)
+                return mo_index_lookup_context (self->index,
+                                                context,
+                                                context_len,
+                                                str,
+                                                str_len,
+                                                mo_index_hash_context (context,
+                                                                       context_len,
+                                                                       str,
+                                                                       str_len),
+                                                indexp);
+
+        if (self->index)
+                return mo_index_lookup (self->index,
+                                        str,
+                                        str_len,
+                                        mo_index_hash (str, str_len),
+                                        indexp);
+
+        if (self->header.hash_tab_size == 0)
+                return find_translation_index_sorted (self,
+                                                      context,
+                                                      context_len,
+                                                      str,
+                                                      str_len,
+                                                      indexp,
+                                                      error);
+
+        if (self->hash_tab)
+                return find_translation_index_validated (self,
+                                                         context,
+                                                         context_len,
+                                                         str,
+                                                         str_len,
+                                                         V,
+                                                         indexp);
+
+        S = self->header.hash_tab_size;
+
+        hash_cursor = V % S;
+        orig_hash_cursor = hash_cursor;
+        increment = 1 + (V % (S - 2));
+
+        while (1) {
+                index = get_uint32 (self->data,
+                                    self->header.hash_tab_offset +
+                                            sizeof (guint32) * hash_cursor,
+                                    self->swapped,
+                                    self->length,
+                                    error);
+                if (index == 0)
+                        return FALSE;
+
+                if (index == G_MAXUINT32)
+                        return FALSE;
+
+                index--;
+
+                orig = get_orig_string (self, index, &orig_len, error);
+                if (!orig)
+                        return FALSE;
+
+                if (key_matches (orig, orig_len, context, context_len, str, str_len)) {
+                        *indexp = index;
+                        return TRUE;
+                }
+
+                hash_cursor += increment;
+                hash_cursor %= S;
+
+                if (hash_cursor == orig_hash_cursor)
+                        return FALSE;
+        }
+}
+
+static const gchar *
+get_translation (MoFile *self,
+                 const gchar *trans,
+                 gsize trans_len,
+                 guint32 hash,
+                 GError **error)
+{
+        guint32 idx;
+        const gchar *ret = NULL;
+        GError *err = NULL;
+
+        if (find_translation_index (self, NULL, 0, trans, trans_len, hash, &idx, &err))
+                ret = get_translation_string (self, idx, NULL, &err);
+
+        if (err) {
+                g_propagate_error (error, err);
+        } else if (!ret) {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_STRING_NOT_FOUND_ERROR,
+                             "Translation for '%s' not found in '%s'",
+                             trans,
+                             self->filename,
+                             NULL);
+        }
+
+        return ret;
+}
+
+/**
+ * mo_file_get_translation:
+ * @self: An initialised #MoFile.
+ * @str: Untranslated (in the 'C' locale) string.
+ * @error: Return location for a GError, or NULL.
+ *
+ * Retrieve the translated value of a string. This is safe to call from
+ * several threads at once on the same #MoFile.
+ *
+ * Returns (transfer full): the translated string, or NULL if a translation is
+ * not found. If NULL is returned, @error will be set.
+ */
+gchar *
+mo_file_get_translation (MoFile *self, const gchar *str, GError **error)
+{
+        GError *local_error = NULL;
+        gsize len;
+        guint32 hash;
+        const gchar *trans;
+
+        if (!MO_IS_FILE (self) || !str || (!self->filename && !self->data)) {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_INVALID_FILE_ERROR,
+                             "The MoFile object is invalid.",
+                             NULL);
+                return NULL;
+        }
+
+        if (self->header.nstrings == 0) {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_INVALID_FILE_ERROR,
+                             "'%s' contains no strings",
+                             self->filename,
+                             NULL);
+                return NULL;
+        }
+
+        len = strlen (str);
+        hash = hashpjw (str, len);
+
+        if (!mo_cache_lookup (self->translations_cache, str, hash, &trans)) {
+                trans = get_translation (self, str, len, hash, &local_error);
+
+                /* Don't remember a file error as a missing string */
+                if (trans || g_error_matches (local_error,
+                                              MO_FILE_ERROR,
+                                              MO_FILE_STRING_NOT_FOUND_ERROR))
+                        mo_cache_insert (self->translations_cache, str, hash, trans);
+
+                if (local_error)
+                        g_propagate_error (error, local_error);
+        } else if (!trans) {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_STRING_NOT_FOUND_ERROR,
+                             "Translation for '%s' not found in '%s'",
+                             str,
+                             self->filename,
+                             NULL);
+        }
+
+        return g_strdup (trans);
+}
+
+/**
+ * mo_file_lookup_translation:
+ * @self: An initialised #MoFile.
+ * @str: Untranslated (in the 'C' locale) string.
+ * @length: (out) (optional): Return location for the length of the
+ * translation in bytes, not including the trailing NUL, or %NULL. For
+ * entries with plural forms this covers all of the forms, which are separated
+ * by NULs.
+ *
+ * Retrieve the translated value of a string without copying it. Unlike
+ * mo_file_get_translation(), this doesn't allocate: the returned string
+ * points directly into the data @self was loaded from. The exception is a
+ * file with #MoFile:target-charset set, where the first lookup of each
+ * translation converts it into memory which @self owns.
+ *
+ * A string which has no translation is not considered an error, so there is
+ * no #GError to fill in. %NULL is also returned if @self turns out to be
+ * malformed while looking @str up.
+ *
+ * Returns: (transfer none) (nullable): the translated string, valid for as
+ * long as @self is alive, or %NULL if no translation was found.
+ */
+const gchar *
+mo_file_lookup_translation (MoFile *self, const gchar *str, gsize *length)
+{
+        if (!str)
+                return NULL;
+
+        return mo_file_lookup_translation_len (self, str, strlen (str), length);
+}
+
+/**
+ * mo_file_lookup_translation_len:
+ * @self: An initialised #MoFile.
+ * @str: (array length=str_length): Untranslated (in the 'C' locale) string.
+ * @str_length: The length of @str in bytes.
+ * @length: (out) (optional): Return location for the length of the
+ * translation in bytes, not including the trailing NUL, or %NULL.
+ *
+ * Like mo_file_lookup_translation(), but @str is given with an explicit
+ * length and does not need to be NUL-terminated, so slices of a larger
+ * buffer can be looked up without copying them first.
+ *
+ * Returns: (transfer none) (nullable): the translated string, valid for as
+ * long as @self is alive, or %NULL if no translation was found.
+ */
+const gchar *
+mo_file_lookup_translation_len (MoFile *self,
+                                const gchar *str,
+                                gsize str_length,
+                                gsize *length)
+{
+        if (!MO_IS_FILE (self) || !str)
+                return NULL;
+
+        /* The index has its own hash, so only compute the one we need */
+        if (self->index)
+                return _mo_file_lookup_hashed (self,
+                                               NULL,
+                                               0,
+                                               str,
+                                               str_length,
+                                               0,
+                                               mo_index_hash (str, str_length),
+                                               length);
+
+        return _mo_file_lookup_hashed (self,
+                                       NULL,
+                                       0,
+                                       str,
+                                       str_length,
+                                       hashpjw (str, str_length),
+                                       0,
+                                       length);
+}
+
+/**
+ * mo_file_lookup_translation_with_context:
+ * @self: An initialised #MoFile.
+ * @context: The message context, the msgctxt of the string.
+ * @str: Untranslated (in the 'C' locale) string.
+ * @length: (out) (optional): Return location for the length of the
+ * translation in bytes, not including the trailing NUL, or %NULL.
+ *
+ * Retrieve the translation of @str in @context without copying it, like
+ * pgettext(). .mo files store such strings as the context and the string
+ * joined by an EOT character, but they are hashed and compared here a part at
+ * a time, so that key is never built.
+ *
+ * Returns: (transfer none) (nullable): the translated string, valid for as
+ * long as @self is alive, or %NULL if no translation was found.
+ */
+const gchar *
+mo_file_lookup_translation_with_context (MoFile *self,
+                                         const gchar *context,
+                                         const gchar *str,
+                                         gsize *length)
+{
+        gsize context_len, str_len;
+
+        if (!MO_IS_FILE (self) || !context || !str)
+                return NULL;
+
+        context_len = strlen (context);
+        str_len = strlen (str);
+
+        if (self->index)
+                return _mo_file_lookup_hashed (self,
+                                               context,
+                                               context_len,
+                                               str,
+                                               str_len,
+                                               0,
+                                               mo_index_hash_context (context,
+                                                                      context_len,
+                                                                      str,
+                                                                      str_len),
+                                               length);
+
+        return _mo_file_lookup_hashed (self,
+                                       context,
+                                       context_len,
+                                       str,
+                                       str_len,
+                                       hashpjw_context (context, context_len, str, str_len),
+                                       0,
+                                       length);
+}
+
+/*
+ * Look up to LOOKUP_BATCH_SIZE keys in a validated file at once. Each stage
+ * issues prefetches for every key before the next stage reads what they
+ * fetched, so that the cache misses of the different keys overlap instead of
+ * being taken one after another: first the hash table slots, then the
+ * original string table entries, then the original strings themselves.
+ */
+static guint
+lookup_batch_validated (MoFile *self,
+                        const gchar * const *strs,
+                        gsize n_strs,
+                        const gchar **translations,
+                        gsize *lengths)
+{
+        guint32 hashes[LOOKUP_BATCH_SIZE];
+        gsize str_lens[LOOKUP_BATCH_SIZE];
+        guint32 indices[LOOKUP_BATCH_SIZE];
+        const guint32 *hash_tab = self->hash_tab;
+        const guint32 *orig_tab = self->orig_tab;
+        guint32 S = self->header.hash_tab_size;
+        guint n_found = 0;
+
+        g_assert (n_strs <= LOOKUP_BATCH_SIZE);
+
+        for (gsize i = 0; i < n_strs; ++i) {
+                str_lens[i] = strlen (strs[i]);
+                hashes[i] = hashpjw (strs[i], str_lens[i]);
+                MO_PREFETCH (&hash_tab[hashes[i] % S]);
+        }
+
+        for (gsize i = 0; i < n_strs; ++i) {
+                indices[i] = hash_tab[hashes[i] % S];
+
+                if (indices[i] != 0)
+                        MO_PREFETCH (&orig_tab[2 * (indices[i] - 1)]);
+        }
+
+        for (gsize i = 0; i < n_strs; ++i) {
+                if (indices[i] != 0)
+                        MO_PREFETCH (self->data + orig_tab[2 * (indices[i] - 1) + 1]);
+        }
+
+        for (gsize i = 0; i < n_strs; ++i) {
+                guint32 idx = indices[i];
+
+                translations[i] = NULL;
+
+                if (idx == 0)
+                        continue;
+
+                idx--;
+
+                /* The first slot was a collision, so carry on probing */
+                if (!key_matches ((const gchar *) self->data + orig_tab[2 * idx + 1],
+                                  orig_tab[2 * idx],
+                                  NULL,
+                                  0,
+                                  strs[i],
+                                  str_lens[i]) &&
+                    !find_translation_index_validated (self,
+                                                       NULL,
+                                                       0,
+                                                       strs[i],
+                                                       str_lens[i],
+                                                       hashes[i],
+                                                       &idx))
+                        continue;
+
+                translations[i] = get_translation_string (self,
+                                                          idx,
+                                                          lengths ? &lengths[i] : NULL,
+                                                          NULL);
+
+                if (translations[i])
+                        n_found++;
+        }
+
+        return n_found;
+}
+
+/*
+ * The same as lookup_batch_validated(), for files with an index: the index
+ * slots of all of the keys are prefetched before any of them is compared.
+ */
+static guint
+lookup_batch_indexed (MoFile *self,
+                      const gchar * const *strs,
+                      gsize n_strs,
+                      const gchar **translations,
+                      gsize *lengths)
+{
+        guint64 hashes[LOOKUP_BATCH_SIZE];
+        gsize str_lens[LOOKUP_BATCH_SIZE];
+        guint n_found = 0;
+        guint32 idx;
+
+        g_assert (n_strs <= LOOKUP_BATCH_SIZE);
+
+        for (gsize i = 0; i < n_strs; ++i) {
+                str_lens[i] = strlen (strs[i]);
+                hashes[i] = mo_index_hash (strs[i], str_lens[i]);
+                mo_index_prefetch (self->index, hashes[i]);
+        }
+
+        for (gsize i = 0; i < n_strs; ++i) {
+                translations[i] = NULL;
+
+                if (!mo_index_lookup (self->index, strs[i], str_lens[i], hashes[i], &idx))
+                        continue;
+
+                /* This may be an expanded system dependent string */
+                translations[i] = get_translation_string (self,
+                                                          idx,
+                                                          lengths ? &lengths[i] : NULL,
+                                                          NULL);
+
+                if (translations[i])
+                        n_found++;
+        }
+
+        return n_found;
+}
+
+/**
+ * mo_file_lookup_key:
+ * @self: An initialised #MoFile.
+ * @key: A #MoKey for the untranslated (in the 'C' locale) string.
+ * @length: (out) (optional): Return location for the length of the
+ * translation in bytes, not including the trailing NUL, or %NULL.
+ *
+ * Like mo_file_lookup_translation(), but for a string which has been
+ * prepared as a #MoKey, so that it doesn't have to be hashed again.
+ *
+ * Returns: (transfer none) (nullable): the translated string, valid for as
+ * long as @self is alive, or %NULL if no translation was found.
+ */
+const gchar *
+mo_file_lookup_key (MoFile *self, const MoKey *key, gsize *length)
+{
+        if (!MO_IS_FILE (self) || !key)
+                return NULL;
+
+        return _mo_file_lookup_hashed (self,
+                                       NULL,
+                                       0,
+                                       key->msgid,
+                                       key->length,
+                                       key->hash,
+                                       key->index_hash,
+                                       length);
+}
+
+/*
+ * Hash and compare header field names without regard to case, as they are
+ * in mail style headers.
+ */
+static guint
+ascii_case_hash (gconstpointer key)
+{
+        guint hash = 5381;
+
+        for (const gchar *p = key; *p; ++p)
+                hash = hash * 33 + (guchar) g_ascii_tolower (*p);
+
+        return hash;
+}
+
+static gboolean
+ascii_case_equal (gconstpointer a, gconstpointer b)
+{
+        return g_ascii_strcasecmp (a, b) == 0;
+}
+
+/*
+ * Pull the charset parameter out of a Content-Type value such as
+ * "text/plain; charset=UTF-8".
+ */
+static gchar *
+parse_charset (const gchar *content_type)
+{
+        const gchar *p, *end;
+
+        for (p = content_type; *p; ++p) {
+                if (g_ascii_strncasecmp (p, "charset=", strlen ("charset=")) == 0)
+                        break;
+        }
+
+        if (!*p)
+                return NULL;
+
+        p += strlen ("charset=");
+
+        for (end = p; *end && *end != ';' && !g_ascii_isspace (*end); ++end)
+                ;
+
+        if (end == p)
+                return NULL;
+
+        return g_strndup (p, end - p);
+}
+
+static void
+mo_file_metadata_free (MoFileMetadata *metadata)
+{
+        g_hash_table_unref (metadata->fields);
+        g_free (metadata->charset);
+        g_free (metadata);
+}
+
+/*
+ * Parse the file's header, the translation of "", which is made up of
+ * "Name: value" lines. This happens once, the first time any of the header
+ * is asked for; afterwards it is only read, so needs no locking.
+ */
+static const MoFileMetadata *
+get_metadata (MoFile *self)
+{
+        const gchar *header, *end, *line, *line_end, *colon, *value, *value_end;
+        const gchar *content_type;
+        MoFileMetadata *metadata;
+        gsize header_len;
+        gchar *name;
+
+        if (!g_once_init_enter (&self->metadata))
+                return self->metadata;
+
+        metadata = g_new0 (MoFileMetadata, 1);
+        metadata->fields = g_hash_table_new_full (ascii_case_hash,
+                                                  ascii_case_equal,
+                                                  g_free,
+                                                  g_free);
+
+        header = mo_file_lookup_translation_len (self, "", 0, &header_len);
+        end = header ? header + header_len : NULL;
+
+        for (line = header; line && line < end; line = line_end + 1) {
+                line_end = memchr (line, '\n', end - line);
+                if (!line_end)
+                        line_end = end;
+
+                colon = memchr (line, ':', line_end - line);
+                if (!colon || colon == line)
+                        continue;
+
+                value = colon + 1;
+                value_end = line_end;
+
+                while (value < value_end && g_ascii_isspace (*value))
+                        value++;
+
+                while (value_end > value && g_ascii_isspace (value_end[-1]))
+                        value_end--;
+
+                name = g_strndup (line, colon - line);
+
+                /* The first of any repeated fields wins */
+                if (g_hash_table_contains (metadata->fields, name)) {
+                        g_free (name);
+                        continue;
+                }
+
+                g_hash_table_insert (metadata->fields,
+                                     name,
+                                     g_strndup (value, value_end - value));
+        }
+
+        content_type = g_hash_table_lookup (metadata->fields, "Content-Type");
+        if (content_type)
+                metadata->charset = parse_charset (content_type);
+
+        g_once_init_leave (&self->metadata, metadata);
+
+        return self->metadata;
+}
+
+static const MoPlural *
+get_plural (MoFile *self)
+{
+        const gchar *plural_forms;
+
+        if (g_once_init_enter (&self->plural)) {
+                plural_forms = g_hash_table_lookup (get_metadata (self)->fields,
+                                                    "Plural-Forms");
+                g_once_init_leave (&self->plural,
+                                   mo_plural_new (plural_forms,
+                                                  plural_forms ? strlen (plural_forms) : 0));
+        }
+
+        return self->plural;
+}
+
+/**
+ * mo_file_get_header:
+ * @self: An initialised #MoFile.
+ *
+ * Get all of the fields of the file's header, the translation of the empty
+ * string, which is made up of "Name: value" lines. The header is parsed the
+ * first time any of it is asked for, and kept. Field names are looked up in
+ * the returned table without regard to case.
+ *
+ * Returns: (transfer none) (element-type utf8 utf8): the header's fields,
+ * mapping names to values, which is empty if the file has no header.
+ */
+GHashTable *
+mo_file_get_header (MoFile *self)
+{
+        if (!MO_IS_FILE (self))
+                return NULL;
+
+        return get_metadata (self)->fields;
+}
+
+/**
+ * mo_file_get_header_value:
+ * @self: An initialised #MoFile.
+ * @name: The name of a header field, such as "Last-Translator".
+ *
+ * Get the value of a field of the file's header, as mo_file_get_header()
+ * does.
+ *
+ * Returns: (transfer none) (nullable): the value, without surrounding
+ * whitespace, or %NULL if the header has no such field.
+ */
+const gchar *
+mo_file_get_header_value (MoFile *self, const gchar *name)
+{
+        if (!MO_IS_FILE (self) || !name)
+                return NULL;
+
+        return g_hash_table_lookup (get_metadata (self)->fields, name);
+}
+
+/**
+ * mo_file_get_charset:
+ * @self: An initialised #MoFile.
+ *
+ * Get the character set the file's translations are stored in, from the
+ * charset parameter of its Content-Type header field.
+ *
+ * Returns: (transfer none) (nullable): the character set, such as "UTF-8",
+ * or %NULL if the header doesn't give one.
+ */
+const gchar *
+mo_file_get_charset (MoFile *self)
+{
+        if (!MO_IS_FILE (self))
+                return NULL;
+
+        return get_metadata (self)->charset;
+}
+
+/**
+ * mo_file_get_language:
+ * @self: An initialised #MoFile.
+ *
+ * Get the language of the file's translations, from its Language header
+ * field.
+ *
+ * Returns: (transfer none) (nullable): the language, such as "pt_BR", or
+ * %NULL if the header doesn't give one.
+ */
+const gchar *
+mo_file_get_language (MoFile *self)
+{
+        return mo_file_get_header_value (self, "Language");
+}
+
+/**
+ * mo_file_get_n_plurals:
+ * @self: An initialised #MoFile.
+ *
+ * Get the number of plural forms of the file's language, from its
+ * Plural-Forms header field. This is 2 if the field is missing or invalid,
+ * as then the English rule is used.
+ *
+ * Returns: the number of plural forms.
+ */
+guint
+mo_file_get_n_plurals (MoFile *self)
+{
+        if (!MO_IS_FILE (self))
+                return 0;
+
+        return mo_plural_get_n_plurals (get_plural (self));
+}
+
+/**
+ * mo_file_get_plural_expression:
+ * @self: An initialised #MoFile.
+ *
+ * Get the expression which chooses between the plural forms of the file's
+ * language, from its Plural-Forms header field, such as "(n != 1)". If the
+ * field is missing or invalid, this is the English rule which is used
+ * instead.
+ *
+ * Returns: (transfer none): the plural expression.
+ */
+const gchar *
+mo_file_get_plural_expression (MoFile *self)
+{
+        if (!MO_IS_FILE (self))
+                return NULL;
+
+        return mo_plural_get_expression (get_plural (self));
+}
+
+/**
+ * mo_file_lookup_plural:
+ * @self: An initialised #MoFile.
+ * @msgid: Untranslated (in the 'C' locale) singular form of the string.
+ * @msgid_plural: Untranslated plural form of the string.
+ * @n: The number the string is for.
+ * @length: (out) (optional): Return location for the length of the
+ * returned string in bytes, not including the trailing NUL, or %NULL.
+ *
+ * Retrieve the right plural form of a translation for @n, like ngettext().
+ * Which form that is comes from the "Plural-Forms:" field of the file's
+ * header, which is compiled the first time it is needed, and the forms for
+ * small @n are worked out in advance, so this doesn't allocate, other than
+ * when a translation is first converted to #MoFile:target-charset.
+ *
+ * If there is no translation, @msgid is returned when @n is 1 and
+ * @msgid_plural otherwise. If the translation has fewer forms than @n calls
+ * for, its first form is returned.
+ *
+ * Returns: (transfer none) (nullable): the plural form, valid for as long as
+ * @self is alive, or %NULL if @self or @msgid is invalid.
+ */
+const gchar *
+mo_file_lookup_plural (MoFile *self,
+                       const gchar *msgid,
+                       const gchar *msgid_plural,
+                       gulong n,
+                       gsize *length)
+{
+        const gchar *trans, *form, *end, *next;
+        gsize trans_len;
+        guint index;
+
+        if (!MO_IS_FILE (self) || !msgid || !msgid_plural)
+                return NULL;
+
+        trans = mo_file_lookup_translation (self, msgid, &trans_len);
+
+        if (!trans) {
+                trans = n == 1 ? msgid : msgid_plural;
+
+                if (length)
+                        *length = strlen (trans);
+
+                return trans;
+        }
+
+        form = trans;
+        end = trans + trans_len;
+
+        for (index = mo_plural_eval (get_plural (self), n); index > 0; index--) {
+                next = memchr (form, '\0', end - form);
+
+                if (!next || next + 1 >= end) {
+                        form = trans;
+                        break;
+                }
+
+                form = next + 1;
+        }
+
+        if (length) {
+                next = memchr (form, '\0', end - form);
+                *length = (next ? next : end) - form;
+        }
+
+        return form;
+}
+
+/**
+ * mo_file_lookup_translations:
+ * @self: An initialised #MoFile.
+ * @strs: (array length=n_strs): Untranslated (in the 'C' locale) strings.
+ * @n_strs: The number of strings in @strs.
+ * @translations: (out caller-allocates) (array length=n_strs): Return
+ * location for the translations, which must have room for @n_strs entries.
+ * @lengths: (out caller-allocates) (array length=n_strs) (optional): Return
+ * location for the lengths of the translations, or %NULL.
+ *
+ * Look up many strings at once, as mo_file_lookup_translation() would. Each
+ * element of @translations is set to the translation of the string at the
+ * same position in @strs, or to %NULL if it has none. Elements of @lengths
+ * are only set for strings which were found.
+ *
+ * On a file loaded with #MoFile:validate or #MoFile:build-index set, the
+ * hash table probes for several strings are interleaved, so that the memory
+ * latency of one lookup is hidden behind the others. This is considerably
+ * faster than looking strings up one at a time in large catalogues.
+ *
+ * Returns: the number of strings which were found.
+ */
+guint
+mo_file_lookup_translations (MoFile *self,
+                             const gchar * const *strs,
+                             gsize n_strs,
+                             const gchar **translations,
+                             gsize *lengths)
+{
+        guint n_found = 0;
+
+        if (!MO_IS_FILE (self) || !strs || !translations)
+                return 0;
+
+        if (self->index) {
+                for (gsize i = 0; i < n_strs; i += LOOKUP_BATCH_SIZE)
+                        n_found += lookup_batch_indexed (self,
+                                                         strs + i,
+                                                         MIN (n_strs - i, LOOKUP_BATCH_SIZE),
+                                                         translations + i,
+                                                         lengths ? lengths + i : NULL);
+
+                return n_found;
+        }
+
+        if (!self->hash_tab || self->header.nstrings == 0) {
+                for (gsize i = 0; i < n_strs; ++i) {
+                        translations[i] = mo_file_lookup_translation (self,
+                                                                      strs[i],
+                                                                      lengths ? &lengths[i] : NULL);
+                        if (translations[i])
+                                n_found++;
+                }
+
+                return n_found;
+        }
+
+        for (gsize i = 0; i < n_strs; i += LOOKUP_BATCH_SIZE)
+                n_found += lookup_batch_validated (self,
+                                                   strs + i,
+                                                   MIN (n_strs - i, LOOKUP_BATCH_SIZE),
+                                                   translations + i,
+                                                   lengths ? lengths + i : NULL);
+
+        return n_found;
+}
+
+/*
+ * The mean number of hash table slots which a lookup of a string that is in
+ * the validated file @self reads before finding it.
+ */
+static gdouble
+get_mean_probe_length (MoFile *self)
+{
+        guint32 S = self->header.hash_tab_size;
+        guint64 n_probes = 0;
+        guint32 V, hash_cursor, increment;
+        const gchar *orig;
+
+        if (!self->hash_tab || S == 0 || self->header.nstrings == 0)
+                return 0;
+
+        for (guint32 i = 0; i < self->header.nstrings; ++i) {
+                orig = (const gchar *) self->data + self->orig_tab[2 * i + 1];
+                V = hashpjw (orig, strlen (orig));
+                hash_cursor = V % S;
+                increment = 1 + (V % (S - 2));
+
+                for (guint32 n = 0; n < S; ++n) {
+                        n_probes++;
+
+                        if (self->hash_tab[hash_cursor] == i + 1 ||
+                            self->hash_tab[hash_cursor] == 0)
+                                break;
+
+                        hash_cursor += increment;
+                        if (hash_cursor >= S)
+                                hash_cursor -= S;
+                }
+        }
+
+        return (gdouble) n_probes / self->header.nstrings;
+}
+
+/**
+ * mo_file_get_stats:
+ * @self: An initialised #MoFile.
+ * @stats: (out caller-allocates): Return location for the statistics.
+ *
+ * Fill in @stats with information about the lookup structures of @self, to
+ * help decide whether #MoFile:build-index is worth setting for it. Measuring
+ * the file's own hash table walks all of it, so this is not cheap.
+ */
+void
+mo_file_get_stats (MoFile *self, MoFileStats *stats)
+{
+        gsize cache_size, cache_used, converted_size, converted_used;
+
+        g_return_if_fail (stats != NULL);
+
+        memset (stats, 0, sizeof (MoFileStats));
+
+        g_return_if_fail (MO_IS_FILE (self));
+
+        stats->n_strings = self->header.nstrings;
+        stats->hash_tab_size = self->header.hash_tab_size;
+        stats->hash_tab_mean_probes = get_mean_probe_length (self);
+        stats->index_size = mo_index_get_size (self->index);
+        stats->index_build_time = self->index_build_time;
+
+        mo_cache_get_memory_usage (self->translations_cache,
+                                   &cache_size,
+                                   &cache_used);
+        mo_arena_get_usage (self->arena, &converted_size, &converted_used);
+
+        stats->arena_size = cache_size + converted_size;
+        stats->arena_used = cache_used + converted_used;
+
+        stats->reverse_index_size = _mo_file_get_reverse_index_size (self);
+        stats->search_index_size = _mo_file_get_search_index_size (self);
+}
+
+/**
+ * mo_file_get_translations:
+ * @self: An initialised #MoFile.
+ *
+ * Retrieve all translations. This copies every string in the file; to look
+ * at each of them once, a #MoFileIter is much cheaper.
+ *
+ * Returns: (element-type gchar* gchar*) (transfer full): A #GHashTable
+ * containing a mapping from original to translated strings.
+ */
+GHashTable *
+mo_file_get_translations (MoFile *self, GError **error)
+{
+        const gchar *orig, *trans;
+        gsize trans_len;
+        GHashTable *ret;
+
+        if (!MO_IS_FILE (self) || !self->data)
+                return NULL;
+
+        ret = g_hash_table_new_full (g_str_hash,
+                                     g_str_equal,
+                                     g_free,
+                                     g_free);
+
+        for (unsigned int i = 0; i < get_n_entries (self); ++i) {
+                orig = get_orig_string (self, i, NULL, error);
+
+                if (!orig) {
+                        g_hash_table_unref (ret);
+                        return NULL;
+                }
+
+                trans = get_trans_string (self, i, &trans_len, error);
+
+                if (!trans) {
+                        g_hash_table_unref (ret);
+                        return NULL;
+                }
+
+                if (is_missing (self, trans_len))
+                        continue;
+
+                if (self->converted)
+                        trans = convert_translation (self, i, trans, &trans_len);
+
+                g_hash_table_insert (ret,
+                                     g_strdup (orig),
+                                     g_strdup (trans));
+        }
+
+        return ret;
+}
+
+/**
+ * mo_file_get_translations_view:
+ * @self: An initialised #MoFile.
+ * @error: Return location for a #GError, or %NULL.
+ *
+ * Retrieve all translations, like mo_file_get_translations(), but without
+ * copying them: the keys and values of the view's table point into @self,
+ * and the view holds a reference on @self to keep them valid.
+ *
+ * Returns: (transfer full): A #MoView mapping original to translated
+ * strings. Free it with mo_view_unref().
+ */
+MoView *
+mo_file_get_translations_view (MoFile *self, GError **error)
+{
+        const gchar *orig, *trans;
+        gsize trans_len;
+        MoView *ret;
+
+        if (!MO_IS_FILE (self) || !self->data)
+                return NULL;
+
+        ret = mo_view_new (G_OBJECT (self), NULL);
+
+        for (guint32 i = 0; i < get_n_entries (self); ++i) {
+                orig = get_orig_string (self, i, NULL, error);
+
+                if (!orig) {
+                        mo_view_unref (ret);
+                        return NULL;
+                }
+
+                trans = get_trans_string (self, i, &trans_len, error);
+
+                if (!trans) {
+                        mo_view_unref (ret);
+                        return NULL;
+                }
+
+                if (is_missing (self, trans_len))
+                        continue;
+
+                if (self->converted)
+                        trans = convert_translation (self, i, trans, &trans_len);
+
+                mo_view_insert (ret, orig, (gpointer) trans);
+        }
+
+        return ret;
+}
+
+/**
+ * mo_file_get_n_entries:
+ * @self: An initialised #MoFile.
+ *
+ * Get the number of entries in @self, including its header and any system
+ * dependent strings.
+ *
+ * Returns: The number of entries.
+ */
+guint
+mo_file_get_n_entries (MoFile *self)
+{
+        if (!MO_IS_FILE (self) || !self->data)
+                return 0;
+
+        return get_n_entries (self);
+}
+
+/*
+ * Split the original string @orig of @orig_len bytes, which is
+ * "[msgctxt\004]msgid[\0msgid_plural]", into @entry.
+ */
+static void
+split_orig (MoEntry *entry, const gchar *orig, gsize orig_len)
+{
+        const gchar *separator, *end;
+        gsize msgid_len;
+
+        end = memchr (orig, '\0', orig_len);
+        msgid_len = end ? (gsize) (end - orig) : orig_len;
+
+        separator = memchr (orig, CONTEXT_SEPARATOR, msgid_len);
+
+        if (separator) {
+                entry->context = orig;
+                entry->context_length = separator - orig;
+                entry->msgid = separator + 1;
+                entry->msgid_length = msgid_len - entry->context_length - 1;
+        } else {
+                entry->context = NULL;
+                entry->context_length = 0;
+                entry->msgid = orig;
+                entry->msgid_length = msgid_len;
+        }
+
+        if (end) {
+                entry->msgid_plural = end + 1;
+                entry->msgid_plural_length = orig_len - msgid_len - 1;
+        } else {
+                entry->msgid_plural = NULL;
+                entry->msgid_plural_length = 0;
+        }
+}
+
+/*
+ * Fill in @entry from the entry at @index, which must be in range, without
+ * copying anything.
+ */
+static gboolean
+get_entry (MoFile *self, guint32 index, MoEntry *entry, GError **error)
+{
+        const gchar *orig, *trans;
+        gsize orig_len, trans_len;
+
+        orig = get_orig_string (self, index, &orig_len, error);
+
+        if (!orig)
+                return FALSE;
+
+        trans = get_trans_string (self, index, &trans_len, error);
+
+        if (!trans)
+                return FALSE;
+
+        entry->index = index;
+        split_orig (entry, orig, orig_len);
+
+        if (is_missing (self, trans_len)) {
+                entry->translation = NULL;
+                entry->translation_length = 0;
+                entry->n_translations = 0;
+                return TRUE;
+        }
+
+        if (G_UNLIKELY (self->converted))
+                trans = convert_translation (self, index, trans, &trans_len);
+
+        entry->translation = trans;
+        entry->translation_length = trans_len;
+        entry->n_translations = 1;
+
+        /* Only entries with a plural can have more than one form */
+        if (entry->msgid_plural) {
+                for (const gchar *p = trans;
+                     (p = memchr (p, '\0', trans + trans_len - p));
+                     ++p)
+                        entry->n_translations++;
+        }
+
+        return TRUE;
+}
+
+/**
+ * mo_file_get_entry:
+ * @self: An initialised #MoFile.
+ * @index: The position of the entry, from 0 to mo_file_get_n_entries() - 1.
+ * @entry: (out caller-allocates): Return location for the entry.
+ * @error: Return location for a #GError, or %NULL.
+ *
+ * Get the entry at @index of @self, split into its parts. Nothing is
+ * copied: the strings in @entry point into @self.
+ *
+ * Returns: %TRUE if @entry was filled in, or %FALSE if the entry is not in
+ * the file or couldn't be read, in which case @error is set.
+ */
+gboolean
+mo_file_get_entry (MoFile *self, guint index, MoEntry *entry, GError **error)
+{
+        g_return_val_if_fail (MO_IS_FILE (self), FALSE);
+        g_return_val_if_fail (entry != NULL, FALSE);
+
+        if (!self->data || index >= get_n_entries (self)) {
+                g_set_error (error,
+                             MO_FILE_ERROR,
+                             MO_FILE_STRING_NOT_FOUND_ERROR,
+                             "'%s' has no entry %u",
+                             self->filename,
+                             index,
+                             NULL);
+                return FALSE;
         }
 
-        /* See if we're overflowed or pointed off the end of the file */
-        string_end = osum3 (string_offset, string_length, 1);
+        return get_entry (self, index, entry, error);
+}
+
+typedef struct {
+        MoFile *file;
+        guint position;
+        guint end;
+} MoFileRealIter;
+
+G_STATIC_ASSERT (sizeof (MoFileRealIter) <= sizeof (MoFileIter));
+
+/**
+ * mo_file_iter_init:
+ * @iter: An uninitialised #MoFileIter.
+ * @file: An initialised #MoFile.
+ *
+ * Set @iter up to walk all of the entries of @file in the order they are
+ * stored in, for example:
+ *
+ * |[<!-- language="C" -->
+ * MoFileIter iter;
+ * MoEntry entry;
+ *
+ * mo_file_iter_init (&iter, file);
+ *
+ * while (mo_file_iter_next (&iter, &entry, &error))
+ *   do_something_with (entry.msgid, entry.translation);
+ * ]|
+ *
+ * Unlike mo_file_get_translations(), this copies nothing, and every entry
+ * is visited, including the header and entries with a context or plural
+ * forms. The iterator does not hold a reference to @file, which must stay
+ * alive while it is being used.
+ */
+void
+mo_file_iter_init (MoFileIter *iter, MoFile *file)
+{
+        mo_file_iter_init_range (iter, file, 0, G_MAXUINT);
+}
+
+/**
+ * mo_file_iter_init_range:
+ * @iter: An uninitialised #MoFileIter.
+ * @file: An initialised #MoFile.
+ * @start: The position of the first entry to visit.
+ * @end: The position after the last entry to visit. This may be more than
+ * mo_file_get_n_entries(), to go up to the end of the file.
+ *
+ * Like mo_file_iter_init(), but only visit the entries from @start to
+ * @end - 1, so that several threads can each walk part of a file.
+ */
+void
+mo_file_iter_init_range (MoFileIter *iter,
+                         MoFile *file,
+                         guint start,
+                         guint end)
+{
+        MoFileRealIter *ri = (MoFileRealIter *) iter;
 
-        if (string_end == G_MAXSIZE || string_end > (size_t) length) {
-                g_set_error (error,
-                             MO_FILE_ERROR,
-                             MO_FILE_INVALID_FILE_ERROR,
-                             "File is truncated.",
-                             NULL);
-                return NULL;
-        }
+        g_return_if_fail (iter != NULL);
+        g_return_if_fail (MO_IS_FILE (file));
 
-        if (data[string_offset + string_length] != '\0') {
-                g_set_error (error,
-                             MO_FILE_ERROR,
-                             MO_FILE_INVALID_FILE_ERROR,
-                             "File contains a non-NUL terminated string.",
-                             NULL);
-                return NULL;
-        }
+        ri->file = file;
+        ri->end = MIN (end, mo_file_get_n_entries (file));
+        ri->position = MIN (start, ri->end);
+}
 
-        /* We think we're ok now */
-        if (lengthp)
-                *lengthp = string_length + 1;
+/**
+ * mo_file_iter_next:
+ * @iter: A #MoFileIter.
+ * @entry: (out caller-allocates): Return location for the next entry.
+ * @error: Return location for a #GError, or %NULL.
+ *
+ * Advance @iter to the next entry which has a translation and fill @entry in
+ * with it, as mo_file_get_entry() does.
+ *
+ * Returns: %TRUE if @entry was filled in, or %FALSE if there are no more
+ * entries or the next one couldn't be read, in which case @error is set.
+ */
+gboolean
+mo_file_iter_next (MoFileIter *iter, MoEntry *entry, GError **error)
+{
+        MoFileRealIter *ri = (MoFileRealIter *) iter;
 
-        return (const gchar *) data + string_offset;
+        g_return_val_if_fail (iter != NULL, FALSE);
+        g_return_val_if_fail (entry != NULL, FALSE);
+
+        while (ri->position < ri->end) {
+                if (!get_entry (ri->file, ri->position++, entry, error))
+                        return FALSE;
+
+                if (entry->translation)
+                        return TRUE;
+        }
+
+        return FALSE;
 }
 
-static const gchar *
-get_translation (MoFile *self,
-                 const gchar *trans,
-                 GError **error)
+/**
+ * mo_entry_get_plural_form:
+ * @entry: A #MoEntry.
+ * @n: Which plural form to get, from 0 to @entry's n_translations - 1.
+ * @length: (out) (optional): Return location for the length of the form in
+ * bytes, or %NULL.
+ *
+ * Get one of the forms of @entry's translation. Form 0 is the whole
+ * translation of an entry without plural forms.
+ *
+ * Returns: (transfer none) (nullable): The form, which is nul-terminated, or
+ * %NULL if @n is out of range.
+ */
+const gchar *
+mo_entry_get_plural_form (const MoEntry *entry, guint n, gsize *length)
 {
-        int S, hash_cursor, orig_hash_cursor, increment, idx;
-        unsigned int index;
-        unsigned long V;
-        const gchar *str;
+        const gchar *form, *end, *nul;
 
-        GError *err = NULL;
+        g_return_val_if_fail (entry != NULL, NULL);
 
-        g_return_val_if_fail (MO_IS_FILE (self), NULL);
-        g_return_val_if_fail (self->filename != NULL || self->data != NULL, NULL);
-        g_return_val_if_fail (self->header.hash_tab_offset != 0, NULL);
+        if (n >= entry->n_translations)
+                return NULL;
 
-        V = hashpjw (trans);
-        S = self->header.hash_tab_size;
+        form = entry->translation;
+        end = entry->translation + entry->translation_length;
 
-        hash_cursor = V % S;
-        orig_hash_cursor = hash_cursor;
-        increment = 1 + (V % (S - 2));
+        for (guint i = 0; i < n; ++i)
+                form += strlen (form) + 1;
 
-        while (1) {
-                index = get_uint32 (self->data,
-                                    self->header.hash_tab_offset +
-                                            sizeof (guint32) * hash_cursor,
-                                    self->swapped,
-                                    self->length,
-                                    error);
-                if (index == 0) {
-                        g_set_error (error,
-                                     MO_FILE_ERROR,
-                                     MO_FILE_STRING_NOT_FOUND_ERROR,
-                                     "Translation for '%s' not found in '%s'",
-                                     trans,
-                                     self->filename,
-                                     NULL);
-                        return NULL;
-                }
+        if (length) {
+                nul = memchr (form, '\0', end - form);
+                *length = (nul ? nul : end) - form;
+        }
 
-                if (index == G_MAXUINT32)
-                        return NULL;
+        return form;
+}
 
-                index--;
+static void
+reverse_index_free (MoReverseIndex *reverse)
+{
+        if (!reverse)
+                return;
 
-                str = get_string (self->data,
-                                  self->header.orig_tab_offset,
-                                  index,
-                                  self->swapped,
-                                  self->length,
-                                  NULL, /* length */
-                                  &err);
-                if (err) {
-                        g_propagate_error (error, err);
-                        return NULL;
-                }
+        mo_index_free (reverse->index);
+        g_free (reverse->next);
+        g_free (reverse->entries);
+        g_free (reverse);
+}
 
-                if (g_strcmp0 (str, trans) == 0) {
-                        idx = index;
-                        break;
-                }
+static inline gboolean
+is_header (const MoEntry *entry)
+{
+        return entry->msgid_length == 0 && !entry->context;
+}
 
-                hash_cursor += increment;
-                hash_cursor %= S;
+/*
+ * Whether @entry is worth finding by its translation: the header is not,
+ * and nor are entries which have no translation.
+ */
+static inline gboolean
+is_reversible (const MoEntry *entry)
+{
+        return entry->translation && !is_header (entry);
+}
 
-                if (hash_cursor == orig_hash_cursor) {
-                        g_set_error (error,
-                                     MO_FILE_ERROR,
-                                     MO_FILE_STRING_NOT_FOUND_ERROR,
-                                     "Translation for '%s' not found in '%s'",
-                                     trans,
-                                     self->filename,
-                                     NULL);
-                        return NULL;
+/*
+ * Index every form of every translation, the first time a reverse lookup is
+ * made. Afterwards the index is only read, so needs no locking.
+ */
+static const MoReverseIndex *
+get_reverse_index (MoFile *self)
+{
+        g_autofree guint32 *tails = NULL;
+        MoReverseIndex *reverse;
+        MoEntry entry;
+        const gchar *form;
+        gsize length;
+        guint32 n_entries, n_nodes = 0, node, head;
+
+        if (!g_once_init_enter (&self->reverse))
+                return self->reverse;
+
+        n_entries = get_n_entries (self);
+
+        for (guint32 i = 0; i < n_entries; ++i) {
+                if (get_entry (self, i, &entry, NULL) && is_reversible (&entry))
+                        n_nodes += entry.n_translations;
+        }
+
+        reverse = g_new0 (MoReverseIndex, 1);
+        reverse->n_nodes = n_nodes;
+        reverse->index = mo_index_new (n_nodes);
+        reverse->next = g_new (guint32, n_nodes);
+        reverse->entries = g_new (guint32, n_nodes);
+        tails = g_new (guint32, n_nodes);
+
+        node = 0;
+
+        for (guint32 i = 0; i < n_entries; ++i) {
+                if (!get_entry (self, i, &entry, NULL) || !is_reversible (&entry))
+                        continue;
+
+                for (guint j = 0; j < entry.n_translations; ++j, ++node) {
+                        form = mo_entry_get_plural_form (&entry, j, &length);
+
+                        reverse->next[node] = NO_ENTRY;
+                        reverse->entries[node] = i;
+
+                        if (mo_index_insert (reverse->index,
+                                             form,
+                                             length,
+                                             mo_index_hash (form, length),
+                                             node)) {
+                                tails[node] = node;
+                                continue;
+                        }
+
+                        /* Chain this entry after the others with the same
+                         * translation, unless another of its own forms
+                         * already did, in which case it is the tail */
+                        mo_index_lookup (reverse->index,
+                                         form,
+                                         length,
+                                         mo_index_hash (form, length),
+                                         &head);
+
+                        if (reverse->entries[tails[head]] == i)
+                                continue;
+
+                        reverse->next[tails[head]] = node;
+                        tails[head] = node;
                 }
         }
 
-        return get_string (self->data,
-                           self->header.trans_tab_offset,
-                           idx,
-                           self->swapped,
-                           self->length,
-                           NULL, /* length */
-                           error);
+        g_once_init_leave (&self->reverse, reverse);
+
+        return self->reverse;
 }
 
 /**
- * mo_file_get_translation:
+ * mo_file_lookup_originals:
  * @self: An initialised #MoFile.
- * @str: Untranslated (in the 'C' locale) string.
- * @error: Return location for a GError, or NULL.
+ * @translation: A translated string.
+ * @entries: (out caller-allocates) (array length=max_entries) (nullable):
+ * Return location for the entries which have @translation, or %NULL.
+ * @max_entries: The number of entries @entries has room for.
  *
- * Retrieve the translated value of a string.
+ * Find the entries whose translation, or one of whose plural forms, is
+ * @translation: the reverse of mo_file_lookup_translation(). Several
+ * entries may have the same translation, so all of them are found, in the
+ * order they are stored in the file, and as many as fit are put in
+ * @entries. The header is never found.
  *
- * Returns (transfer full): the translated string, or NULL if a translation is
- * not found. If NULL is returned, @error will be set.
+ * The reverse index this needs is built the first time it is called, and
+ * kept; mo_file_get_stats() reports how much memory it uses. With
+ * #MoFile:target-charset set, @translation is in that charset.
+ *
+ * Returns: How many entries have @translation, which may be more than
+ * @max_entries. 0 means that none do.
  */
-gchar *
-mo_file_get_translation (MoFile *self, const gchar *str, GError **error)
+guint
+mo_file_lookup_originals (MoFile *self,
+                          const gchar *translation,
+                          MoEntry *entries,
+                          guint max_entries)
 {
-        gboolean found;
-        const gchar *trans;
+        const MoReverseIndex *reverse;
+        guint32 node;
+        gsize len;
+        guint n = 0;
 
-        if (!MO_IS_FILE (self) || !str || (!self->filename && !self->data)) {
-                g_set_error (error,
-                             MO_FILE_ERROR,
-                             MO_FILE_INVALID_FILE_ERROR,
-                             "The MoFile object is invalid.",
-                             NULL);
-                return NULL;
-        }
+        g_return_val_if_fail (MO_IS_FILE (self), 0);
+        g_return_val_if_fail (translation != NULL, 0);
 
-        if (self->header.nstrings == 0) {
-                g_set_error (error,
-                             MO_FILE_ERROR,
-                             MO_FILE_INVALID_FILE_ERROR,
-                             "'%s' contains no strings",
-                             self->filename,
-                             NULL);
-                return NULL;
-        }
+        if (!self->data)
+                return 0;
 
-        found = g_hash_table_lookup_extended (self->translations_cache,
-                                              str,
-                                              NULL,
-                                              (gpointer) &trans);
+        reverse = get_reverse_index (self);
 
-        if (!found) {
-                trans = get_translation (self, str, error);
-                g_hash_table_insert (self->translations_cache, g_strdup (str), (gchar *) trans);
+        len = strlen (translation);
+
+        if (!mo_index_lookup (reverse->index,
+                              translation,
+                              len,
+                              mo_index_hash (translation, len),
+                              &node))
+                return 0;
+
+        for (; node != NO_ENTRY; node = reverse->next[node]) {
+                if (entries && n < max_entries)
+                        get_entry (self, reverse->entries[node], &entries[n], NULL);
+
+                n++;
         }
 
-        return g_strdup (trans);
+        return n;
+}
+
+/*
+ * The memory used by @self's reverse index, or 0 if it hasn't been built.
+ */
+gsize
+_mo_file_get_reverse_index_size (MoFile *self)
+{
+        const MoReverseIndex *reverse = g_atomic_pointer_get (&self->reverse);
+
+        if (!reverse)
+                return 0;
+
+        return sizeof (MoReverseIndex) +
+               mo_index_get_size (reverse->index) +
+               reverse->n_nodes * 2 * sizeof (guint32);
+}
+
+/* The fields searched when none are asked for */
+#define SEARCH_FIELDS (MO_SEARCH_ORIGINALS | MO_SEARCH_TRANSLATIONS)
+
+static MoSearchFlags
+get_search_fields (MoSearchFlags flags)
+{
+        flags &= SEARCH_FIELDS;
+
+        return flags ? flags : SEARCH_FIELDS;
 }
 
 /**
- * mo_file_get_translations:
+ * mo_file_build_search_index:
  * @self: An initialised #MoFile.
+ * @fields: Which strings to index: %MO_SEARCH_ORIGINALS,
+ * %MO_SEARCH_TRANSLATIONS or both. 0 means both.
+ * @max_entries: How many more entries to index, or 0 for all of them.
  *
- * Retrieve all translations.
+ * Build an index of the trigrams of @self's strings, which makes
+ * mo_file_search() only look at the entries which might match, rather than
+ * at all of them.
  *
- * Returns: (element-type gchar* gchar*) (transfer full): A #GHashTable
- * containing a mapping from original to translated strings.
+ * A big index can be built a piece at a time, by passing the number of
+ * entries to add to it each time. Until it is complete, mo_file_search()
+ * uses it for the entries it covers and looks through the rest. @fields
+ * only counts on the first call; later ones extend the same index.
+ * mo_file_get_stats() reports how much memory the index uses.
+ *
+ * Returns: %TRUE if every entry has now been indexed.
  */
-GHashTable *
-mo_file_get_translations (MoFile *self, GError **error)
+gboolean
+mo_file_build_search_index (MoFile *self, MoSearchFlags fields, guint max_entries)
 {
-        const gchar *orig, *trans;
-        GHashTable *ret;
+        MoEntry entry;
+        guint32 n_entries, end;
+        const gchar *form;
+        gsize length;
 
-        if (!MO_IS_FILE (self) || !self->filename)
-                return NULL;
+        g_return_val_if_fail (MO_IS_FILE (self), FALSE);
 
-        ret = g_hash_table_new_full (g_str_hash,
-                                     g_str_equal,
-                                     g_free,
-                                     g_free);
+        if (!self->data)
+                return FALSE;
 
-        for (unsigned int i = 0; i < self->header.nstrings; ++i) {
-                orig = get_string (self->data,
-                                   self->header.orig_tab_offset,
-                                   i,
-                                   self->swapped,
-                                   self->length,
-                                   NULL,
-                                   error);
+        n_entries = get_n_entries (self);
 
-                if (!orig) {
-                        g_hash_table_unref (ret);
-                        return NULL;
+        g_rw_lock_writer_lock (&self->search_lock);
+
+        if (!self->search) {
+                self->search = mo_search_index_new ();
+                self->search_fields = get_search_fields (fields);
+                self->n_search_indexed = 0;
+        }
+
+        end = n_entries;
+
+        if (max_entries > 0 && max_entries < n_entries - self->n_search_indexed)
+                end = self->n_search_indexed + max_entries;
+
+        for (guint32 i = self->n_search_indexed; i < end; ++i) {
+                if (!get_entry (self, i, &entry, NULL) || is_header (&entry))
+                        continue;
+
+                if (self->search_fields & MO_SEARCH_ORIGINALS) {
+                        mo_search_index_add (self->search,
+                                             i,
+                                             entry.msgid,
+                                             entry.msgid_length);
+
+                        if (entry.msgid_plural)
+                                mo_search_index_add (self->search,
+                                                     i,
+                                                     entry.msgid_plural,
+                                                     entry.msgid_plural_length);
                 }
 
-                trans = get_string (self->data,
-                                    self->header.trans_tab_offset,
-                                    i,
-                                    self->swapped,
-                                    self->length,
-                                    NULL,
-                                    error);
+                if (!(self->search_fields & MO_SEARCH_TRANSLATIONS))
+                        continue;
 
-                if (!trans) {
-                        g_hash_table_unref (ret);
-                        return NULL;
+                for (guint j = 0; j < entry.n_translations; ++j) {
+                        form = mo_entry_get_plural_form (&entry, j, &length);
+                        mo_search_index_add (self->search, i, form, length);
                 }
+        }
 
-                g_hash_table_insert (ret,
-                                     g_strdup (orig),
-                                     g_strdup (trans));
+        self->n_search_indexed = end;
+
+        g_rw_lock_writer_unlock (&self->search_lock);
+
+        return end == n_entries;
+}
+
+/*
+ * Whether the fields @flags asks for of the entry at @index contain @query.
+ */
+static gboolean
+entry_matches (MoFile *self,
+               guint32 index,
+               const gchar *query,
+               gsize query_length,
+               guint max_errors,
+               MoSearchFlags flags,
+               guint *scratch)
+{
+        gboolean case_insensitive = (flags & MO_SEARCH_CASE_INSENSITIVE) != 0;
+        MoEntry entry;
+        const gchar *form;
+        gsize length;
+
+        if (!get_entry (self, index, &entry, NULL) || is_header (&entry))
+                return FALSE;
+
+        if (flags & MO_SEARCH_ORIGINALS) {
+                if (mo_search_match (entry.msgid,
+                                     entry.msgid_length,
+                                     query,
+                                     query_length,
+                                     max_errors,
+                                     case_insensitive,
+                                     scratch))
+                        return TRUE;
+
+                if (entry.msgid_plural &&
+                    mo_search_match (entry.msgid_plural,
+                                     entry.msgid_plural_length,
+                                     query,
+                                     query_length,
+                                     max_errors,
+                                     case_insensitive,
+                                     scratch))
+                        return TRUE;
+        }
+
+        if (!(flags & MO_SEARCH_TRANSLATIONS))
+                return FALSE;
+
+        for (guint j = 0; j < entry.n_translations; ++j) {
+                form = mo_entry_get_plural_form (&entry, j, &length);
+
+                if (mo_search_match (form,
+                                     length,
+                                     query,
+                                     query_length,
+                                     max_errors,
+                                     case_insensitive,
+                                     scratch))
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+/**
+ * mo_file_search:
+ * @self: An initialised #MoFile.
+ * @query: The string to look for.
+ * @max_errors: How many characters may be inserted, deleted or changed in
+ * @query for a string to still match it; 0 only finds @query itself.
+ * @flags: Which strings to look in, %MO_SEARCH_ORIGINALS,
+ * %MO_SEARCH_TRANSLATIONS or both, where 0 means both, and whether to
+ * ignore case with %MO_SEARCH_CASE_INSENSITIVE.
+ *
+ * Find the entries which contain @query, or a string within @max_errors
+ * edits of it. This looks through every entry, unless an index has been
+ * built with mo_file_build_search_index() for at least the strings being
+ * searched and @query is long enough for the index to help: each error
+ * allowed needs three more bytes in @query. The header is never found. Only
+ * ASCII letters are compared without regard to case, and the comparison is
+ * of bytes, so an error is a byte rather than a character.
+ *
+ * Returns: (transfer full) (element-type guint): The positions of the
+ * matching entries, as for mo_file_get_entry(), in increasing order.
+ */
+GArray *
+mo_file_search (MoFile *self,
+                const gchar *query,
+                guint max_errors,
+                MoSearchFlags flags)
+{
+        g_autoptr(GArray) candidates = NULL;
+        g_autofree guint *scratch = NULL;
+        guint32 n_entries, idx, start = 0;
+        gsize query_length;
+        GArray *ret;
+
+        g_return_val_if_fail (MO_IS_FILE (self), NULL);
+        g_return_val_if_fail (query != NULL, NULL);
+
+        ret = g_array_new (FALSE, FALSE, sizeof (guint));
+
+        if (!self->data)
+                return ret;
+
+        flags = get_search_fields (flags) | (flags & MO_SEARCH_CASE_INSENSITIVE);
+        n_entries = get_n_entries (self);
+        query_length = strlen (query);
+        scratch = g_new (guint, query_length + 1);
+        candidates = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+        g_rw_lock_reader_lock (&self->search_lock);
+
+        if (self->search &&
+            (flags & SEARCH_FIELDS & ~self->search_fields) == 0 &&
+            mo_search_index_get_candidates (self->search,
+                                            query,
+                                            query_length,
+                                            max_errors,
+                                            self->n_search_indexed,
+                                            candidates)) {
+                for (guint i = 0; i < candidates->len; ++i) {
+                        idx = g_array_index (candidates, guint32, i);
+
+                        if (entry_matches (self,
+                                           idx,
+                                           query,
+                                           query_length,
+                                           max_errors,
+                                           flags,
+                                           scratch))
+                                g_array_append_val (ret, idx);
+                }
+
+                start = self->n_search_indexed;
+        }
+
+        g_rw_lock_reader_unlock (&self->search_lock);
+
+        for (idx = start; idx < n_entries; ++idx) {
+                if (entry_matches (self,
+                                   idx,
+                                   query,
+                                   query_length,
+                                   max_errors,
+                                   flags,
+                                   scratch))
+                        g_array_append_val (ret, idx);
         }
 
         return ret;
 }
 
+/*
+ * The memory used by @self's search index, or 0 if it hasn't been built.
+ */
+gsize
+_mo_file_get_search_index_size (MoFile *self)
+{
+        gsize size;
+
+        g_rw_lock_reader_lock (&self->search_lock);
+        size = mo_search_index_get_size (self->search);
+        g_rw_lock_reader_unlock (&self->search_lock);
+
+        return size;
+}
+
 /**
  * mo_file_new:
  * @filename: Filename of the .mo file to work with.
@@ -826,3 +3352,136 @@ mo_file_new_from_bytes (const GBytes *bytes, GError **error)
                                         "bytes", bytes,
                                         NULL));
 }
+
+/*
+ * Create the #MoFile for one locale of a #MoGroup bundle: @header_offset is
+ * where its .mo header is in @bytes. The tables it points to may be shared
+ * with the other locales. The file keeps a reference on @bytes.
+ */
+MoFile *
+_mo_file_new_for_bundle (GBytes *bytes, gsize header_offset, GError **error)
+{
+        MoFile *self;
+
+        self = g_object_new (MO_TYPE_FILE, "bytes", bytes, NULL);
+        self->header_offset = header_offset;
+        self->sparse = TRUE;
+        self->owned_bytes = g_bytes_ref (bytes);
+
+        if (!g_initable_init (G_INITABLE (self), NULL, error)) {
+                g_object_unref (self);
+                return NULL;
+        }
+
+        return self;
+}
+
+guint32
+_mo_file_get_n_strings (MoFile *self)
+{
+        return get_n_entries (self);
+}
+
+/*
+ * Get the original and translated strings of the entry at @index, which must
+ * be less than _mo_file_get_n_strings(). The lengths do not include the
+ * trailing NUL. In a bundle, a missing translation is returned as an empty
+ * one.
+ */
+gboolean
+_mo_file_get_entry (MoFile *self,
+                    guint32 index,
+                    const gchar **orig,
+                    gsize *orig_length,
+                    const gchar **trans,
+                    gsize *trans_length,
+                    GError **error)
+{
+        g_return_val_if_fail (index < get_n_entries (self), FALSE);
+
+        return (*orig = get_orig_string (self, index, orig_length, error)) &&
+               (*trans = get_trans_string (self, index, trans_length, error));
+}
+
+/*
+ * Find the entry index of the @str_length bytes at @str, given both its
+ * hashpjw() value @hash and its mo_index_hash() value @index_hash. The
+ * translation can then be read with _mo_file_get_translation_at(), from this
+ * file or any other locale of the same bundle.
+ *
+ * If @context is not %NULL, the key is "@context\004@str", and the hashes are
+ * those of hashpjw_context() and mo_index_hash_context().
+ */
+gboolean
+_mo_file_find_index (MoFile *self,
+                     const gchar *context,
+                     gsize context_length,
+                     const gchar *str,
+                     gsize str_length,
+                     guint32 hash,
+                     guint64 index_hash,
+                     guint32 *index)
+{
+        if (!self->data || self->header.nstrings == 0)
+                return FALSE;
+
+        if (self->index && context)
+                return mo_index_lookup_context (self->index,
+                                                context,
+                                                context_length,
+                                                str,
+                                                str_length,
+                                                index_hash,
+                                                index);
+
+        if (self->index)
+                return mo_index_lookup (self->index, str, str_length, index_hash, index);
+
+        return find_translation_index (self,
+                                       context,
+                                       context_length,
+                                       str,
+                                       str_length,
+                                       hash,
+                                       index,
+                                       NULL);
+}
+
+const gchar *
+_mo_file_get_translation_at (MoFile *self, guint32 index, gsize *length)
+{
+        if (index >= get_n_entries (self))
+                return NULL;
+
+        return get_translation_string (self, index, length, NULL);
+}
+
+/*
+ * Look up the @str_length bytes at @str, with hashes as for
+ * _mo_file_find_index(), so that a caller looking the same string up in
+ * several files only has to hash it once.
+ */
+const gchar *
+_mo_file_lookup_hashed (MoFile *self,
+                        const gchar *context,
+                        gsize context_length,
+                        const gchar *str,
+                        gsize str_length,
+                        guint32 hash,
+                        guint64 index_hash,
+                        gsize *length)
+{
+        guint32 idx;
+
+        if (!_mo_file_find_index (self,
+                                  context,
+                                  context_length,
+                                  str,
+                                  str_length,
+                                  hash,
+                                  index_hash,
+                                  &idx))
+                return NULL;
+
+        return _mo_file_get_translation_at (self, idx, length);
+}
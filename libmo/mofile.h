@@ -25,6 +25,9 @@
 #include <gio/gio.h>
 #include <glib-object.h>
 
+#include "mokey.h"
+#include "moview.h"
+
 #if !(defined(_IN_MO_H) || defined(MO_COMPILATION))
 #error "mofile.h must not be included individually, include mo.h instead"
 #endif
@@ -35,6 +38,8 @@ G_BEGIN_DECLS
  * MoFileError:
  * @MO_FILE_INVALID_FILE_ERROR: The file exists but could not be parsed. It is not a valid .mo file.
  * @MO_FILE_NO_SUCH_FILE_ERROR: The file did not exist.
+ * @MO_FILE_UNSUPPORTED_CHARSET_ERROR: The requested #MoFile:target-charset
+ * isn't supported.
  *
  * Error codes for operations on #MoFiles.
  */
@@ -42,8 +47,24 @@ typedef enum {
         MO_FILE_INVALID_FILE_ERROR,
         MO_FILE_NO_SUCH_FILE_ERROR,
         MO_FILE_STRING_NOT_FOUND_ERROR,
+        MO_FILE_UNSUPPORTED_CHARSET_ERROR,
 } MoFileError;
 
+/**
+ * MoSearchFlags:
+ * @MO_SEARCH_ORIGINALS: Search the untranslated strings of each entry: its
+ * msgid and plural msgid.
+ * @MO_SEARCH_TRANSLATIONS: Search every form of each entry's translation.
+ * @MO_SEARCH_CASE_INSENSITIVE: Compare ASCII letters without regard to case.
+ *
+ * Flags for mo_file_search() and mo_file_build_search_index().
+ */
+typedef enum {
+        MO_SEARCH_ORIGINALS = 1 << 0,
+        MO_SEARCH_TRANSLATIONS = 1 << 1,
+        MO_SEARCH_CASE_INSENSITIVE = 1 << 2,
+} MoSearchFlags;
+
 /**
  * MO_TYPE_FILE:
  *
@@ -66,12 +87,159 @@ G_DECLARE_FINAL_TYPE (MoFile, mo_file, MO, FILE, GObject)
 #define MO_FILE_ERROR (mo_file_error_quark ())
 GQuark mo_file_error_quark (void) G_GNUC_CONST;
 
+/**
+ * MoFileStats:
+ * @n_strings: The number of strings in the file.
+ * @hash_tab_size: The number of slots in the file's own hash table, or 0 if
+ * it has none.
+ * @hash_tab_mean_probes: The mean number of hash table slots read when
+ * looking up a string which is in the file. This is only measured for files
+ * loaded with #MoFile:validate set, and is 0 otherwise.
+ * @index_size: The memory used by the index built for #MoFile:build-index,
+ * in bytes, or 0 if there is none.
+ * @index_build_time: How long building that index took, in microseconds.
+ * @arena_size: The memory taken from the heap for the keys of the
+ * translation cache and for translations converted to #MoFile:target-charset,
+ * in bytes.
+ * @arena_used: How much of @arena_size is currently in use, in bytes.
+ * @reverse_index_size: The memory used by the index built for
+ * mo_file_lookup_originals(), in bytes, or 0 if it has not been built.
+ * @search_index_size: The memory used by the index built by
+ * mo_file_build_search_index(), in bytes, or 0 if there is none.
+ *
+ * Statistics about a #MoFile, as returned by mo_file_get_stats().
+ */
+typedef struct {
+        guint n_strings;
+        guint hash_tab_size;
+        gdouble hash_tab_mean_probes;
+        gsize index_size;
+        gint64 index_build_time;
+        gsize arena_size;
+        gsize arena_used;
+        gsize reverse_index_size;
+        gsize search_index_size;
+} MoFileStats;
+
+/**
+ * MoEntry:
+ * @index: The position of the entry in the file, from 0 to
+ * mo_file_get_n_entries() - 1.
+ * @context: The entry's msgctxt, or %NULL if it has none. This is not
+ * nul-terminated.
+ * @context_length: The length of @context in bytes.
+ * @msgid: The untranslated string. This is nul-terminated.
+ * @msgid_length: The length of @msgid in bytes.
+ * @msgid_plural: The untranslated plural form, or %NULL if the entry has
+ * none. This is nul-terminated.
+ * @msgid_plural_length: The length of @msgid_plural in bytes.
+ * @translation: The translation, or %NULL if the entry has none, which can
+ * only happen for a file in a bundle. For entries with plural forms, this
+ * holds all of the forms separated by NULs; see mo_entry_get_plural_form().
+ * @translation_length: The length of @translation in bytes, including any
+ * NULs separating plural forms but not the terminating one.
+ * @n_translations: How many forms @translation holds, which is 1 for an
+ * entry without plural forms.
+ *
+ * One entry of a #MoFile, as returned by mo_file_iter_next() and
+ * mo_file_get_entry(). The strings point into the #MoFile and stay valid
+ * for as long as it is alive.
+ */
+typedef struct {
+        guint index;
+        const gchar *context;
+        gsize context_length;
+        const gchar *msgid;
+        gsize msgid_length;
+        const gchar *msgid_plural;
+        gsize msgid_plural_length;
+        const gchar *translation;
+        gsize translation_length;
+        guint n_translations;
+} MoEntry;
+
+/**
+ * MoFileIter:
+ *
+ * A stack allocated iterator over the entries of a #MoFile, set up with
+ * mo_file_iter_init() and advanced with mo_file_iter_next(). All of its
+ * fields are private.
+ */
+typedef struct {
+        /*< private >*/
+        gpointer dummy1;
+        guint dummy2;
+        guint dummy3;
+} MoFileIter;
+
 MoFile *mo_file_new (const gchar *filename, GError **error);
 MoFile *mo_file_new_from_bytes (const GBytes *bytes, GError **error);
 const gchar *mo_file_get_name (MoFile *self);
 
 gchar *mo_file_get_translation (MoFile *self, const gchar *str, GError **error);
+const gchar *mo_file_lookup_translation (MoFile *self,
+                                         const gchar *str,
+                                         gsize *length);
+const gchar *mo_file_lookup_translation_len (MoFile *self,
+                                             const gchar *str,
+                                             gsize str_length,
+                                             gsize *length);
+const gchar *mo_file_lookup_translation_with_context (MoFile *self,
+                                                      const gchar *context,
+                                                      const gchar *str,
+                                                      gsize *length);
+const gchar *mo_file_lookup_key (MoFile *self,
+                                 const MoKey *key,
+                                 gsize *length);
+const gchar *mo_file_lookup_plural (MoFile *self,
+                                    const gchar *msgid,
+                                    const gchar *msgid_plural,
+                                    gulong n,
+                                    gsize *length);
+guint mo_file_lookup_translations (MoFile *self,
+                                   const gchar * const *strs,
+                                   gsize n_strs,
+                                   const gchar **translations,
+                                   gsize *lengths);
 
 GHashTable *mo_file_get_translations (MoFile *self, GError **error);
+MoView *mo_file_get_translations_view (MoFile *self, GError **error);
+
+guint mo_file_lookup_originals (MoFile *self,
+                                const gchar *translation,
+                                MoEntry *entries,
+                                guint max_entries);
+
+gboolean mo_file_build_search_index (MoFile *self,
+                                     MoSearchFlags fields,
+                                     guint max_entries);
+GArray *mo_file_search (MoFile *self,
+                        const gchar *query,
+                        guint max_errors,
+                        MoSearchFlags flags);
+
+guint mo_file_get_n_entries (MoFile *self);
+gboolean mo_file_get_entry (MoFile *self,
+                            guint index,
+                            MoEntry *entry,
+                            GError **error);
+void mo_file_iter_init (MoFileIter *iter, MoFile *file);
+void mo_file_iter_init_range (MoFileIter *iter,
+                              MoFile *file,
+                              guint start,
+                              guint end);
+gboolean mo_file_iter_next (MoFileIter *iter, MoEntry *entry, GError **error);
+const gchar *mo_entry_get_plural_form (const MoEntry *entry,
+                                       guint n,
+                                       gsize *length);
+
+GHashTable *mo_file_get_header (MoFile *self);
+const gchar *mo_file_get_header_value (MoFile *self, const gchar *name);
+const gchar *mo_file_get_charset (MoFile *self);
+const gchar *mo_file_get_language (MoFile *self);
+guint mo_file_get_n_plurals (MoFile *self);
+const gchar *mo_file_get_plural_expression (MoFile *self);
+
+void mo_file_get_stats (MoFile *self, MoFileStats *stats);
 
 G_END_DECLS
@@ -20,11 +20,23 @@
  * USA
  */
 
+#include "moarena.h"
+#include "mobundle.h"
 #include "mofile.h"
+#include "mofile-private.h"
 #include "mogroup.h"
+#include "moindex.h"
+#include "moview-private.h"
+
+#include <glib/gstdio.h>
+
+#include <string.h>
+#include <sys/stat.h>
 
 #define DEFAULT_DIRECTORY "/usr/share/locale/"
 
+#define LOCALE_ARENA_CHUNK_SIZE 4096
+
 /**
  * SECTION:mogroup
  * @short_description: Work with all translations for a domain.
@@ -63,6 +75,44 @@
  *       return EXIT_SUCCESS;
  * </programlisting>
  * </example>
+ *
+ * A #MoGroup can be written out with mo_group_write_bundle() as a single
+ * bundle file, and loaded back from it with mo_group_new_from_bundle().
+ * All of the locales in a bundle share one table of original strings and one
+ * hash table, so it is smaller than the .mo files it was made from, and
+ * mo_group_get_translations() only has to look a string up once, rather than
+ * once per locale.
+ *
+ * With #MoGroup:lazy set, constructing a #MoGroup only finds out which
+ * locales have a .mo file. Each file is then opened the first time it is
+ * needed, which is much cheaper for a process that only uses a few of the
+ * many locales usually installed. This is safe to do from several threads:
+ * every file is loaded exactly once.
+ *
+ * Once it has been constructed, each locale of a #MoGroup has a handle: a
+ * small integer, from 0 to mo_group_get_n_locales() - 1, in the order of
+ * the locales' names. Querying by handle, with
+ * mo_group_lookup_translation() or mo_group_lookup_translations(), avoids
+ * looking the locale's name up and copying the results, and
+ * mo_group_lookup_translations() hashes the string only once however many
+ * locales it is looked up in.
+ *
+ * The names and file names of a group's locales are kept together in one
+ * arena for the life of the group, rather than in an allocation each;
+ * mo_group_get_stats() reports how much memory that takes.
+ *
+ * A #MoGroup with #MoGroup:watch set notices when a locale's .mo file is
+ * changed or replaced, or a new locale appears in its directory. The file is
+ * then loaded and validated on another thread, and swapped in for the old
+ * one once it is ready, without any lookups having to wait. Lookups already
+ * under way carry on with the old file, which is kept, along with the
+ * strings borrowed from it, until mo_group_update() is called: that is a
+ * point at which the application promises that nothing is using the group,
+ * and is also when new locales are given their handles. Until then, every
+ * replaced file stays in memory, so an application which watches a group
+ * should call mo_group_update() whenever it can; mo_group_get_stats() says
+ * how many files are waiting for it. A file is only reloaded once it has
+ * been completely written, and only if it is not the same file as before.
  */
 
 struct _MoGroup {
@@ -70,17 +120,75 @@ struct _MoGroup {
 
         gchar *directory;
         gchar *domain;
-        GHashTable *mofiles;
+        gchar *bundle;
+        gboolean lazy;
+        guint n_threads;
+        gboolean watch;
+        MoArena *arena;         /* the MoGroupLocales and their strings */
+        GHashTable *mofiles;    /* locale name -> MoGroupLocale */
+        GPtrArray *locales;     /* handle -> MoGroupLocale, sorted by name */
+
+        /* When loaded from a bundle, any one of the locales, which share the
+         * bundle's original strings and hash table */
+        MoFile *bundle_index;
+
+        /* For #MoGroup:watch. The lock is only taken by reloads and by
+         * mo_group_update(), never by lookups. */
+        GMutex watch_lock;
+        GFileMonitor *directory_monitor;
+        GHashTable *monitors;   /* locale name -> GFileMonitor of its file */
+        GHashTable *pending;    /* locale name -> MoFile of a new locale */
+        GPtrArray *retired;     /* MoFiles which reloads have replaced */
 };
 
+/* What identifies the version of a file which was loaded */
+typedef struct {
+        dev_t dev;
+        ino_t ino;
+        gint64 mtime;
+        gint64 size;
+} MoGroupFileId;
+
+/*
+ * A locale of the group. Its file is loaded by locale_get_file(), either
+ * when the group is constructed, or on first use for a lazy group.
+ */
+typedef struct {
+        gchar *name;
+        guint handle;
+        gchar *filename;
+        MoFile *mofile;
+        gsize loaded;
+
+        /* For #MoGroup:watch, the file @mofile was loaded from */
+        MoGroupFileId file_id;
+} MoGroupLocale;
+
+/* What a monitor of a locale's file was set up for */
+typedef struct {
+        MoGroup *group;
+        gchar *name;
+} MoGroupWatch;
+
 enum {
         PROP_DOMAIN = 1,
         PROP_DIRECTORY,
+        PROP_BUNDLE,
+        PROP_LAZY,
+        PROP_N_THREADS,
+        PROP_WATCH,
         N_PROPERTIES
 };
 
 static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
 
+enum {
+        SIGNAL_LOCALE_CHANGED,
+        N_SIGNALS
+};
+
+static guint signals[N_SIGNALS] = { 0, };
+
 /* forward declarations */
 static void mo_group_initable_init (GInitableIface *iface);
 
@@ -110,6 +218,18 @@ mo_group_get_property (GObject    *object,
         case PROP_DIRECTORY:
             g_value_set_string (value, self->directory);
             break;
+        case PROP_BUNDLE:
+            g_value_set_string (value, self->bundle);
+            break;
+        case PROP_LAZY:
+            g_value_set_boolean (value, self->lazy);
+            break;
+        case PROP_N_THREADS:
+            g_value_set_uint (value, self->n_threads);
+            break;
+        case PROP_WATCH:
+            g_value_set_boolean (value, self->watch);
+            break;
 
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -133,6 +253,18 @@ mo_group_set_property (GObject      *object,
         case PROP_DIRECTORY:
             self->directory = g_value_dup_string (value);
             break;
+        case PROP_BUNDLE:
+            self->bundle = g_value_dup_string (value);
+            break;
+        case PROP_LAZY:
+            self->lazy = g_value_get_boolean (value);
+            break;
+        case PROP_N_THREADS:
+            self->n_threads = g_value_get_uint (value);
+            break;
+        case PROP_WATCH:
+            self->watch = g_value_get_boolean (value);
+            break;
 
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -140,13 +272,110 @@ mo_group_set_property (GObject      *object,
     }
 }
 
+static MoGroupLocale *
+locale_new (MoArena *arena, const gchar *name, const gchar *filename)
+{
+        MoGroupLocale *locale = mo_arena_alloc (arena, sizeof (MoGroupLocale));
+
+        memset (locale, 0, sizeof (MoGroupLocale));
+        locale->name = mo_arena_strdup (arena, name);
+        locale->filename = mo_arena_strdup (arena, filename);
+
+        return locale;
+}
+
+static MoGroupLocale *
+locale_new_loaded (MoArena *arena, const gchar *name, MoFile *mofile)
+{
+        MoGroupLocale *locale = mo_arena_alloc (arena, sizeof (MoGroupLocale));
+
+        memset (locale, 0, sizeof (MoGroupLocale));
+        locale->name = mo_arena_strdup (arena, name);
+        locale->mofile = mofile;
+        locale->loaded = 1;
+
+        return locale;
+}
+
+/* The locale itself lives in the group's arena, so is freed with it */
+static void
+locale_free (gpointer data)
+{
+        MoGroupLocale *locale = data;
+
+        g_clear_object (&locale->mofile);
+}
+
+/*
+ * Open @filename, logging why if it can't be.
+ */
+static MoFile *
+load_mo_file (const gchar *filename)
+{
+        GError *local_error = NULL;
+        MoFile *mofile;
+
+        mofile = mo_file_new (filename, &local_error);
+
+        if (!mofile) {
+                g_assert (local_error != NULL);
+
+                if (g_error_matches (local_error,
+                                     MO_FILE_ERROR,
+                                     MO_FILE_NO_SUCH_FILE_ERROR)) {
+                        g_debug ("'%s' was not found.", filename);
+                } else {
+                        g_warning ("Couldn't load '%s': %s",
+                                   filename,
+                                   local_error->message);
+                }
+
+                g_clear_error (&local_error);
+        }
+
+        return mofile;
+}
+
+/*
+ * Get the file of @locale, loading it if this is the first time it has been
+ * asked for. Returns NULL if it couldn't be loaded.
+ */
+static MoFile *
+locale_get_file (MoGroupLocale *locale)
+{
+        if (g_once_init_enter (&locale->loaded)) {
+                locale->mofile = load_mo_file (locale->filename);
+                g_once_init_leave (&locale->loaded, 1);
+        }
+
+        /* A reload of a watched group may swap it at any time */
+        return g_atomic_pointer_get (&locale->mofile);
+}
+
+static void
+monitor_free (gpointer data)
+{
+        GFileMonitor *monitor = data;
+
+        g_file_monitor_cancel (monitor);
+        g_object_unref (monitor);
+}
+
 static void
 mo_group_dispose (GObject *object)
 {
         MoGroup *self = MO_GROUP (object);
 
+        /* stop watching; reloads hold a reference, so none are running */
+        g_clear_pointer (&self->directory_monitor, monitor_free);
+        g_hash_table_remove_all (self->monitors);
+
         /* drop all references to MoFiles */
+        self->bundle_index = NULL;
+        g_ptr_array_set_size (self->locales, 0);
         g_hash_table_remove_all (self->mofiles);
+        g_hash_table_remove_all (self->pending);
+        g_ptr_array_set_size (self->retired, 0);
 
         G_OBJECT_CLASS (mo_group_parent_class)->dispose (object);
 }
@@ -158,11 +387,415 @@ mo_group_finalize (GObject *object)
 
         g_clear_pointer (&self->directory, g_free);
         g_clear_pointer (&self->domain, g_free);
+        g_clear_pointer (&self->bundle, g_free);
+        g_clear_pointer (&self->locales, g_ptr_array_unref);
         g_clear_pointer (&self->mofiles, g_hash_table_destroy);
+        g_clear_pointer (&self->monitors, g_hash_table_destroy);
+        g_clear_pointer (&self->pending, g_hash_table_destroy);
+        g_clear_pointer (&self->retired, g_ptr_array_unref);
+        g_clear_pointer (&self->arena, mo_arena_free);
+        g_mutex_clear (&self->watch_lock);
 
         G_OBJECT_CLASS (mo_group_parent_class)->finalize (object);
 }
 
+static void
+load_locale_func (gpointer data, gpointer user_data G_GNUC_UNUSED)
+{
+        locale_get_file (data);
+}
+
+static gboolean
+locale_failed (gpointer key G_GNUC_UNUSED,
+               gpointer value,
+               gpointer user_data G_GNUC_UNUSED)
+{
+        return locale_get_file (value) == NULL;
+}
+
+/*
+ * Load the file of every locale, spread over #MoGroup:n-threads threads, and
+ * then forget the locales whose file couldn't be loaded.
+ */
+static void
+load_all_locales (MoGroup *self)
+{
+        GThreadPool *pool = NULL;
+        GHashTableIter iter;
+        gpointer locale;
+        guint n_threads;
+
+        n_threads = self->n_threads ? self->n_threads : g_get_num_processors ();
+        n_threads = MIN (n_threads, g_hash_table_size (self->mofiles));
+
+        if (n_threads > 1)
+                pool = g_thread_pool_new (load_locale_func,
+                                          NULL,
+                                          n_threads,
+                                          FALSE /* exclusive */,
+                                          NULL);
+
+        g_hash_table_iter_init (&iter, self->mofiles);
+
+        while (g_hash_table_iter_next (&iter, NULL, &locale)) {
+                if (pool)
+                        g_thread_pool_push (pool, locale, NULL);
+                else
+                        locale_get_file (locale);
+        }
+
+        /* Waits for every file to be loaded */
+        if (pool)
+                g_thread_pool_free (pool, FALSE, TRUE);
+
+        g_hash_table_foreach_remove (self->mofiles, locale_failed, NULL);
+}
+
+static gint
+compare_locales (gconstpointer a, gconstpointer b)
+{
+        const MoGroupLocale *locale_a = *(const MoGroupLocale * const *) a;
+        const MoGroupLocale *locale_b = *(const MoGroupLocale * const *) b;
+
+        return strcmp (locale_a->name, locale_b->name);
+}
+
+/*
+ * Number the locales which the group ended up with, in order of their names.
+ */
+static void
+assign_handles (MoGroup *self)
+{
+        GHashTableIter iter;
+        gpointer locale;
+
+        g_ptr_array_set_size (self->locales, 0);
+
+        g_hash_table_iter_init (&iter, self->mofiles);
+
+        while (g_hash_table_iter_next (&iter, NULL, &locale))
+                g_ptr_array_add (self->locales, locale);
+
+        g_ptr_array_sort (self->locales, compare_locales);
+
+        for (guint i = 0; i < self->locales->len; ++i)
+                ((MoGroupLocale *) g_ptr_array_index (self->locales, i))->handle = i;
+}
+
+static gchar *
+get_locale_filename (MoGroup *self, const gchar *name)
+{
+        g_autofree gchar *mofilename = g_strdup_printf ("%s.mo", self->domain);
+
+        return g_build_filename (self->directory,
+                                 name,
+                                 "LC_MESSAGES",
+                                 mofilename,
+                                 NULL);
+}
+
+/*
+ * Find out which version of @filename is there now. Returns FALSE if it
+ * isn't a regular file.
+ */
+static gboolean
+get_file_id (const gchar *filename, MoGroupFileId *file_id)
+{
+        GStatBuf buf;
+
+        if (g_stat (filename, &buf) < 0 || !S_ISREG (buf.st_mode))
+                return FALSE;
+
+        memset (file_id, 0, sizeof (MoGroupFileId));
+        file_id->dev = buf.st_dev;
+        file_id->ino = buf.st_ino;
+        file_id->mtime = buf.st_mtime;
+        file_id->size = buf.st_size;
+
+        return TRUE;
+}
+
+/*
+ * Load the file of the locale @task_data again, and swap it in, or keep it
+ * for mo_group_update() if the locale is new. Returns whether anything
+ * changed.
+ */
+static void
+reload_thread (GTask *task,
+               gpointer source_object,
+               gpointer task_data,
+               GCancellable *cancellable G_GNUC_UNUSED)
+{
+        MoGroup *self = source_object;
+        const gchar *name = task_data;
+        g_autofree gchar *filename = NULL;
+        GError *local_error = NULL;
+        MoGroupLocale *locale;
+        MoGroupFileId file_id;
+        MoFile *mofile, *old;
+
+        filename = get_locale_filename (self, name);
+
+        /* One reload at a time, so that an older copy of a file can't be
+         * swapped in after a newer one */
+        g_mutex_lock (&self->watch_lock);
+
+        locale = g_hash_table_lookup (self->mofiles, name);
+
+        /* e.g. a new locale's directory, which has no file in it yet, or a
+         * second event for the same change */
+        if (!get_file_id (filename, &file_id) ||
+            (locale && g_atomic_pointer_get (&locale->loaded) &&
+             memcmp (&file_id, &locale->file_id, sizeof (MoGroupFileId)) == 0)) {
+                g_mutex_unlock (&self->watch_lock);
+                g_task_return_boolean (task, FALSE);
+                return;
+        }
+
+        /* Validated all the way through, as it may have been caught while it
+         * was still being written */
+        mofile = g_initable_new (MO_TYPE_FILE,
+                                 NULL,
+                                 &local_error,
+                                 "filename", filename,
+                                 "validate", TRUE,
+                                 NULL);
+
+        if (!mofile) {
+                g_mutex_unlock (&self->watch_lock);
+                g_task_return_error (task, local_error);
+                return;
+        }
+
+        if (!locale) {
+                g_hash_table_replace (self->pending, g_strdup (name), mofile);
+        } else if (g_once_init_enter (&locale->loaded)) {
+                /* Never loaded, so nothing can be using an old file */
+                locale->mofile = mofile;
+                locale->file_id = file_id;
+                g_once_init_leave (&locale->loaded, 1);
+        } else {
+                /* A lazy load under way has been waited for, as it may have
+                 * read the old file */
+                old = locale->mofile;
+                g_atomic_pointer_set (&locale->mofile, mofile);
+                locale->file_id = file_id;
+
+                /* Lookups may still be using it, and strings borrowed from
+                 * it, so it is kept until mo_group_update() */
+                if (old)
+                        g_ptr_array_add (self->retired, old);
+        }
+
+        g_mutex_unlock (&self->watch_lock);
+
+        g_task_return_boolean (task, TRUE);
+}
+
+static void
+reload_done (GObject *source_object,
+             GAsyncResult *result,
+             gpointer user_data G_GNUC_UNUSED)
+{
+        GTask *task = G_TASK (result);
+        const gchar *name = g_task_get_task_data (task);
+        GError *local_error = NULL;
+
+        if (g_task_propagate_boolean (task, &local_error)) {
+                g_signal_emit (source_object,
+                               signals[SIGNAL_LOCALE_CHANGED],
+                               0,
+                               name);
+        } else if (local_error) {
+                g_warning ("Couldn't reload locale '%s': %s",
+                           name,
+                           local_error->message);
+                g_clear_error (&local_error);
+        }
+}
+
+static void
+queue_reload (MoGroup *self, const gchar *name)
+{
+        GTask *task;
+
+        /* The task holds a reference on the group while it runs */
+        task = g_task_new (self, NULL, reload_done, NULL);
+        g_task_set_task_data (task, g_strdup (name), g_free);
+        g_task_run_in_thread (task, reload_thread);
+        g_object_unref (task);
+}
+
+static void
+watch_free (gpointer data, GClosure *closure G_GNUC_UNUSED)
+{
+        MoGroupWatch *watch = data;
+
+        g_free (watch->name);
+        g_free (watch);
+}
+
+static void
+file_changed_cb (GFileMonitor *monitor G_GNUC_UNUSED,
+                 GFile *file G_GNUC_UNUSED,
+                 GFile *other_file G_GNUC_UNUSED,
+                 GFileMonitorEvent event,
+                 gpointer user_data)
+{
+        MoGroupWatch *watch = user_data;
+
+        /* A file renamed over the old one is seen as created, and then as
+         * done with; only then has a file being written been finished */
+        if (event == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+                queue_reload (watch->group, watch->name);
+}
+
+/*
+ * Start watching the file of the locale @name, which doesn't need to exist
+ * yet.
+ */
+static void
+watch_locale (MoGroup *self, const gchar *name)
+{
+        g_autofree gchar *filename = NULL;
+        g_autoptr(GFile) file = NULL;
+        GError *local_error = NULL;
+        GFileMonitor *monitor;
+        MoGroupWatch *watch;
+
+        if (g_hash_table_contains (self->monitors, name))
+                return;
+
+        filename = get_locale_filename (self, name);
+        file = g_file_new_for_path (filename);
+        monitor = g_file_monitor_file (file,
+                                       G_FILE_MONITOR_NONE,
+                                       NULL,
+                                       &local_error);
+
+        if (!monitor) {
+                g_warning ("Couldn't watch '%s': %s",
+                           filename,
+                           local_error->message);
+                g_clear_error (&local_error);
+                return;
+        }
+
+        watch = g_new (MoGroupWatch, 1);
+        watch->group = self;
+        watch->name = g_strdup (name);
+
+        g_signal_connect_data (monitor,
+                               "changed",
+                               G_CALLBACK (file_changed_cb),
+                               watch,
+                               (GClosureNotify) watch_free,
+                               0);
+
+        g_hash_table_insert (self->monitors, g_strdup (name), monitor);
+}
+
+static void
+directory_changed_cb (GFileMonitor *monitor G_GNUC_UNUSED,
+                      GFile *file,
+                      GFile *other_file G_GNUC_UNUSED,
+                      GFileMonitorEvent event,
+                      gpointer user_data)
+{
+        MoGroup *self = user_data;
+        g_autofree gchar *path = NULL;
+        g_autofree gchar *name = NULL;
+
+        if (event != G_FILE_MONITOR_EVENT_CREATED)
+                return;
+
+        path = g_file_get_path (file);
+
+        if (!g_file_test (path, G_FILE_TEST_IS_DIR))
+                return;
+
+        /* Its file may have been created along with it, before there was
+         * anything watching for it */
+        name = g_file_get_basename (file);
+        watch_locale (self, name);
+        queue_reload (self, name);
+}
+
+static gboolean
+watch_directory (MoGroup *self, GError **error)
+{
+        g_autoptr(GFile) directory = g_file_new_for_path (self->directory);
+
+        self->directory_monitor = g_file_monitor_directory (directory,
+                                                            G_FILE_MONITOR_NONE,
+                                                            NULL,
+                                                            error);
+
+        if (!self->directory_monitor) {
+                g_prefix_error (error,
+                                "Watching directory '%s' failed: ",
+                                self->directory);
+                return FALSE;
+        }
+
+        g_signal_connect (self->directory_monitor,
+                          "changed",
+                          G_CALLBACK (directory_changed_cb),
+                          self);
+
+        return TRUE;
+}
+
+static gboolean
+mo_group_initable_init_bundle (MoGroup *self, GError **error)
+{
+        g_autoptr(GMappedFile) mapped = NULL;
+        g_autoptr(GBytes) bytes = NULL;
+        g_autoptr(GArray) locales = NULL;
+        MoBundleLocale *locale;
+        MoGroupLocale *slot;
+        MoFile *mofile;
+
+        mapped = g_mapped_file_new (self->bundle, FALSE, error);
+
+        if (!mapped)
+                return FALSE;
+
+        bytes = g_mapped_file_get_bytes (mapped);
+
+        /* The bundle knows its own domain */
+        g_clear_pointer (&self->domain, g_free);
+
+        locales = mo_bundle_read_locales (bytes, &self->domain, error);
+
+        if (!locales) {
+                g_prefix_error (error, "Reading '%s' failed: ", self->bundle);
+                return FALSE;
+        }
+
+        for (guint i = 0; i < locales->len; ++i) {
+                locale = &g_array_index (locales, MoBundleLocale, i);
+
+                mofile = _mo_file_new_for_bundle (bytes, locale->header_offset, error);
+
+                if (!mofile) {
+                        g_prefix_error (error,
+                                        "Reading locale '%s' of '%s' failed: ",
+                                        locale->name,
+                                        self->bundle);
+                        return FALSE;
+                }
+
+                slot = locale_new_loaded (self->arena, locale->name, mofile);
+                g_hash_table_insert (self->mofiles, slot->name, slot);
+                self->bundle_index = mofile;
+        }
+
+        assign_handles (self);
+
+        return TRUE;
+}
+
 static gboolean
 mo_group_initable_init_real (GInitable *init,
                              GCancellable *cancellable G_GNUC_UNUSED,
@@ -173,14 +806,18 @@ mo_group_initable_init_real (GInitable *init,
         const gchar *current_directory;
         g_autoptr(GDir) dir = NULL;
         GError *local_error = NULL;
-        MoFile *mofile;
         g_autofree gchar *mofilename = NULL;
+        g_autoptr(GString) filename = NULL;
+        gsize directory_length;
 
         if (!MO_IS_GROUP (init))
                 return FALSE;
 
         self = MO_GROUP (init);
 
+        if (self->bundle)
+                return mo_group_initable_init_bundle (self, error);
+
         if (!self->directory)
                 return FALSE;
 
@@ -209,42 +846,58 @@ mo_group_initable_init_real (GInitable *init,
                 return FALSE;
         }
 
+        /* Watch before looking, so no new locale is missed in between */
+        if (self->watch && !watch_directory (self, error))
+                return FALSE;
+
         mofilename = g_strdup_printf ("%s.mo", self->domain);
 
-        /* dir is okay, let's go */
-        while ((current_directory = g_dir_read_name (dir))) {
-                g_autofree gchar *current_filename;
+        /* Every file name starts with the directory, so only the rest of it
+         * is rebuilt for each locale */
+        filename = g_string_new (self->directory);
 
-                current_filename = g_build_filename (self->directory,
-                                                     current_directory,
-                                                     "LC_MESSAGES",
-                                                     mofilename,
-                                                     NULL);
+        if (!g_str_has_suffix (filename->str, G_DIR_SEPARATOR_S))
+                g_string_append_c (filename, G_DIR_SEPARATOR);
 
-                mofile = mo_file_new (current_filename, &local_error);
+        directory_length = filename->len;
 
-                if (!mofile) {
-                        g_assert (local_error != NULL);
-
-                        if (g_error_matches (local_error,
-                                             MO_FILE_ERROR,
-                                             MO_FILE_NO_SUCH_FILE_ERROR)) {
-                                g_debug ("'%s' was not found.", current_filename);
-                        } else {
-                                g_warning ("Couldn't load '%s': %s",
-                                           current_filename,
-                                           local_error->message);
-                        }
-
-                        g_clear_error (&local_error);
+        /* dir is okay, let's go */
+        while ((current_directory = g_dir_read_name (dir))) {
+                MoGroupLocale *locale;
+
+                g_string_truncate (filename, directory_length);
+                g_string_append (filename, current_directory);
+                g_string_append (filename, G_DIR_SEPARATOR_S "LC_MESSAGES");
+
+                /* Only directories which can hold the domain's file are
+                 * worth a monitor each; a locale created later is found by
+                 * the directory's monitor */
+                if (self->watch &&
+                    g_file_test (filename->str, G_FILE_TEST_IS_DIR))
+                        watch_locale (self, current_directory);
+
+                g_string_append_c (filename, G_DIR_SEPARATOR);
+                g_string_append (filename, mofilename);
+
+                /* For a lazy group, only find out whether there is a file */
+                if (self->lazy &&
+                    !g_file_test (filename->str, G_FILE_TEST_IS_REGULAR)) {
+                        g_debug ("'%s' was not found.", filename->str);
                         continue;
                 }
 
-                g_hash_table_insert (self->mofiles,
-                                     g_strdup (current_directory),
-                                     mofile);
+                locale = locale_new (self->arena,
+                                     current_directory,
+                                     filename->str);
+
+                g_hash_table_insert (self->mofiles, locale->name, locale);
         }
 
+        if (!self->lazy)
+                load_all_locales (self);
+
+        assign_handles (self);
+
         return TRUE;
 }
 
@@ -291,18 +944,133 @@ mo_group_class_init (MoGroupClass *klass)
                                      G_PARAM_READWRITE |
                                      G_PARAM_STATIC_STRINGS);
 
+        /**
+         * MoGroup::bundle:
+         *
+         * Bundle file, as written by mo_group_write_bundle(), to load
+         * translations for this #MoGroup from. If this is set,
+         * #MoGroup:directory is ignored and #MoGroup:domain is read from the
+         * bundle.
+         */
+        obj_properties[PROP_BUNDLE] =
+                g_param_spec_string ("bundle",
+                                     "Bundle",
+                                     "Bundle file to load translations from",
+                                     NULL  /* default value */,
+                                     G_PARAM_CONSTRUCT_ONLY |
+                                     G_PARAM_READWRITE |
+                                     G_PARAM_STATIC_STRINGS);
+
+        /**
+         * MoGroup::lazy:
+         *
+         * Whether to wait until a locale's .mo file is first used before
+         * loading it, rather than loading every file when the #MoGroup is
+         * constructed. A file which then turns out not to be loadable is
+         * treated as if it had not been there.
+         */
+        obj_properties[PROP_LAZY] =
+                g_param_spec_boolean ("lazy",
+                                      "Lazy",
+                                      "Whether to load .mo files on first use",
+                                      FALSE  /* default value */,
+                                      G_PARAM_CONSTRUCT_ONLY |
+                                      G_PARAM_READWRITE |
+                                      G_PARAM_STATIC_STRINGS);
+
+        /**
+         * MoGroup::n-threads:
+         *
+         * How many threads to load the .mo files of a #MoGroup which is not
+         * lazy with when it is constructed, or 0 to use one per processor.
+         * Opening many files in parallel speeds up construction
+         * considerably on cold caches and network filesystems. The files
+         * which are loaded, and the warnings logged for those which can't
+         * be, are the same whatever this is set to.
+         */
+        obj_properties[PROP_N_THREADS] =
+                g_param_spec_uint ("n-threads",
+                                   "Number of threads",
+                                   "Number of threads to load .mo files with",
+                                   0,
+                                   G_MAXUINT,
+                                   1  /* default value */,
+                                   G_PARAM_CONSTRUCT_ONLY |
+                                   G_PARAM_READWRITE |
+                                   G_PARAM_STATIC_STRINGS);
+
+        /**
+         * MoGroup::watch:
+         *
+         * Whether to reload a locale's .mo file when it changes, and to add
+         * locales which appear in #MoGroup:directory, as long as the thread
+         * default #GMainContext of the thread which constructed the #MoGroup
+         * is running. Files are best replaced by renaming a new file over
+         * them, as the old file may still be in use. Strings borrowed from
+         * a file which has been replaced stay valid until mo_group_update()
+         * is called, which the application should do whenever it can, as
+         * each replaced file is kept until then. Of the directories already
+         * in #MoGroup:directory, only those with an LC_MESSAGES directory
+         * are watched for the domain's file. This has no effect on a
+         * #MoGroup loaded from a bundle.
+         */
+        obj_properties[PROP_WATCH] =
+                g_param_spec_boolean ("watch",
+                                      "Watch",
+                                      "Whether to reload .mo files when they change",
+                                      FALSE  /* default value */,
+                                      G_PARAM_CONSTRUCT_ONLY |
+                                      G_PARAM_READWRITE |
+                                      G_PARAM_STATIC_STRINGS);
+
         g_object_class_install_properties (object_class,
                                            N_PROPERTIES,
                                            obj_properties);
+
+        /**
+         * MoGroup::locale-changed:
+         * @self: The #MoGroup.
+         * @locale: The name of the locale.
+         *
+         * Emitted, for a #MoGroup:watch group, in the #GMainContext it was
+         * constructed in, once a locale's changed file has been swapped in,
+         * or a new locale has been found. A new locale can't be used until
+         * mo_group_update() has been called.
+         */
+        signals[SIGNAL_LOCALE_CHANGED] =
+                g_signal_new ("locale-changed",
+                              G_TYPE_FROM_CLASS (klass),
+                              G_SIGNAL_RUN_LAST,
+                              0,
+                              NULL,
+                              NULL,
+                              NULL,
+                              G_TYPE_NONE,
+                              1,
+                              G_TYPE_STRING);
 }
 
 static void
 mo_group_init (MoGroup *self)
 {
+        self->arena = mo_arena_new (LOCALE_ARENA_CHUNK_SIZE);
         self->mofiles = g_hash_table_new_full (g_str_hash, /* hash_func */
                                                g_str_equal, /* key_equal_func */
-                                               g_free, /* key_destroy_func */
-                                               g_object_unref /* value_destroy_func */);
+                                               NULL, /* key_destroy_func, owned by the value */
+                                               locale_free /* value_destroy_func */);
+        self->locales = g_ptr_array_new ();
+        self->n_threads = 1;
+
+        g_mutex_init (&self->watch_lock);
+        self->monitors = g_hash_table_new_full (g_str_hash,
+                                                g_str_equal,
+                                                g_free,
+                                                monitor_free);
+        self->pending = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               g_free,
+                                               g_object_unref);
+        self->retired = g_ptr_array_new_with_free_func (g_object_unref);
 }
 
 /**
@@ -343,7 +1111,9 @@ mo_group_get_domain (MoGroup *self)
  * mo_group_get_languages:
  * @self: An initialised #MoGroup.
  *
- * Get the languages that the domain has any translations for.
+ * Get the languages that the domain has any translations for. For a lazy
+ * #MoGroup, this includes every language with a .mo file, even if it has not
+ * been loaded yet.
  *
  * Returns: (element-type utf8) (transfer container): A #GList of translation
  * domains. Do not modify or free the contained strings. Free the list itself
@@ -358,12 +1128,30 @@ mo_group_get_languages (MoGroup *self)
         return g_hash_table_get_keys (self->mofiles);
 }
 
-/**
- * mo_group_get_mo_file:
- * @self: An initialised #MoGroup.
- * @locale: A locale.
- *
- * Returns: (transfer full): The #MoFile containing translations for @locale.
+/*
+ * Get the file for @locale, loading it first if need be.
+ */
+static MoFile *
+get_mo_file (MoGroup *self, const gchar *locale)
+{
+        MoGroupLocale *slot;
+
+        slot = g_hash_table_lookup (self->mofiles, locale);
+
+        if (!slot)
+                return NULL;
+
+        return locale_get_file (slot);
+}
+
+/**
+ * mo_group_get_mo_file:
+ * @self: An initialised #MoGroup.
+ * @locale: A locale.
+ *
+ * For a lazy #MoGroup, this loads the file if it has not been loaded yet.
+ *
+ * Returns: (transfer full): The #MoFile containing translations for @locale.
  */
 MoFile *
 mo_group_get_mo_file (MoGroup *self,
@@ -374,7 +1162,7 @@ mo_group_get_mo_file (MoGroup *self,
         if (!MO_IS_GROUP (self) || !locale)
                 return NULL;
 
-        mofile = g_hash_table_lookup (self->mofiles, locale);
+        mofile = get_mo_file (self, locale);
 
         if (!mofile)
                 return NULL;
@@ -382,38 +1170,13 @@ mo_group_get_mo_file (MoGroup *self,
         return MO_FILE (g_object_ref (mofile));
 }
 
-typedef struct {
-        const gchar *translation;
-        GHashTable *dict;
-} MoTranslationDictData;
-
-static void
-find_translation (gpointer key,
-                  gpointer value,
-                  gpointer user_data)
-{
-        MoTranslationDictData *data = user_data;
-        gchar *lang = key;
-        MoFile *mofile = value;
-        gchar *translation;
-
-        /* Ignoring errors - sensible? */
-        translation = mo_file_get_translation (mofile, data->translation, NULL);
-
-        if (!translation)
-                return;
-
-        g_hash_table_insert (data->dict,
-                             g_strdup (lang),
-                             translation);
-}
-
 /**
  * mo_group_get_translations:
  * @self: An initialised #MoGroup.
  * @translation: Untranslated (in the 'C' locale) string.
  *
- * Retrieve all translations for a string.
+ * Retrieve all translations for a string. mo_group_lookup_translations() is
+ * faster, as it does not copy anything.
  *
  * Returns: (transfer full) (element-type utf8 utf8): A dictionary mapping
  * domains to translated values.
@@ -422,29 +1185,717 @@ GHashTable *
 mo_group_get_translations (MoGroup *self,
                            const gchar *translation)
 {
+        g_autofree const gchar **translations = NULL;
         GHashTable *ret;
-        MoTranslationDictData data;
+        MoGroupLocale *locale;
 
         if (!MO_IS_GROUP (self) || !translation)
                 return NULL;
 
         ret = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 
-        data.translation = translation;
-        data.dict = ret;
+        translations = g_new (const gchar *, self->locales->len);
+        mo_group_lookup_translations (self, translation, translations, NULL);
 
-        g_hash_table_foreach (self->mofiles, find_translation, &data);
+        for (guint i = 0; i < self->locales->len; ++i) {
+                if (!translations[i])
+                        continue;
+
+                locale = g_ptr_array_index (self->locales, i);
+                g_hash_table_insert (ret,
+                                     g_strdup (locale->name),
+                                     g_strdup (translations[i]));
+        }
 
         return ret;
 }
 
+/**
+ * mo_group_get_translations_view:
+ * @self: An initialised #MoGroup.
+ * @error: Return location for a #GError, or %NULL.
+ *
+ * Retrieve every translation of every locale without copying any of them.
+ * This is a view of views: the outer one maps each locale's name to the
+ * #MoView mo_file_get_translations_view() returns for its file. Like those,
+ * it holds a reference on @self to keep its keys valid. The file of every
+ * locale of a lazy #MoGroup is loaded.
+ *
+ * Returns: (transfer full): A #MoView mapping locales to #MoViews mapping
+ * original to translated strings, or %NULL if one of the files couldn't be
+ * read. Free it with mo_view_unref().
+ */
+MoView *
+mo_group_get_translations_view (MoGroup *self, GError **error)
+{
+        MoView *ret, *view;
+        MoGroupLocale *locale;
+        MoFile *mofile;
+
+        if (!MO_IS_GROUP (self))
+                return NULL;
+
+        ret = mo_view_new (G_OBJECT (self), (GDestroyNotify) mo_view_unref);
+
+        for (guint i = 0; i < self->locales->len; ++i) {
+                locale = g_ptr_array_index (self->locales, i);
+                mofile = locale_get_file (locale);
+
+                if (!mofile)
+                        continue;
+
+                view = mo_file_get_translations_view (mofile, error);
+
+                if (!view) {
+                        mo_view_unref (ret);
+                        return NULL;
+                }
+
+                mo_view_insert (ret, locale->name, view);
+        }
+
+        return ret;
+}
+
+/**
+ * mo_group_get_n_locales:
+ * @self: An initialised #MoGroup.
+ *
+ * Get the number of locales in @self. Their handles are the numbers from 0
+ * up to this.
+ *
+ * Returns: The number of locales.
+ */
+guint
+mo_group_get_n_locales (MoGroup *self)
+{
+        if (!MO_IS_GROUP (self))
+                return 0;
+
+        return self->locales->len;
+}
+
+/**
+ * mo_group_get_locale_handle:
+ * @self: An initialised #MoGroup.
+ * @locale: A locale.
+ *
+ * Get the handle of @locale, for use with mo_group_lookup_translation() and
+ * as an index into the results of mo_group_lookup_translations(). Handles
+ * never change for the lifetime of @self.
+ *
+ * Returns: The handle of @locale, or -1 if @self has no translations for it.
+ */
+gint
+mo_group_get_locale_handle (MoGroup *self, const gchar *locale)
+{
+        MoGroupLocale *slot;
+
+        if (!MO_IS_GROUP (self) || !locale)
+                return -1;
+
+        slot = g_hash_table_lookup (self->mofiles, locale);
+
+        if (!slot)
+                return -1;
+
+        return slot->handle;
+}
+
+/**
+ * mo_group_get_locale_name:
+ * @self: An initialised #MoGroup.
+ * @handle: A locale handle.
+ *
+ * Get the name of the locale whose handle is @handle.
+ *
+ * Returns: (transfer none) (nullable): The locale's name, or %NULL if
+ * @handle is out of range.
+ */
+const gchar *
+mo_group_get_locale_name (MoGroup *self, guint handle)
+{
+        if (!MO_IS_GROUP (self) || handle >= self->locales->len)
+                return NULL;
+
+        return ((MoGroupLocale *) g_ptr_array_index (self->locales, handle))->name;
+}
+
+/**
+ * mo_group_get_stats:
+ * @self: An initialised #MoGroup.
+ * @stats: (out caller-allocates): Return location for the statistics.
+ *
+ * Fill in @stats with information about @self's locales and the memory
+ * used to keep track of them.
+ */
+void
+mo_group_get_stats (MoGroup *self, MoGroupStats *stats)
+{
+        MoGroupLocale *locale;
+        MoFile *mofile;
+
+        g_return_if_fail (stats != NULL);
+
+        memset (stats, 0, sizeof (MoGroupStats));
+
+        g_return_if_fail (MO_IS_GROUP (self));
+
+        stats->n_locales = self->locales->len;
+
+        for (guint i = 0; i < self->locales->len; ++i) {
+                locale = g_ptr_array_index (self->locales, i);
+
+                if (!g_atomic_pointer_get (&locale->loaded))
+                        continue;
+
+                stats->n_loaded++;
+
+                mofile = g_atomic_pointer_get (&locale->mofile);
+
+                if (!mofile)
+                        continue;
+
+                stats->reverse_index_size +=
+                        _mo_file_get_reverse_index_size (mofile);
+                stats->search_index_size +=
+                        _mo_file_get_search_index_size (mofile);
+        }
+
+        g_mutex_lock (&self->watch_lock);
+
+        stats->n_pending = g_hash_table_size (self->pending);
+        stats->n_retired = self->retired->len;
+
+        g_mutex_unlock (&self->watch_lock);
+
+        mo_arena_get_usage (self->arena, &stats->arena_size, &stats->arena_used);
+}
+
+/**
+ * mo_group_update:
+ * @self: An initialised #MoGroup.
+ *
+ * Tell a #MoGroup:watch group that nothing is using it: no other thread is
+ * calling any of its functions, and none of the strings borrowed from it are
+ * still in use. The new locales which have been found since the last call
+ * are then given handles, following on from the existing ones, and the files
+ * which reloads have replaced are freed. It does nothing for any other
+ * #MoGroup.
+ *
+ * Returns: The number of locales added.
+ */
+guint
+mo_group_update (MoGroup *self)
+{
+        GHashTableIter iter;
+        MoGroupLocale *locale;
+        gpointer name, mofile;
+        guint n_added;
+
+        g_return_val_if_fail (MO_IS_GROUP (self), 0);
+
+        g_mutex_lock (&self->watch_lock);
+
+        n_added = g_hash_table_size (self->pending);
+
+        g_hash_table_iter_init (&iter, self->pending);
+
+        while (g_hash_table_iter_next (&iter, &name, &mofile)) {
+                locale = locale_new_loaded (self->arena, name, mofile);
+                locale->handle = self->locales->len;
+
+                g_hash_table_insert (self->mofiles, locale->name, locale);
+                g_ptr_array_add (self->locales, locale);
+
+                /* The locale has taken over the file */
+                g_hash_table_iter_steal (&iter);
+                g_free (name);
+        }
+
+        g_ptr_array_set_size (self->retired, 0);
+
+        g_mutex_unlock (&self->watch_lock);
+
+        return n_added;
+}
+
+/**
+ * mo_group_lookup_translation:
+ * @self: An initialised #MoGroup.
+ * @handle: The handle of the locale to retrieve the translation for, from
+ * mo_group_get_locale_handle().
+ * @translation: Untranslated (in the 'C' locale) string.
+ * @length: (out) (optional): Return location for the length of the
+ * translation in bytes, not including the trailing NUL, or %NULL.
+ *
+ * Retrieve the translated value of a string without copying it, as
+ * mo_file_lookup_translation() does. For a lazy #MoGroup, this loads the
+ * locale's file if it has not been loaded yet.
+ *
+ * Returns: (transfer none) (nullable): the translated string, valid for as
+ * long as @self is alive, or %NULL if no translation was found.
+ */
+const gchar *
+mo_group_lookup_translation (MoGroup *self,
+                             guint handle,
+                             const gchar *translation,
+                             gsize *length)
+{
+        MoFile *mofile;
+
+        if (!MO_IS_GROUP (self) || !translation || handle >= self->locales->len)
+                return NULL;
+
+        mofile = locale_get_file (g_ptr_array_index (self->locales, handle));
+
+        if (!mofile)
+                return NULL;
+
+        return mo_file_lookup_translation (mofile, translation, length);
+}
+
+/**
+ * mo_group_lookup_originals:
+ * @self: An initialised #MoGroup.
+ * @handle: The handle of the locale whose translations to search, from
+ * mo_group_get_locale_handle().
+ * @translation: A translated string.
+ * @entries: (out caller-allocates) (array length=max_entries) (nullable):
+ * Return location for the entries which have @translation, or %NULL.
+ * @max_entries: The number of entries @entries has room for.
+ *
+ * Find the entries of the locale's file which have @translation, as
+ * mo_file_lookup_originals() does. For a lazy #MoGroup, this loads the
+ * locale's file if it has not been loaded yet.
+ *
+ * Returns: How many entries have @translation, which may be more than
+ * @max_entries.
+ */
+guint
+mo_group_lookup_originals (MoGroup *self,
+                           guint handle,
+                           const gchar *translation,
+                           MoEntry *entries,
+                           guint max_entries)
+{
+        MoFile *mofile;
+
+        if (!MO_IS_GROUP (self) || !translation || handle >= self->locales->len)
+                return 0;
+
+        mofile = locale_get_file (g_ptr_array_index (self->locales, handle));
+
+        if (!mofile)
+                return 0;
+
+        return mo_file_lookup_originals (mofile, translation, entries, max_entries);
+}
+
+static void
+build_search_index_func (gpointer data, gpointer user_data)
+{
+        MoFile *mofile = locale_get_file (data);
+
+        if (mofile)
+                mo_file_build_search_index (mofile, GPOINTER_TO_UINT (user_data), 0);
+}
+
+/**
+ * mo_group_build_search_index:
+ * @self: An initialised #MoGroup.
+ * @fields: Which strings to index, as for mo_file_build_search_index().
+ *
+ * Build the search index of every locale's file, spread over
+ * #MoGroup:n-threads threads, so that mo_group_search() is fast. The file of
+ * every locale of a lazy #MoGroup is loaded.
+ */
+void
+mo_group_build_search_index (MoGroup *self, MoSearchFlags fields)
+{
+        GThreadPool *pool = NULL;
+        guint n_threads;
+
+        g_return_if_fail (MO_IS_GROUP (self));
+
+        n_threads = self->n_threads ? self->n_threads : g_get_num_processors ();
+        n_threads = MIN (n_threads, self->locales->len);
+
+        if (n_threads > 1)
+                pool = g_thread_pool_new (build_search_index_func,
+                                          GUINT_TO_POINTER (fields),
+                                          n_threads,
+                                          FALSE /* exclusive */,
+                                          NULL);
+
+        for (guint i = 0; i < self->locales->len; ++i) {
+                if (pool)
+                        g_thread_pool_push (pool,
+                                            g_ptr_array_index (self->locales, i),
+                                            NULL);
+                else
+                        build_search_index_func (g_ptr_array_index (self->locales, i),
+                                                 GUINT_TO_POINTER (fields));
+        }
+
+        /* Waits for every index to be built */
+        if (pool)
+                g_thread_pool_free (pool, FALSE, TRUE);
+}
+
+/**
+ * mo_group_search:
+ * @self: An initialised #MoGroup.
+ * @query: The string to look for.
+ * @max_errors: How many edits to allow, as for mo_file_search().
+ * @flags: Which strings to look in, and how, as for mo_file_search().
+ *
+ * Find the entries of every locale which contain @query, or a string within
+ * @max_errors edits of it, as mo_file_search() does. The file of every
+ * locale of a lazy #MoGroup is loaded.
+ *
+ * Returns: (transfer full) (element-type MoSearchResult): The matching
+ * entries, ordered by locale handle and then by position in the file.
+ */
+GArray *
+mo_group_search (MoGroup *self,
+                 const gchar *query,
+                 guint max_errors,
+                 MoSearchFlags flags)
+{
+        g_autoptr(GArray) matches = NULL;
+        MoSearchResult result;
+        MoFile *mofile;
+        GArray *ret;
+
+        g_return_val_if_fail (MO_IS_GROUP (self), NULL);
+        g_return_val_if_fail (query != NULL, NULL);
+
+        ret = g_array_new (FALSE, FALSE, sizeof (MoSearchResult));
+
+        for (guint i = 0; i < self->locales->len; ++i) {
+                mofile = locale_get_file (g_ptr_array_index (self->locales, i));
+
+                if (!mofile)
+                        continue;
+
+                g_clear_pointer (&matches, g_array_unref);
+                matches = mo_file_search (mofile, query, max_errors, flags);
+
+                result.handle = i;
+
+                for (guint j = 0; j < matches->len; ++j) {
+                        result.index = g_array_index (matches, guint, j);
+                        g_array_append_val (ret, result);
+                }
+        }
+
+        return ret;
+}
+
+/**
+ * mo_group_lookup_plural:
+ * @self: An initialised #MoGroup.
+ * @handle: The handle of the locale to retrieve the translation for, from
+ * mo_group_get_locale_handle().
+ * @msgid: Untranslated (in the 'C' locale) singular form of the string.
+ * @msgid_plural: Untranslated plural form of the string.
+ * @n: The number the string is for.
+ * @length: (out) (optional): Return location for the length of the
+ * returned string in bytes, not including the trailing NUL, or %NULL.
+ *
+ * Retrieve the right plural form of a translation for @n, as
+ * mo_file_lookup_plural() does, using the plural rule of the locale's own
+ * file.
+ *
+ * Returns: (transfer none) (nullable): the plural form, valid for as long as
+ * @self is alive, or %NULL if @handle is not a valid handle.
+ */
+const gchar *
+mo_group_lookup_plural (MoGroup *self,
+                        guint handle,
+                        const gchar *msgid,
+                        const gchar *msgid_plural,
+                        gulong n,
+                        gsize *length)
+{
+        const gchar *fallback;
+        MoFile *mofile;
+
+        if (!MO_IS_GROUP (self) || !msgid || !msgid_plural ||
+            handle >= self->locales->len)
+                return NULL;
+
+        mofile = locale_get_file (g_ptr_array_index (self->locales, handle));
+
+        if (!mofile) {
+                fallback = n == 1 ? msgid : msgid_plural;
+
+                if (length)
+                        *length = strlen (fallback);
+
+                return fallback;
+        }
+
+        return mo_file_lookup_plural (mofile, msgid, msgid_plural, n, length);
+}
+
+/*
+ * Look the @len bytes at @str, in @context if that is not %NULL, up in every
+ * locale, with hashes as for _mo_file_find_index().
+ */
+static guint
+lookup_translations_hashed (MoGroup *self,
+                            const gchar *context,
+                            gsize context_len,
+                            const gchar *str,
+                            gsize len,
+                            guint32 hash,
+                            guint64 index_hash,
+                            const gchar **translations,
+                            gsize *lengths)
+{
+        MoFile *mofile;
+        guint32 index = 0;
+        guint n_found = 0;
+
+        /* Every locale of a bundle shares one hash table, so one probe
+         * finds the string's entry in all of them */
+        if (self->bundle_index &&
+            !_mo_file_find_index (self->bundle_index,
+                                  context,
+                                  context_len,
+                                  str,
+                                  len,
+                                  hash,
+                                  index_hash,
+                                  &index)) {
+                memset (translations, 0, self->locales->len * sizeof (gchar *));
+                return 0;
+        }
+
+        for (guint i = 0; i < self->locales->len; ++i) {
+                mofile = locale_get_file (g_ptr_array_index (self->locales, i));
+
+                if (!mofile)
+                        translations[i] = NULL;
+                else if (self->bundle_index)
+                        translations[i] = _mo_file_get_translation_at (mofile,
+                                                                       index,
+                                                                       lengths ? &lengths[i] : NULL);
+                else
+                        translations[i] = _mo_file_lookup_hashed (mofile,
+                                                                  context,
+                                                                  context_len,
+                                                                  str,
+                                                                  len,
+                                                                  hash,
+                                                                  index_hash,
+                                                                  lengths ? &lengths[i] : NULL);
+
+                if (translations[i])
+                        n_found++;
+        }
+
+        return n_found;
+}
+
+/**
+ * mo_group_lookup_translations:
+ * @self: An initialised #MoGroup.
+ * @translation: Untranslated (in the 'C' locale) string.
+ * @translations: (out caller-allocates) (array): Return location for the
+ * translations, which must have room for mo_group_get_n_locales() entries.
+ * @lengths: (out caller-allocates) (array) (optional): Return location for
+ * the lengths of the translations, or %NULL.
+ *
+ * Retrieve the translations of a string into every locale at once, without
+ * copying them. Each element of @translations is set to the translation into
+ * the locale with that handle, or to %NULL if it has none. Elements of
+ * @lengths are only set for locales which have a translation.
+ *
+ * @translation is only hashed once. For a #MoGroup loaded from a bundle, it
+ * is also only looked up once, after which each locale's translation is read
+ * directly.
+ *
+ * Returns: the number of locales which have a translation.
+ */
+guint
+mo_group_lookup_translations (MoGroup *self,
+                              const gchar *translation,
+                              const gchar **translations,
+                              gsize *lengths)
+{
+        gsize len;
+
+        if (!MO_IS_GROUP (self) || !translation || !translations)
+                return 0;
+
+        len = strlen (translation);
+
+        return lookup_translations_hashed (self,
+                                           NULL,
+                                           0,
+                                           translation,
+                                           len,
+                                           hashpjw (translation, len),
+                                           mo_index_hash (translation, len),
+                                           translations,
+                                           lengths);
+}
+
+/**
+ * mo_group_lookup_translation_with_context:
+ * @self: An initialised #MoGroup.
+ * @handle: The handle of the locale to retrieve the translation for, from
+ * mo_group_get_locale_handle().
+ * @context: The message context, the msgctxt of the string.
+ * @translation: Untranslated (in the 'C' locale) string.
+ * @length: (out) (optional): Return location for the length of the
+ * translation in bytes, not including the trailing NUL, or %NULL.
+ *
+ * Retrieve the translation of a string in @context without copying it, as
+ * mo_file_lookup_translation_with_context() does.
+ *
+ * Returns: (transfer none) (nullable): the translated string, valid for as
+ * long as @self is alive, or %NULL if no translation was found.
+ */
+const gchar *
+mo_group_lookup_translation_with_context (MoGroup *self,
+                                          guint handle,
+                                          const gchar *context,
+                                          const gchar *translation,
+                                          gsize *length)
+{
+        MoFile *mofile;
+
+        if (!MO_IS_GROUP (self) || !translation || handle >= self->locales->len)
+                return NULL;
+
+        mofile = locale_get_file (g_ptr_array_index (self->locales, handle));
+
+        if (!mofile)
+                return NULL;
+
+        return mo_file_lookup_translation_with_context (mofile, context, translation, length);
+}
+
+/**
+ * mo_group_lookup_translations_with_context:
+ * @self: An initialised #MoGroup.
+ * @context: The message context, the msgctxt of the string.
+ * @translation: Untranslated (in the 'C' locale) string.
+ * @translations: (out caller-allocates) (array): Return location for the
+ * translations, which must have room for mo_group_get_n_locales() entries.
+ * @lengths: (out caller-allocates) (array) (optional): Return location for
+ * the lengths of the translations, or %NULL.
+ *
+ * Like mo_group_lookup_translations(), but for a string in @context. The
+ * context and the string are hashed once, together, for all of the locales.
+ *
+ * Returns: the number of locales which have a translation.
+ */
+guint
+mo_group_lookup_translations_with_context (MoGroup *self,
+                                           const gchar *context,
+                                           const gchar *translation,
+                                           const gchar **translations,
+                                           gsize *lengths)
+{
+        gsize context_len, len;
+
+        if (!MO_IS_GROUP (self) || !context || !translation || !translations)
+                return 0;
+
+        context_len = strlen (context);
+        len = strlen (translation);
+
+        return lookup_translations_hashed (self,
+                                           context,
+                                           context_len,
+                                           translation,
+                                           len,
+                                           hashpjw_context (context, context_len, translation, len),
+                                           mo_index_hash_context (context, context_len, translation, len),
+                                           translations,
+                                           lengths);
+}
+
+/**
+ * mo_group_lookup_key:
+ * @self: An initialised #MoGroup.
+ * @handle: The handle of the locale to retrieve the translation for.
+ * @key: A #MoKey for the untranslated (in the 'C' locale) string.
+ * @length: (out) (optional): Return location for the length of the
+ * translation in bytes, not including the trailing NUL, or %NULL.
+ *
+ * Like mo_group_lookup_translation(), but for a string which has been
+ * prepared as a #MoKey, so that it doesn't have to be hashed again.
+ *
+ * Returns: (transfer none) (nullable): the translated string, valid for as
+ * long as @self is alive, or %NULL if no translation was found.
+ */
+const gchar *
+mo_group_lookup_key (MoGroup *self,
+                     guint handle,
+                     const MoKey *key,
+                     gsize *length)
+{
+        MoFile *mofile;
+
+        if (!MO_IS_GROUP (self) || !key || handle >= self->locales->len)
+                return NULL;
+
+        mofile = locale_get_file (g_ptr_array_index (self->locales, handle));
+
+        if (!mofile)
+                return NULL;
+
+        return mo_file_lookup_key (mofile, key, length);
+}
+
+/**
+ * mo_group_lookup_key_translations:
+ * @self: An initialised #MoGroup.
+ * @key: A #MoKey for the untranslated (in the 'C' locale) string.
+ * @translations: (out caller-allocates) (array): Return location for the
+ * translations, which must have room for mo_group_get_n_locales() entries.
+ * @lengths: (out caller-allocates) (array) (optional): Return location for
+ * the lengths of the translations, or %NULL.
+ *
+ * Like mo_group_lookup_translations(), but for a string which has been
+ * prepared as a #MoKey, so that it doesn't have to be hashed at all.
+ *
+ * Returns: the number of locales which have a translation.
+ */
+guint
+mo_group_lookup_key_translations (MoGroup *self,
+                                  const MoKey *key,
+                                  const gchar **translations,
+                                  gsize *lengths)
+{
+        if (!MO_IS_GROUP (self) || !key || !translations)
+                return 0;
+
+        return lookup_translations_hashed (self,
+                                          NULL,
+                                          0,
+                                          key->msgid,
+                                          key->length,
+                                          key->hash,
+                                          key->index_hash,
+                                          translations,
+                                          lengths);
+}
+
 /**
  * mo_group_get_translation:
  * @self: An initialised #MoGroup.
  * @locale: The locale to retrieve the translation for.
  * @translation: Untranslated (in the 'C' locale) string.
  *
- * Retrieve the translated value of a string.
+ * Retrieve the translated value of a string. For a lazy #MoGroup, this loads
+ * the file for @locale if it has not been loaded yet.
  *
  * Returns: (transfer full): the translated string, or NULL if a translation is not found.
  */
@@ -454,12 +1905,12 @@ mo_group_get_translation (MoGroup *self,
                           const gchar *translation,
                           GError **err)
 {
-        g_autoptr(MoFile) mofile = NULL;
+        MoFile *mofile;
 
         if (!MO_IS_GROUP (self) || !locale || !translation)
                 return NULL;
 
-        mofile = g_object_ref (g_hash_table_lookup (self->mofiles, locale));
+        mofile = get_mo_file (self, locale);
 
         if (!mofile)
                 return NULL;
@@ -467,6 +1918,78 @@ mo_group_get_translation (MoGroup *self,
         return mo_file_get_translation (mofile, translation, err);
 }
 
+/**
+ * mo_group_write_bundle:
+ * @self: An initialised #MoGroup.
+ * @filename: The file to write the bundle to.
+ * @error: Return location for a GError, or NULL.
+ *
+ * Write all of the translations in @self to a single bundle file, which can
+ * be loaded with mo_group_new_from_bundle(). This is much cheaper to load
+ * and query than a directory of .mo files when a domain has many locales.
+ *
+ * Returns: %TRUE on success, or %FALSE on error, in which case @error will be
+ * set.
+ */
+gboolean
+mo_group_write_bundle (MoGroup *self,
+                       const gchar *filename,
+                       GError **error)
+{
+        g_autoptr(GList) locales = NULL;
+        g_autofree const gchar **names = NULL;
+        g_autofree MoFile **files = NULL;
+        guint n_files, i = 0;
+
+        g_return_val_if_fail (MO_IS_GROUP (self), FALSE);
+        g_return_val_if_fail (filename != NULL, FALSE);
+
+        /* Sorted, so that the same group always gives the same bundle */
+        locales = g_list_sort (g_hash_table_get_keys (self->mofiles),
+                               (GCompareFunc) g_strcmp0);
+        n_files = g_hash_table_size (self->mofiles);
+        names = g_new (const gchar *, n_files);
+        files = g_new (MoFile *, n_files);
+
+        /* Leave out any lazily loaded files which turn out to be broken */
+        for (GList *l = locales; l; l = l->next) {
+                names[i] = l->data;
+                files[i] = get_mo_file (self, l->data);
+
+                if (files[i])
+                        i++;
+        }
+
+        n_files = i;
+
+        return mo_bundle_write (filename,
+                                self->domain,
+                                names,
+                                files,
+                                n_files,
+                                error);
+}
+
+/**
+ * mo_group_new_from_bundle:
+ * @filename: Bundle file, as written by mo_group_write_bundle().
+ * @error: Return location for a GError, or NULL.
+ *
+ * Create a new #MoGroup, containing all translations from the bundle
+ * @filename. The bundle is mapped into memory rather than read.
+ *
+ * Returns: The new #MoGroup, or NULL on error, in which case @error will be set.
+ */
+MoGroup *
+mo_group_new_from_bundle (const gchar *filename, GError **error)
+{
+        return MO_GROUP (g_initable_new (MO_TYPE_GROUP,
+                                         NULL,
+                                         error,
+                                         "bundle", filename,
+                                         NULL));
+}
+
 /**
  * mo_group_new_for_directory
  * @domain: Domain to creat this #MoGroup for.
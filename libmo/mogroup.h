@@ -25,6 +25,9 @@
 #include <gio/gio.h>
 #include <glib-object.h>
 
+#include "mokey.h"
+#include "moview.h"
+
 #if !(defined(_IN_MO_H) || defined(MO_COMPILATION))
 #error "mogroup.h must not be included individually, include mo.h instead"
 #endif
@@ -34,11 +37,14 @@ G_BEGIN_DECLS
 /**
  * MoGroupError:
  * @MO_GROUP_NO_SUCH_DIRECTORY_ERROR: The directory did not exist.
+ * @MO_GROUP_INVALID_BUNDLE_ERROR: The bundle file could not be parsed, or the
+ * translations were too large to write one.
  *
  * Error codes for operations on #MoGroups.
  */
 typedef enum {
         MO_GROUP_NO_SUCH_DIRECTORY_ERROR,
+        MO_GROUP_INVALID_BUNDLE_ERROR,
 } MoGroupError;
 
 /**
@@ -64,10 +70,55 @@ G_DECLARE_FINAL_TYPE (MoGroup, mo_group, MO, GROUP, GObject)
 #define MO_GROUP_ERROR (mo_group_error_quark ())
 GQuark mo_group_error_quark (void) G_GNUC_CONST;
 
+/**
+ * MoGroupStats:
+ * @n_locales: The number of locales in the group.
+ * @n_loaded: How many of those have had their file loaded. This is less
+ * than @n_locales only for a #MoGroup:lazy group.
+ * @arena_size: The memory taken from the heap for the group's record of its
+ * locales, in bytes. The memory used by each locale's #MoFile is reported by
+ * mo_file_get_stats().
+ * @arena_used: How much of @arena_size is in use, in bytes.
+ * @reverse_index_size: The memory used by the loaded locales' indexes for
+ * mo_group_lookup_originals(), in bytes.
+ * @search_index_size: The memory used by the loaded locales' search
+ * indexes, in bytes.
+ * @n_pending: How many new locales a #MoGroup:watch group has found, which
+ * mo_group_update() will add.
+ * @n_retired: How many files reloads have replaced, which mo_group_update()
+ * will free.
+ *
+ * Statistics about a #MoGroup, as returned by mo_group_get_stats().
+ */
+typedef struct {
+        guint n_locales;
+        guint n_loaded;
+        gsize arena_size;
+        gsize arena_used;
+        gsize reverse_index_size;
+        gsize search_index_size;
+        guint n_pending;
+        guint n_retired;
+} MoGroupStats;
+
+/**
+ * MoSearchResult:
+ * @handle: The handle of the locale the entry is in.
+ * @index: The position of the entry in the locale's file, as for
+ * mo_file_get_entry().
+ *
+ * An entry found by mo_group_search().
+ */
+typedef struct {
+        guint handle;
+        guint index;
+} MoSearchResult;
+
 MoGroup *mo_group_new (const gchar *domain, GError **error);
 MoGroup *mo_group_new_for_directory (const gchar *domain,
                                      const gchar *directory,
                                      GError **error);
+MoGroup *mo_group_new_from_bundle (const gchar *filename, GError **error);
 
 const gchar *mo_group_get_directory (MoGroup *self);
 const gchar *mo_group_get_domain (MoGroup *self);
@@ -80,4 +131,57 @@ gchar *mo_group_get_translation (MoGroup *self,
                                  const gchar *translation,
                                  GError **err);
 
+MoView *mo_group_get_translations_view (MoGroup *self, GError **error);
+guint mo_group_get_n_locales (MoGroup *self);
+gint mo_group_get_locale_handle (MoGroup *self, const gchar *locale);
+const gchar *mo_group_get_locale_name (MoGroup *self, guint handle);
+void mo_group_get_stats (MoGroup *self, MoGroupStats *stats);
+guint mo_group_update (MoGroup *self);
+const gchar *mo_group_lookup_translation (MoGroup *self,
+                                          guint handle,
+                                          const gchar *translation,
+                                          gsize *length);
+const gchar *mo_group_lookup_plural (MoGroup *self,
+                                     guint handle,
+                                     const gchar *msgid,
+                                     const gchar *msgid_plural,
+                                     gulong n,
+                                     gsize *length);
+guint mo_group_lookup_originals (MoGroup *self,
+                                 guint handle,
+                                 const gchar *translation,
+                                 MoEntry *entries,
+                                 guint max_entries);
+void mo_group_build_search_index (MoGroup *self, MoSearchFlags fields);
+GArray *mo_group_search (MoGroup *self,
+                         const gchar *query,
+                         guint max_errors,
+                         MoSearchFlags flags);
+guint mo_group_lookup_translations (MoGroup *self,
+                                    const gchar *translation,
+                                    const gchar **translations,
+                                    gsize *lengths);
+const gchar *mo_group_lookup_translation_with_context (MoGroup *self,
+                                                       guint handle,
+                                                       const gchar *context,
+                                                       const gchar *translation,
+                                                       gsize *length);
+guint mo_group_lookup_translations_with_context (MoGroup *self,
+                                                 const gchar *context,
+                                                 const gchar *translation,
+                                                 const gchar **translations,
+                                                 gsize *lengths);
+const gchar *mo_group_lookup_key (MoGroup *self,
+                                  guint handle,
+                                  const MoKey *key,
+                                  gsize *length);
+guint mo_group_lookup_key_translations (MoGroup *self,
+                                        const MoKey *key,
+                                        const gchar **translations,
+                                        gsize *lengths);
+
+gboolean mo_group_write_bundle (MoGroup *self,
+                                const gchar *filename,
+                                GError **error);
+
 G_END_DECLS
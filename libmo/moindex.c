@@ -0,0 +1,305 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "moindex.h"
+
+#include <string.h>
+
+/*
+ * An in-memory index from original strings to their position in a .mo file,
+ * which #MoFile can build at load time in place of probing the file's own
+ * hash table.
+ *
+ * It is an open addressing table of a power of two size, probed linearly.
+ * Each slot stores a 64-bit hash of its key and the key's length next to a
+ * pointer to the key itself, so a probe only touches the string when both of
+ * those already match; a miss practically never leaves the slot array. The
+ * table is sized so that it is never more than three quarters full.
+ *
+ * The index is filled once and only read afterwards, so it needs no locking.
+ */
+
+#if defined(__GNUC__)
+#define MO_INDEX_PREFETCH(addr) __builtin_prefetch ((addr), 0 /* read */, 1 /* low locality */)
+#else
+#define MO_INDEX_PREFETCH(addr) ((void) (addr))
+#endif
+
+typedef struct {
+        guint64 hash;
+        const gchar *key;       /* borrowed, or NULL if the slot is unused */
+        guint32 length;
+        guint32 value;
+} MoIndexSlot;
+
+struct _MoIndex {
+        MoIndexSlot *slots;
+        gsize mask;
+        gsize n_entries;
+        gsize max_entries;
+};
+
+static inline guint64
+mix64 (guint64 h)
+{
+        h ^= h >> 33;
+        h *= G_GUINT64_CONSTANT (0xff51afd7ed558ccd);
+        h ^= h >> 33;
+        h *= G_GUINT64_CONSTANT (0xc4ceb9fe1a85ec53);
+        h ^= h >> 33;
+
+        return h;
+}
+
+/*
+ * Hash @length bytes at @key, eight at a time. Unlike hashpjw() every bit of
+ * the input affects every bit of the result, so the low bits can be used to
+ * pick a slot directly.
+ */
+guint64
+mo_index_hash (const gchar *key, gsize length)
+{
+        guint64 h = G_GUINT64_CONSTANT (0x9e3779b97f4a7c15) ^ length;
+        guint64 word;
+
+        while (length >= sizeof (word)) {
+                memcpy (&word, key, sizeof (word));
+                h = (h ^ mix64 (word)) * G_GUINT64_CONSTANT (0x9fb21c651e98df25);
+                key += sizeof (word);
+                length -= sizeof (word);
+        }
+
+        if (length > 0) {
+                word = 0;
+                memcpy (&word, key, length);
+                h = (h ^ mix64 (word)) * G_GUINT64_CONSTANT (0x9fb21c651e98df25);
+        }
+
+        return mix64 (h);
+}
+
+typedef struct {
+        guint64 h;
+        guint64 word;
+        gsize n_pending;
+} HashState;
+
+static inline void
+hash_state_update (HashState *state, const gchar *key, gsize length)
+{
+        gsize n;
+
+        while (length > 0) {
+                n = MIN (length, sizeof (state->word) - state->n_pending);
+                memcpy ((guint8 *) &state->word + state->n_pending, key, n);
+                state->n_pending += n;
+                key += n;
+                length -= n;
+
+                if (state->n_pending == sizeof (state->word)) {
+                        state->h = (state->h ^ mix64 (state->word)) * G_GUINT64_CONSTANT (0x9fb21c651e98df25);
+                        state->word = 0;
+                        state->n_pending = 0;
+                }
+        }
+}
+
+/*
+ * The mo_index_hash() of "@context\004@key", the form an entry with a
+ * msgctxt is stored in, computed from its parts without joining them.
+ */
+guint64
+mo_index_hash_context (const gchar *context,
+                       gsize context_length,
+                       const gchar *key,
+                       gsize length)
+{
+        const gchar separator = '\004';
+        HashState state = { 0, };
+
+        state.h = G_GUINT64_CONSTANT (0x9e3779b97f4a7c15) ^ (context_length + 1 + length);
+
+        hash_state_update (&state, context, context_length);
+        hash_state_update (&state, &separator, 1);
+        hash_state_update (&state, key, length);
+
+        if (state.n_pending > 0)
+                state.h = (state.h ^ mix64 (state.word)) * G_GUINT64_CONSTANT (0x9fb21c651e98df25);
+
+        return mix64 (state.h);
+}
+
+/*
+ * Create an empty index with room for @max_entries keys.
+ */
+MoIndex *
+mo_index_new (gsize max_entries)
+{
+        MoIndex *index;
+        gsize n_slots = 8;
+
+        while (n_slots / 4 * 3 < max_entries)
+                n_slots *= 2;
+
+        index = g_new (MoIndex, 1);
+        index->slots = g_new0 (MoIndexSlot, n_slots);
+        index->mask = n_slots - 1;
+        index->n_entries = 0;
+        index->max_entries = max_entries;
+
+        return index;
+}
+
+void
+mo_index_free (MoIndex *index)
+{
+        if (!index)
+                return;
+
+        g_free (index->slots);
+        g_free (index);
+}
+
+/*
+ * The number of bytes of memory used by @index.
+ */
+gsize
+mo_index_get_size (const MoIndex *index)
+{
+        if (!index)
+                return 0;
+
+        return sizeof (MoIndex) + (index->mask + 1) * sizeof (MoIndexSlot);
+}
+
+/*
+ * Add @key, of @length bytes and whose mo_index_hash() is @hash, to @index
+ * with @value. The key is not copied, and must stay alive as long as the
+ * index. If the key is already present, the existing value is kept and FALSE
+ * is returned, so the first of several duplicate entries wins as it would
+ * when probing the file's own hash table.
+ */
+gboolean
+mo_index_insert (MoIndex *index,
+                 const gchar *key,
+                 gsize length,
+                 guint64 hash,
+                 guint32 value)
+{
+        MoIndexSlot *slot;
+        gsize i;
+
+        g_return_val_if_fail (index != NULL, FALSE);
+        g_return_val_if_fail (key != NULL, FALSE);
+        g_return_val_if_fail (length <= G_MAXUINT32, FALSE);
+        g_return_val_if_fail (index->n_entries < index->max_entries, FALSE);
+
+        for (i = hash & index->mask; ; i = (i + 1) & index->mask) {
+                slot = &index->slots[i];
+
+                if (!slot->key)
+                        break;
+
+                if (slot->hash == hash &&
+                    slot->length == length &&
+                    memcmp (slot->key, key, length) == 0)
+                        return FALSE;
+        }
+
+        slot->hash = hash;
+        slot->key = key;
+        slot->length = (guint32) length;
+        slot->value = value;
+        index->n_entries++;
+
+        return TRUE;
+}
+
+/*
+ * Find @key, of @length bytes and whose mo_index_hash() is @hash, in @index.
+ * Returns TRUE and sets @value if found.
+ */
+gboolean
+mo_index_lookup (const MoIndex *index,
+                 const gchar *key,
+                 gsize length,
+                 guint64 hash,
+                 guint32 *value)
+{
+        const MoIndexSlot *slot;
+
+        for (gsize i = hash & index->mask; ; i = (i + 1) & index->mask) {
+                slot = &index->slots[i];
+
+                if (!slot->key)
+                        return FALSE;
+
+                if (slot->hash == hash &&
+                    slot->length == length &&
+                    memcmp (slot->key, key, length) == 0) {
+                        *value = slot->value;
+                        return TRUE;
+                }
+        }
+}
+
+/*
+ * Start fetching the slot which a lookup of @hash will read first, so that a
+ * caller with several keys to find can overlap their memory accesses.
+ */
+void
+mo_index_prefetch (const MoIndex *index, guint64 hash)
+{
+        MO_INDEX_PREFETCH (&index->slots[hash & index->mask]);
+}
+
+/*
+ * Like mo_index_lookup(), but for the key "@context\004@key", given as its
+ * parts, whose mo_index_hash_context() is @hash.
+ */
+gboolean
+mo_index_lookup_context (const MoIndex *index,
+                         const gchar *context,
+                         gsize context_length,
+                         const gchar *key,
+                         gsize length,
+                         guint64 hash,
+                         guint32 *value)
+{
+        const MoIndexSlot *slot;
+
+        for (gsize i = hash & index->mask; ; i = (i + 1) & index->mask) {
+                slot = &index->slots[i];
+
+                if (!slot->key)
+                        return FALSE;
+
+                if (slot->hash == hash &&
+                    slot->length == context_length + 1 + length &&
+                    slot->key[context_length] == '\004' &&
+                    memcmp (slot->key, context, context_length) == 0 &&
+                    memcmp (slot->key + context_length + 1, key, length) == 0) {
+                        *value = slot->value;
+                        return TRUE;
+                }
+        }
+}
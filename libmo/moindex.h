@@ -0,0 +1,73 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#if !defined(MO_COMPILATION)
+#error "moindex.h is private to libmo"
+#endif
+
+G_BEGIN_DECLS
+
+typedef struct _MoIndex MoIndex;
+
+G_GNUC_INTERNAL
+guint64 mo_index_hash (const gchar *key, gsize length);
+G_GNUC_INTERNAL
+guint64 mo_index_hash_context (const gchar *context,
+                               gsize context_length,
+                               const gchar *key,
+                               gsize length);
+
+G_GNUC_INTERNAL
+MoIndex *mo_index_new (gsize max_entries);
+G_GNUC_INTERNAL
+void mo_index_free (MoIndex *index);
+G_GNUC_INTERNAL
+gsize mo_index_get_size (const MoIndex *index);
+
+G_GNUC_INTERNAL
+gboolean mo_index_insert (MoIndex *index,
+                          const gchar *key,
+                          gsize length,
+                          guint64 hash,
+                          guint32 value);
+G_GNUC_INTERNAL
+gboolean mo_index_lookup (const MoIndex *index,
+                          const gchar *key,
+                          gsize length,
+                          guint64 hash,
+                          guint32 *value);
+G_GNUC_INTERNAL
+gboolean mo_index_lookup_context (const MoIndex *index,
+                                  const gchar *context,
+                                  gsize context_length,
+                                  const gchar *key,
+                                  gsize length,
+                                  guint64 hash,
+                                  guint32 *value);
+G_GNUC_INTERNAL
+void mo_index_prefetch (const MoIndex *index, guint64 hash);
+
+G_END_DECLS
@@ -0,0 +1,162 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "mokey.h"
+#include "mofile-private.h"
+#include "moindex.h"
+
+#include <string.h>
+
+/**
+ * SECTION:mokey
+ * @short_description: Prepared untranslated strings.
+ * @title: MoKey
+ * @stability: unstable
+ * @include: libmo/mo.h
+ *
+ * Looking a string up in a #MoFile starts by hashing all of it. A program
+ * which translates the same strings over and over, perhaps into many
+ * locales, can instead prepare each of them once as a #MoKey, which holds
+ * the string along with its hashes, and look that up with
+ * mo_file_lookup_key(), mo_group_lookup_key() or
+ * mo_group_lookup_key_translations(). These skip hashing entirely.
+ *
+ * <example>
+ * <title>Preparing a string literal once, from any thread.</title>
+ *
+ * <programlisting>
+ *    static MoKey *key;
+ *
+ *    if (g_once_init_enter (&key))
+ *            g_once_init_leave (&key, mo_key_new_static ("edit the source information file"));
+ *
+ *    trans = mo_file_lookup_key (mofile, key, NULL);
+ * </programlisting>
+ * </example>
+ */
+
+G_DEFINE_BOXED_TYPE (MoKey, mo_key, mo_key_copy, mo_key_free)
+
+static MoKey *
+key_new (const gchar *msgid, gboolean is_static)
+{
+        MoKey *key = g_new (MoKey, 1);
+
+        key->length = strlen (msgid);
+        key->msgid = is_static ? (gchar *) msgid : g_strndup (msgid, key->length);
+        key->hash = hashpjw (msgid, key->length);
+        key->index_hash = mo_index_hash (msgid, key->length);
+        key->is_static = is_static;
+
+        return key;
+}
+
+/**
+ * mo_key_new:
+ * @msgid: Untranslated (in the 'C' locale) string.
+ *
+ * Prepare @msgid for looking up. @msgid is copied.
+ *
+ * Returns: (transfer full): A new #MoKey. Free it with mo_key_free().
+ */
+MoKey *
+mo_key_new (const gchar *msgid)
+{
+        g_return_val_if_fail (msgid != NULL, NULL);
+
+        return key_new (msgid, FALSE);
+}
+
+/**
+ * mo_key_new_static:
+ * @msgid: Untranslated (in the 'C' locale) string, which must stay alive and
+ * unchanged for as long as the key, such as a string literal.
+ *
+ * Prepare @msgid for looking up, without copying it.
+ *
+ * Returns: (transfer full): A new #MoKey. Free it with mo_key_free().
+ */
+MoKey *
+mo_key_new_static (const gchar *msgid)
+{
+        g_return_val_if_fail (msgid != NULL, NULL);
+
+        return key_new (msgid, TRUE);
+}
+
+/**
+ * mo_key_copy:
+ * @key: A #MoKey.
+ *
+ * Copy @key. The string of a static key is not copied.
+ *
+ * Returns: (transfer full): A new #MoKey. Free it with mo_key_free().
+ */
+MoKey *
+mo_key_copy (const MoKey *key)
+{
+        MoKey *copy;
+
+        g_return_val_if_fail (key != NULL, NULL);
+
+        copy = g_new (MoKey, 1);
+        *copy = *key;
+
+        if (!key->is_static)
+                copy->msgid = g_strndup (key->msgid, key->length);
+
+        return copy;
+}
+
+/**
+ * mo_key_free:
+ * @key: (nullable): A #MoKey.
+ *
+ * Free @key.
+ */
+void
+mo_key_free (MoKey *key)
+{
+        if (!key)
+                return;
+
+        if (!key->is_static)
+                g_free (key->msgid);
+
+        g_free (key);
+}
+
+/**
+ * mo_key_get_msgid:
+ * @key: A #MoKey.
+ *
+ * Get the untranslated string which @key was prepared from.
+ *
+ * Returns: (transfer none): The string.
+ */
+const gchar *
+mo_key_get_msgid (const MoKey *key)
+{
+        g_return_val_if_fail (key != NULL, NULL);
+
+        return key->msgid;
+}
@@ -0,0 +1,59 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+#if !(defined(_IN_MO_H) || defined(MO_COMPILATION))
+#error "mokey.h must not be included individually, include mo.h instead"
+#endif
+
+G_BEGIN_DECLS
+
+/**
+ * MO_TYPE_KEY:
+ *
+ * #GType for #MoKey.
+ */
+#define MO_TYPE_KEY (mo_key_get_type ())
+
+/**
+ * MoKey:
+ *
+ * An untranslated string prepared for looking up, with mo_file_lookup_key()
+ * and the #MoGroup key functions. All of its fields are private.
+ */
+typedef struct _MoKey MoKey;
+
+GType mo_key_get_type (void) G_GNUC_CONST;
+
+MoKey *mo_key_new (const gchar *msgid);
+MoKey *mo_key_new_static (const gchar *msgid);
+MoKey *mo_key_copy (const MoKey *key);
+void mo_key_free (MoKey *key);
+
+const gchar *mo_key_get_msgid (const MoKey *key);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (MoKey, mo_key_free)
+
+G_END_DECLS
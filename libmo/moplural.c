@@ -0,0 +1,587 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "moplural.h"
+
+#include <string.h>
+
+/*
+ * The plural form selector of a catalogue, from the "Plural-Forms:" field of
+ * its header, such as "nplurals=2; plural=(n != 1);".
+ *
+ * The expression, a C expression in n, is compiled once into postfix
+ * bytecode for a small stack machine. The conditional operator evaluates
+ * both of its branches and then selects one, so the code has no jumps; the
+ * expressions have no side effects, and division by zero gives 0, so this is
+ * safe. The forms for n below PLURAL_TABLE_SIZE, which covers nearly every
+ * real call, are then computed up front, so picking one of those is a single
+ * table read. Nothing is allocated after construction.
+ *
+ * As in GNU gettext, a missing or invalid field means the Germanic rule,
+ * "nplurals=2; plural=(n != 1);", and a result outside of the range of forms
+ * means the first form.
+ */
+
+#define PLURAL_TABLE_SIZE 1000
+
+/* Expressions needing more than this are rejected, so evaluation never has
+ * to allocate its stack */
+#define MAX_STACK_DEPTH 32
+
+/* And this limits how deeply the parser may recurse */
+#define MAX_NESTING 64
+
+typedef enum {
+        OP_N,
+        OP_CONST,
+        OP_NOT,
+        OP_MUL,
+        OP_DIV,
+        OP_MOD,
+        OP_ADD,
+        OP_SUB,
+        OP_LT,
+        OP_GT,
+        OP_LE,
+        OP_GE,
+        OP_EQ,
+        OP_NE,
+        OP_AND,
+        OP_OR,
+        OP_SELECT,
+} MoPluralOp;
+
+typedef struct {
+        MoPluralOp op;
+        gulong value;           /* for OP_CONST */
+} MoPluralInsn;
+
+struct _MoPlural {
+        guint n_plurals;
+        gchar *expression;
+        guint8 table[PLURAL_TABLE_SIZE];
+        guint n_code;
+        MoPluralInsn code[];
+};
+
+typedef struct {
+        const gchar *p;
+        const gchar *end;
+        GArray *code;
+        guint depth;
+        guint max_depth;
+        guint nesting;
+        gboolean failed;
+} Parser;
+
+static gulong
+run (const MoPluralInsn *code, guint n_code, gulong n)
+{
+        gulong stack[MAX_STACK_DEPTH];
+        guint sp = 0;
+        gulong a, b;
+
+        for (guint i = 0; i < n_code; ++i) {
+                switch (code[i].op) {
+                case OP_N:
+                        stack[sp++] = n;
+                        continue;
+                case OP_CONST:
+                        stack[sp++] = code[i].value;
+                        continue;
+                case OP_NOT:
+                        stack[sp - 1] = !stack[sp - 1];
+                        continue;
+                case OP_SELECT:
+                        sp -= 2;
+                        stack[sp - 1] = stack[sp - 1] ? stack[sp] : stack[sp + 1];
+                        continue;
+                case OP_MUL:
+                case OP_DIV:
+                case OP_MOD:
+                case OP_ADD:
+                case OP_SUB:
+                case OP_LT:
+                case OP_GT:
+                case OP_LE:
+                case OP_GE:
+                case OP_EQ:
+                case OP_NE:
+                case OP_AND:
+                case OP_OR:
+                default:
+                        break;
+                }
+
+                b = stack[--sp];
+                a = stack[sp - 1];
+
+                switch (code[i].op) {
+                case OP_MUL: a = a * b; break;
+                case OP_DIV: a = b ? a / b : 0; break;
+                case OP_MOD: a = b ? a % b : 0; break;
+                case OP_ADD: a = a + b; break;
+                case OP_SUB: a = a - b; break;
+                case OP_LT: a = a < b; break;
+                case OP_GT: a = a > b; break;
+                case OP_LE: a = a <= b; break;
+                case OP_GE: a = a >= b; break;
+                case OP_EQ: a = a == b; break;
+                case OP_NE: a = a != b; break;
+                case OP_AND: a = a && b; break;
+                case OP_OR: a = a || b; break;
+                case OP_N:
+                case OP_CONST:
+                case OP_NOT:
+                case OP_SELECT:
+                default:
+                        g_assert_not_reached ();
+                }
+
+                stack[sp - 1] = a;
+        }
+
+        return stack[0];
+}
+
+static void
+emit (Parser *parser, MoPluralOp op, gulong value)
+{
+        MoPluralInsn insn = { op, value };
+
+        switch (op) {
+        case OP_N:
+        case OP_CONST:
+                parser->depth++;
+                break;
+        case OP_NOT:
+                break;
+        case OP_SELECT:
+                parser->depth -= 2;
+                break;
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_ADD:
+        case OP_SUB:
+        case OP_LT:
+        case OP_GT:
+        case OP_LE:
+        case OP_GE:
+        case OP_EQ:
+        case OP_NE:
+        case OP_AND:
+        case OP_OR:
+        default:
+                parser->depth--;
+                break;
+        }
+
+        parser->max_depth = MAX (parser->max_depth, parser->depth);
+        g_array_append_val (parser->code, insn);
+}
+
+static void
+skip_spaces (Parser *parser)
+{
+        while (parser->p < parser->end && g_ascii_isspace (*parser->p))
+                parser->p++;
+}
+
+/*
+ * Consume @token if it comes next, but not if it is the start of a longer
+ * operator which is also given as @not_followed_by, such as "<" of "<=".
+ */
+static gboolean
+accept (Parser *parser, const gchar *token, gchar not_followed_by)
+{
+        gsize len = strlen (token);
+
+        skip_spaces (parser);
+
+        if ((gsize) (parser->end - parser->p) < len ||
+            memcmp (parser->p, token, len) != 0)
+                return FALSE;
+
+        if (not_followed_by &&
+            parser->p + len < parser->end &&
+            parser->p[len] == not_followed_by)
+                return FALSE;
+
+        parser->p += len;
+
+        return TRUE;
+}
+
+static void parse_conditional (Parser *parser);
+
+static void
+parse_primary (Parser *parser)
+{
+        gulong value = 0;
+
+        skip_spaces (parser);
+
+        if (accept (parser, "(", 0)) {
+                parse_conditional (parser);
+
+                if (!accept (parser, ")", 0))
+                        parser->failed = TRUE;
+        } else if (accept (parser, "n", 0)) {
+                emit (parser, OP_N, 0);
+        } else if (parser->p < parser->end && g_ascii_isdigit (*parser->p)) {
+                while (parser->p < parser->end && g_ascii_isdigit (*parser->p)) {
+                        value = value * 10 + (gulong) (*parser->p++ - '0');
+
+                        if (value > G_MAXUINT32)
+                                parser->failed = TRUE;
+                }
+
+                emit (parser, OP_CONST, value);
+        } else {
+                parser->failed = TRUE;
+        }
+}
+
+static void
+parse_unary (Parser *parser)
+{
+        guint64 n_nots = 0;
+
+        /* Counted rather than recursed into, so that a header with a long
+         * run of them can't exhaust the stack */
+        while (accept (parser, "!", '='))
+                n_nots++;
+
+        parse_primary (parser);
+
+        /* Only whether there is an odd number matters, but any number of
+         * them makes a truth value */
+        if (n_nots % 2 == 1) {
+                emit (parser, OP_NOT, 0);
+        } else if (n_nots > 0) {
+                emit (parser, OP_NOT, 0);
+                emit (parser, OP_NOT, 0);
+        }
+}
+
+static void
+parse_multiplicative (Parser *parser)
+{
+        MoPluralOp op;
+
+        parse_unary (parser);
+
+        while (!parser->failed) {
+                if (accept (parser, "*", 0))
+                        op = OP_MUL;
+                else if (accept (parser, "/", 0))
+                        op = OP_DIV;
+                else if (accept (parser, "%", 0))
+                        op = OP_MOD;
+                else
+                        break;
+
+                parse_unary (parser);
+                emit (parser, op, 0);
+        }
+}
+
+static void
+parse_additive (Parser *parser)
+{
+        MoPluralOp op;
+
+        parse_multiplicative (parser);
+
+        while (!parser->failed) {
+                if (accept (parser, "+", 0))
+                        op = OP_ADD;
+                else if (accept (parser, "-", 0))
+                        op = OP_SUB;
+                else
+                        break;
+
+                parse_multiplicative (parser);
+                emit (parser, op, 0);
+        }
+}
+
+static void
+parse_relational (Parser *parser)
+{
+        MoPluralOp op;
+
+        parse_additive (parser);
+
+        while (!parser->failed) {
+                if (accept (parser, "<=", 0))
+                        op = OP_LE;
+                else if (accept (parser, ">=", 0))
+                        op = OP_GE;
+                else if (accept (parser, "<", 0))
+                        op = OP_LT;
+                else if (accept (parser, ">", 0))
+                        op = OP_GT;
+                else
+                        break;
+
+                parse_additive (parser);
+                emit (parser, op, 0);
+        }
+}
+
+static void
+parse_equality (Parser *parser)
+{
+        MoPluralOp op;
+
+        parse_relational (parser);
+
+        while (!parser->failed) {
+                if (accept (parser, "==", 0))
+                        op = OP_EQ;
+                else if (accept (parser, "!=", 0))
+                        op = OP_NE;
+                else
+                        break;
+
+                parse_relational (parser);
+                emit (parser, op, 0);
+        }
+}
+
+static void
+parse_and (Parser *parser)
+{
+        parse_equality (parser);
+
+        while (!parser->failed && accept (parser, "&&", 0)) {
+                parse_equality (parser);
+                emit (parser, OP_AND, 0);
+        }
+}
+
+static void
+parse_or (Parser *parser)
+{
+        parse_and (parser);
+
+        while (!parser->failed && accept (parser, "||", 0)) {
+                parse_and (parser);
+                emit (parser, OP_OR, 0);
+        }
+}
+
+static void
+parse_conditional (Parser *parser)
+{
+        if (++parser->nesting > MAX_NESTING) {
+                parser->failed = TRUE;
+                return;
+        }
+
+        parse_or (parser);
+
+        if (!parser->failed && accept (parser, "?", 0)) {
+                parse_conditional (parser);
+
+                if (!accept (parser, ":", 0))
+                        parser->failed = TRUE;
+                else
+                        parse_conditional (parser);
+
+                emit (parser, OP_SELECT, 0);
+        }
+
+        parser->nesting--;
+}
+
+/*
+ * Find "@name=" in the ';' separated Plural-Forms value, and return where
+ * its value starts and ends.
+ */
+static gboolean
+find_field (const gchar *plural_forms,
+            gsize length,
+            const gchar *name,
+            const gchar **value,
+            const gchar **value_end)
+{
+        const gchar *p = plural_forms, *end = plural_forms + length;
+        const gchar *field_end;
+        gsize name_len = strlen (name);
+
+        while (p < end) {
+                field_end = memchr (p, ';', end - p);
+                if (!field_end)
+                        field_end = end;
+
+                while (p < field_end && g_ascii_isspace (*p))
+                        p++;
+
+                if ((gsize) (field_end - p) > name_len &&
+                    memcmp (p, name, name_len) == 0) {
+                        p += name_len;
+
+                        while (p < field_end && g_ascii_isspace (*p))
+                                p++;
+
+                        if (p < field_end && *p == '=') {
+                                *value = p + 1;
+                                *value_end = field_end;
+                                return TRUE;
+                        }
+                }
+
+                p = field_end + 1;
+        }
+
+        return FALSE;
+}
+
+static MoPlural *
+compile (const gchar *plural_forms, gsize length)
+{
+        g_autoptr(GArray) code = NULL;
+        const gchar *value, *value_end;
+        Parser parser = { 0, };
+        gulong n_plurals = 0;
+        MoPlural *plural;
+
+        if (!find_field (plural_forms, length, "nplurals", &value, &value_end))
+                return NULL;
+
+        while (value < value_end && g_ascii_isspace (*value))
+                value++;
+
+        while (value < value_end && g_ascii_isdigit (*value) && n_plurals <= G_MAXUINT8)
+                n_plurals = n_plurals * 10 + (gulong) (*value++ - '0');
+
+        if (n_plurals == 0 || n_plurals > G_MAXUINT8)
+                return NULL;
+
+        if (!find_field (plural_forms, length, "plural", &value, &value_end))
+                return NULL;
+
+        code = g_array_new (FALSE, FALSE, sizeof (MoPluralInsn));
+
+        parser.p = value;
+        parser.end = value_end;
+        parser.code = code;
+
+        parse_conditional (&parser);
+        skip_spaces (&parser);
+
+        if (parser.failed || parser.p != parser.end || parser.depth != 1 ||
+            parser.max_depth > MAX_STACK_DEPTH)
+                return NULL;
+
+        while (value < value_end && g_ascii_isspace (*value))
+                value++;
+
+        while (value_end > value && g_ascii_isspace (value_end[-1]))
+                value_end--;
+
+        plural = g_malloc (sizeof (MoPlural) + code->len * sizeof (MoPluralInsn));
+        plural->n_plurals = n_plurals;
+        plural->expression = g_strndup (value, value_end - value);
+        plural->n_code = code->len;
+        memcpy (plural->code, code->data, code->len * sizeof (MoPluralInsn));
+
+        return plural;
+}
+
+/*
+ * Compile the value of a "Plural-Forms:" header field, of @length bytes at
+ * @plural_forms, which may be NULL if the catalogue has none. This never
+ * fails: if the field is missing or can't be understood, the result uses the
+ * Germanic rule.
+ */
+MoPlural *
+mo_plural_new (const gchar *plural_forms, gsize length)
+{
+        static const gchar germanic[] = "nplurals=2; plural=(n != 1);";
+        MoPlural *plural = NULL;
+        gulong form;
+
+        if (plural_forms)
+                plural = compile (plural_forms, length);
+
+        if (!plural) {
+                if (plural_forms)
+                        g_debug ("Couldn't parse plural forms '%.*s', using the default",
+                                 (int) length, plural_forms);
+
+                plural = compile (germanic, strlen (germanic));
+                g_assert (plural);
+        }
+
+        for (guint n = 0; n < PLURAL_TABLE_SIZE; ++n) {
+                form = run (plural->code, plural->n_code, n);
+                plural->table[n] = form < plural->n_plurals ? form : 0;
+        }
+
+        return plural;
+}
+
+void
+mo_plural_free (MoPlural *plural)
+{
+        if (!plural)
+                return;
+
+        g_free (plural->expression);
+        g_free (plural);
+}
+
+guint
+mo_plural_get_n_plurals (const MoPlural *plural)
+{
+        return plural->n_plurals;
+}
+
+/*
+ * The expression in use, which is the default one if the catalogue's couldn't
+ * be used.
+ */
+const gchar *
+mo_plural_get_expression (const MoPlural *plural)
+{
+        return plural->expression;
+}
+
+/*
+ * Which of the plural forms to use for @n things.
+ */
+guint
+mo_plural_eval (const MoPlural *plural, gulong n)
+{
+        gulong form;
+
+        if (G_LIKELY (n < PLURAL_TABLE_SIZE))
+                return plural->table[n];
+
+        form = run (plural->code, plural->n_code, n);
+
+        return form < plural->n_plurals ? form : 0;
+}
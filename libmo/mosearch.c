@@ -0,0 +1,387 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "mosearch.h"
+
+#include <string.h>
+
+/*
+ * A trigram index, for finding the entries of a .mo file which contain a
+ * string, exactly or approximately.
+ *
+ * Every run of three bytes of the indexed strings, folded to lower case, is
+ * a trigram. The index maps each trigram to the entries whose strings have
+ * it, in increasing order. A string containing the query must have all of
+ * the query's trigrams, and one within k edits of the query at least all but
+ * 3k of them, as each edit can only break the trigrams overlapping it. So the
+ * entries with enough of the query's trigrams are the candidates, and only
+ * those need to be checked with mo_search_match().
+ *
+ * The trigrams are kept in an open addressing table. Each one's entries are
+ * stored as the differences between consecutive entry numbers, in a
+ * variable length encoding of 7 bits a byte: in a big catalogue most of
+ * them fit in a byte. Entries are added in increasing order, so the index
+ * can be extended a few entries at a time.
+ */
+
+typedef struct {
+        guint8 *postings;       /* NULL if the slot is unused */
+        guint32 length;
+        guint32 allocated;
+        guint32 trigram;
+        guint32 last_entry;
+} MoTrigram;
+
+struct _MoSearchIndex {
+        MoTrigram *trigrams;
+        gsize mask;
+        guint bits;             /* log2 of the number of slots */
+        gsize n_trigrams;
+        gsize postings_size;
+};
+
+#define INITIAL_TRIGRAM_BITS 10
+#define INITIAL_TRIGRAM_SLOTS (1 << INITIAL_TRIGRAM_BITS)
+
+static inline guint32
+make_trigram (const gchar *str)
+{
+        return (guint32) (guchar) g_ascii_tolower (str[0]) << 16 |
+               (guint32) (guchar) g_ascii_tolower (str[1]) << 8 |
+               (guint32) (guchar) g_ascii_tolower (str[2]);
+}
+
+/*
+ * The slot @trigram hashes to, from the top bits of a multiplicative hash:
+ * its low bits would only depend on the low bits of the trigram, so would
+ * ignore its first character.
+ */
+static inline gsize
+trigram_hash (const MoSearchIndex *index, guint32 trigram)
+{
+        return (guint32) (trigram * 2654435761u) >> (32 - index->bits);
+}
+
+MoSearchIndex *
+mo_search_index_new (void)
+{
+        MoSearchIndex *index;
+
+        index = g_new (MoSearchIndex, 1);
+        index->trigrams = g_new0 (MoTrigram, INITIAL_TRIGRAM_SLOTS);
+        index->mask = INITIAL_TRIGRAM_SLOTS - 1;
+        index->bits = INITIAL_TRIGRAM_BITS;
+        index->n_trigrams = 0;
+        index->postings_size = 0;
+
+        return index;
+}
+
+void
+mo_search_index_free (MoSearchIndex *index)
+{
+        if (!index)
+                return;
+
+        for (gsize i = 0; i <= index->mask; ++i)
+                g_free (index->trigrams[i].postings);
+
+        g_free (index->trigrams);
+        g_free (index);
+}
+
+/*
+ * The number of bytes of memory used by @index.
+ */
+gsize
+mo_search_index_get_size (const MoSearchIndex *index)
+{
+        if (!index)
+                return 0;
+
+        return sizeof (MoSearchIndex) +
+               (index->mask + 1) * sizeof (MoTrigram) +
+               index->postings_size;
+}
+
+static const MoTrigram *
+lookup_trigram (const MoSearchIndex *index, guint32 trigram)
+{
+        const MoTrigram *slot;
+
+        for (gsize i = trigram_hash (index, trigram); ; i = (i + 1) & index->mask) {
+                slot = &index->trigrams[i];
+
+                if (!slot->postings)
+                        return NULL;
+
+                if (slot->trigram == trigram)
+                        return slot;
+        }
+}
+
+static MoTrigram *
+insert_trigram (MoSearchIndex *index, guint32 trigram)
+{
+        MoTrigram *slot, *old_trigrams;
+        gsize old_mask;
+
+        for (gsize i = trigram_hash (index, trigram); ; i = (i + 1) & index->mask) {
+                slot = &index->trigrams[i];
+
+                if (!slot->postings)
+                        break;
+
+                if (slot->trigram == trigram)
+                        return slot;
+        }
+
+        /* Keep the table at most three quarters full */
+        if ((index->n_trigrams + 1) > (index->mask + 1) / 4 * 3) {
+                old_trigrams = index->trigrams;
+                old_mask = index->mask;
+
+                index->mask = (old_mask + 1) * 2 - 1;
+                index->bits++;
+                index->trigrams = g_new0 (MoTrigram, index->mask + 1);
+
+                for (gsize i = 0; i <= old_mask; ++i) {
+                        gsize j;
+
+                        if (!old_trigrams[i].postings)
+                                continue;
+
+                        for (j = trigram_hash (index, old_trigrams[i].trigram);
+                             index->trigrams[j].postings;
+                             j = (j + 1) & index->mask)
+                                ;
+
+                        index->trigrams[j] = old_trigrams[i];
+                }
+
+                g_free (old_trigrams);
+
+                return insert_trigram (index, trigram);
+        }
+
+        slot->allocated = 4;
+        slot->postings = g_malloc (slot->allocated);
+        slot->length = 0;
+        slot->trigram = trigram;
+        slot->last_entry = G_MAXUINT32;
+        index->n_trigrams++;
+        index->postings_size += slot->allocated;
+
+        return slot;
+}
+
+static void
+add_posting (MoSearchIndex *index, MoTrigram *slot, guint32 entry)
+{
+        guint32 delta;
+
+        /* Already there for another of the entry's strings */
+        if (slot->last_entry == entry)
+                return;
+
+        delta = slot->last_entry == G_MAXUINT32 ? entry : entry - slot->last_entry;
+        slot->last_entry = entry;
+
+        /* A guint32 takes at most five bytes */
+        if (slot->length + 5 > slot->allocated) {
+                index->postings_size += slot->allocated;
+                slot->allocated *= 2;
+                slot->postings = g_realloc (slot->postings, slot->allocated);
+        }
+
+        while (delta >= 0x80) {
+                slot->postings[slot->length++] = (delta & 0x7f) | 0x80;
+                delta >>= 7;
+        }
+
+        slot->postings[slot->length++] = delta;
+}
+
+/*
+ * Index the @length bytes at @str as part of @entry. Entries must be added
+ * in increasing order, but each may have any number of strings.
+ */
+void
+mo_search_index_add (MoSearchIndex *index,
+                     guint32 entry,
+                     const gchar *str,
+                     gsize length)
+{
+        for (gsize i = 0; i + 3 <= length; ++i)
+                add_posting (index, insert_trigram (index, make_trigram (str + i)), entry);
+}
+
+/*
+ * Find the entries, out of the first @n_entries, which might contain a string
+ * within @max_errors edits of @query, and append their numbers to
+ * @candidates in increasing order. Returns FALSE, without finding anything,
+ * if the query has too few trigrams to narrow the search down; every entry
+ * is then a candidate.
+ */
+gboolean
+mo_search_index_get_candidates (const MoSearchIndex *index,
+                                const gchar *query,
+                                gsize length,
+                                guint max_errors,
+                                guint32 n_entries,
+                                GArray *candidates)
+{
+        g_autoptr(GHashTable) seen = NULL;
+        g_autofree guint16 *counts = NULL;
+        const MoTrigram *slot;
+        guint32 trigram, entry;
+        guint n_distinct = 0, needed;
+        gboolean first;
+        guint shift;
+
+        if (length < 3)
+                return FALSE;
+
+        seen = g_hash_table_new (NULL, NULL);
+        counts = g_new0 (guint16, n_entries);
+
+        for (gsize i = 0; i + 3 <= length; ++i) {
+                trigram = make_trigram (query + i);
+
+                if (g_hash_table_contains (seen, GUINT_TO_POINTER (trigram + 1)))
+                        continue;
+
+                g_hash_table_add (seen, GUINT_TO_POINTER (trigram + 1));
+                n_distinct++;
+
+                slot = lookup_trigram (index, trigram);
+
+                if (!slot)
+                        continue;
+
+                entry = 0;
+                first = TRUE;
+
+                for (guint32 p = 0; p < slot->length; ) {
+                        guint32 delta = 0;
+
+                        for (shift = 0; ; shift += 7) {
+                                guint8 byte = slot->postings[p++];
+
+                                delta |= (guint32) (byte & 0x7f) << shift;
+
+                                if (!(byte & 0x80))
+                                        break;
+                        }
+
+                        entry = first ? delta : entry + delta;
+                        first = FALSE;
+
+                        if (entry < n_entries && counts[entry] < G_MAXUINT16)
+                                counts[entry]++;
+                }
+        }
+
+        if (n_distinct <= 3 * max_errors)
+                return FALSE;
+
+        needed = n_distinct - 3 * max_errors;
+
+        for (guint32 i = 0; i < n_entries; ++i) {
+                if (counts[i] >= needed)
+                        g_array_append_val (candidates, i);
+        }
+
+        return TRUE;
+}
+
+static inline gboolean
+bytes_equal (gchar a, gchar b, gboolean case_insensitive)
+{
+        return a == b ||
+               (case_insensitive && g_ascii_tolower (a) == g_ascii_tolower (b));
+}
+
+/*
+ * Whether the @length bytes at @str contain @query, of @query_length bytes,
+ * with at most @max_errors insertions, deletions or substitutions. @scratch
+ * must have room for @query_length + 1 values.
+ *
+ * Approximate matches are found with Sellers' algorithm: the edit distance
+ * dynamic programme, but letting a match start anywhere in @str.
+ */
+gboolean
+mo_search_match (const gchar *str,
+                 gsize length,
+                 const gchar *query,
+                 gsize query_length,
+                 guint max_errors,
+                 gboolean case_insensitive,
+                 guint *scratch)
+{
+        guint diagonal, above, cost;
+
+        if (query_length <= max_errors)
+                return TRUE;
+
+        if (max_errors == 0) {
+                if (query_length > length)
+                        return FALSE;
+
+                for (gsize i = 0; i + query_length <= length; ++i) {
+                        gsize j;
+
+                        for (j = 0; j < query_length; ++j) {
+                                if (!bytes_equal (str[i + j], query[j], case_insensitive))
+                                        break;
+                        }
+
+                        if (j == query_length)
+                                return TRUE;
+                }
+
+                return FALSE;
+        }
+
+        /* scratch[j] is the fewest edits turning query[0, j) into a suffix
+         * of the text read so far */
+        for (gsize j = 0; j <= query_length; ++j)
+                scratch[j] = j;
+
+        for (gsize i = 0; i < length; ++i) {
+                diagonal = scratch[0];
+
+                for (gsize j = 1; j <= query_length; ++j) {
+                        above = scratch[j];
+                        cost = diagonal + !bytes_equal (str[i], query[j - 1], case_insensitive);
+                        cost = MIN (cost, above + 1);
+                        cost = MIN (cost, scratch[j - 1] + 1);
+                        scratch[j] = cost;
+                        diagonal = above;
+                }
+
+                if (scratch[query_length] <= max_errors)
+                        return TRUE;
+        }
+
+        return FALSE;
+}
@@ -0,0 +1,64 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#if !defined(MO_COMPILATION)
+#error "mosearch.h is private to libmo"
+#endif
+
+G_BEGIN_DECLS
+
+typedef struct _MoSearchIndex MoSearchIndex;
+
+G_GNUC_INTERNAL
+MoSearchIndex *mo_search_index_new (void);
+G_GNUC_INTERNAL
+void mo_search_index_free (MoSearchIndex *index);
+G_GNUC_INTERNAL
+gsize mo_search_index_get_size (const MoSearchIndex *index);
+
+G_GNUC_INTERNAL
+void mo_search_index_add (MoSearchIndex *index,
+                          guint32 entry,
+                          const gchar *str,
+                          gsize length);
+G_GNUC_INTERNAL
+gboolean mo_search_index_get_candidates (const MoSearchIndex *index,
+                                         const gchar *query,
+                                         gsize length,
+                                         guint max_errors,
+                                         guint32 n_entries,
+                                         GArray *candidates);
+
+G_GNUC_INTERNAL
+gboolean mo_search_match (const gchar *str,
+                          gsize length,
+                          const gchar *query,
+                          gsize query_length,
+                          guint max_errors,
+                          gboolean case_insensitive,
+                          guint *scratch);
+
+G_END_DECLS
@@ -0,0 +1,385 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "mosysdep.h"
+#include "mofile.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+/*
+ * The system dependent strings of a revision 1 .mo file.
+ *
+ * msgfmt stores a string such as "%<PRIu64> files" as a list of static parts
+ * and references to named segments like "PRIu64", whose value depends on the
+ * platform the catalogue is used on. We expand every string once, when the
+ * file is loaded, into a side table of ordinary NUL-terminated strings, so
+ * that they can be indexed and looked up exactly like the static ones. A
+ * string using a segment we don't know is left out, as glibc does.
+ */
+
+/* Marks the last static part of a string */
+#define SEGMENTS_END G_MAXUINT32
+
+/* Big enough for the longest conversion, such as "lld" */
+#define SEGMENT_VALUE_SIZE 8
+
+typedef struct {
+        gboolean known;
+        gchar value[SEGMENT_VALUE_SIZE];
+} Segment;
+
+typedef struct {
+        guint32 orig_offset;
+        guint32 orig_length;
+        guint32 trans_offset;
+        guint32 trans_length;
+} Entry;
+
+struct _MoSysdep {
+        GArray *entries;
+        GByteArray *strings;
+};
+
+typedef struct {
+        const guint8 *data;
+        gsize length;
+        gboolean swapped;
+        Segment *segments;
+        guint32 n_segments;
+        GByteArray *strings;
+} Reader;
+
+/* The <inttypes.h> macros for the d conversion of each size, which give us
+ * the length modifier to use for all of the other conversions */
+static const struct {
+        const gchar *name;
+        const gchar *format;
+} pri_sizes[] = {
+        { "8", PRId8 },
+        { "16", PRId16 },
+        { "32", PRId32 },
+        { "64", PRId64 },
+        { "LEAST8", PRIdLEAST8 },
+        { "LEAST16", PRIdLEAST16 },
+        { "LEAST32", PRIdLEAST32 },
+        { "LEAST64", PRIdLEAST64 },
+        { "FAST8", PRIdFAST8 },
+        { "FAST16", PRIdFAST16 },
+        { "FAST32", PRIdFAST32 },
+        { "FAST64", PRIdFAST64 },
+        { "MAX", PRIdMAX },
+        { "PTR", PRIdPTR },
+};
+
+/*
+ * Work out what the segment called @name, of @length bytes, expands to on
+ * this platform, such as "lu" for "PRIu64" on LP64 systems.
+ */
+static gboolean
+get_segment_value (const gchar *name, gsize length, gchar *value)
+{
+        gsize modifier_len;
+
+        /* The flag for locale specific digits, which only glibc has */
+        if (length == 1 && name[0] == 'I') {
+#if defined(__GLIBC__)
+                strcpy (value, "I");
+#else
+                value[0] = '\0';
+#endif
+                return TRUE;
+        }
+
+        if (length < 5 || memcmp (name, "PRI", 3) != 0 ||
+            name[3] == '\0' || !strchr ("diouxX", name[3]))
+                return FALSE;
+
+        for (gsize i = 0; i < G_N_ELEMENTS (pri_sizes); ++i) {
+                if (strlen (pri_sizes[i].name) != length - 4 ||
+                    memcmp (pri_sizes[i].name, name + 4, length - 4) != 0)
+                        continue;
+
+                modifier_len = strlen (pri_sizes[i].format) - 1;
+                if (modifier_len + 2 > SEGMENT_VALUE_SIZE)
+                        return FALSE;
+
+                memcpy (value, pri_sizes[i].format, modifier_len);
+                value[modifier_len] = name[3];
+                value[modifier_len + 1] = '\0';
+
+                return TRUE;
+        }
+
+        return FALSE;
+}
+
+static gboolean
+read_word (const Reader *reader, guint64 offset, guint32 *value)
+{
+        guint32 word;
+
+        if (offset + sizeof (word) > reader->length)
+                return FALSE;
+
+        memcpy (&word, reader->data + offset, sizeof (word));
+        *value = reader->swapped ? GUINT32_SWAP_LE_BE (word) : word;
+
+        return TRUE;
+}
+
+static void
+set_truncated_error (GError **error)
+{
+        g_set_error (error,
+                     MO_FILE_ERROR,
+                     MO_FILE_INVALID_FILE_ERROR,
+                     "File is truncated.",
+                     NULL);
+}
+
+/*
+ * Expand the string described at @offset onto the end of the reader's
+ * strings, NUL-terminated, and set @string_offset and @string_length to
+ * where it went. If it uses a segment which we don't know, nothing is added
+ * and @expanded is set to FALSE. Returns FALSE only if the file is
+ * malformed.
+ */
+static gboolean
+expand_string (Reader *reader,
+               guint32 offset,
+               guint32 *string_offset,
+               guint32 *string_length,
+               gboolean *expanded,
+               GError **error)
+{
+        GByteArray *strings = reader->strings;
+        guint32 start = strings->len;
+        guint32 static_offset, segment_size, ref;
+        guint64 pos = (guint64) offset + sizeof (guint32);
+        const gchar *value;
+
+        *expanded = FALSE;
+
+        if (!read_word (reader, offset, &static_offset)) {
+                set_truncated_error (error);
+                return FALSE;
+        }
+
+        while (1) {
+                if (!read_word (reader, pos, &segment_size) ||
+                    !read_word (reader, pos + sizeof (guint32), &ref) ||
+                    (guint64) static_offset + segment_size > reader->length) {
+                        set_truncated_error (error);
+                        return FALSE;
+                }
+
+                pos += 2 * sizeof (guint32);
+
+                if ((guint64) strings->len + segment_size + SEGMENT_VALUE_SIZE > G_MAXUINT32) {
+                        g_set_error (error,
+                                     MO_FILE_ERROR,
+                                     MO_FILE_INVALID_FILE_ERROR,
+                                     "File's system dependent strings are too large.",
+                                     NULL);
+                        return FALSE;
+                }
+
+                g_byte_array_append (strings, reader->data + static_offset, segment_size);
+                static_offset += segment_size;
+
+                if (ref == SEGMENTS_END)
+                        break;
+
+                if (ref >= reader->n_segments) {
+                        g_set_error (error,
+                                     MO_FILE_ERROR,
+                                     MO_FILE_INVALID_FILE_ERROR,
+                                     "File contains an out of range system dependent segment.",
+                                     NULL);
+                        return FALSE;
+                }
+
+                if (!reader->segments[ref].known) {
+                        g_byte_array_set_size (strings, start);
+                        return TRUE;
+                }
+
+                value = reader->segments[ref].value;
+                g_byte_array_append (strings, (const guint8 *) value, strlen (value));
+        }
+
+        /* The last static part usually carries the terminating NUL */
+        if (strings->len > start && strings->data[strings->len - 1] == '\0')
+                g_byte_array_set_size (strings, strings->len - 1);
+
+        *string_offset = start;
+        *string_length = strings->len - start;
+        g_byte_array_append (strings, (const guint8 *) "", 1);
+
+        *expanded = TRUE;
+
+        return TRUE;
+}
+
+/*
+ * Read and expand the @n_strings system dependent strings of the file in
+ * @data, given the fields of its revision 1 header.
+ */
+MoSysdep *
+mo_sysdep_new (const guint8 *data,
+               gsize length,
+               gboolean swapped,
+               guint32 n_segments,
+               guint32 segments_offset,
+               guint32 n_strings,
+               guint32 orig_tab_offset,
+               guint32 trans_tab_offset,
+               GError **error)
+{
+        g_autofree Segment *segments = NULL;
+        Reader reader = { data, length, swapped, NULL, n_segments, NULL };
+        guint32 name_length, name_offset, orig_offset, trans_offset;
+        gboolean orig_expanded, trans_expanded;
+        guint32 strings_len;
+        MoSysdep *sysdep;
+        Entry entry;
+
+        if ((guint64) segments_offset + (guint64) n_segments * 2 * sizeof (guint32) > length ||
+            (guint64) orig_tab_offset + (guint64) n_strings * sizeof (guint32) > length ||
+            (guint64) trans_tab_offset + (guint64) n_strings * sizeof (guint32) > length) {
+                set_truncated_error (error);
+                return NULL;
+        }
+
+        segments = g_new0 (Segment, n_segments);
+
+        for (guint32 i = 0; i < n_segments; ++i) {
+                if (!read_word (&reader, (guint64) segments_offset + 8 * (guint64) i, &name_length) ||
+                    !read_word (&reader, (guint64) segments_offset + 8 * (guint64) i + 4, &name_offset) ||
+                    (guint64) name_offset + name_length > length) {
+                        set_truncated_error (error);
+                        return NULL;
+                }
+
+                /* The length normally counts the name's NUL */
+                if (name_length > 0 && data[name_offset + name_length - 1] == '\0')
+                        name_length--;
+
+                segments[i].known = get_segment_value ((const gchar *) data + name_offset,
+                                                       name_length,
+                                                       segments[i].value);
+        }
+
+        sysdep = g_new (MoSysdep, 1);
+        sysdep->entries = g_array_new (FALSE, FALSE, sizeof (Entry));
+        sysdep->strings = g_byte_array_new ();
+
+        reader.segments = segments;
+        reader.strings = sysdep->strings;
+
+        for (guint32 i = 0; i < n_strings; ++i) {
+                if (!read_word (&reader, (guint64) orig_tab_offset + 4 * (guint64) i, &orig_offset) ||
+                    !read_word (&reader, (guint64) trans_tab_offset + 4 * (guint64) i, &trans_offset)) {
+                        set_truncated_error (error);
+                        mo_sysdep_free (sysdep);
+                        return NULL;
+                }
+
+                strings_len = sysdep->strings->len;
+
+                if (!expand_string (&reader,
+                                    orig_offset,
+                                    &entry.orig_offset,
+                                    &entry.orig_length,
+                                    &orig_expanded,
+                                    error) ||
+                    !expand_string (&reader,
+                                    trans_offset,
+                                    &entry.trans_offset,
+                                    &entry.trans_length,
+                                    &trans_expanded,
+                                    error)) {
+                        mo_sysdep_free (sysdep);
+                        return NULL;
+                }
+
+                if (!orig_expanded || !trans_expanded) {
+                        g_byte_array_set_size (sysdep->strings, strings_len);
+                        continue;
+                }
+
+                g_array_append_val (sysdep->entries, entry);
+        }
+
+        return sysdep;
+}
+
+void
+mo_sysdep_free (MoSysdep *sysdep)
+{
+        if (!sysdep)
+                return;
+
+        g_array_unref (sysdep->entries);
+        g_byte_array_unref (sysdep->strings);
+        g_free (sysdep);
+}
+
+/*
+ * The number of strings which could be expanded for this platform.
+ */
+guint32
+mo_sysdep_get_n_strings (const MoSysdep *sysdep)
+{
+        return sysdep->entries->len;
+}
+
+const gchar *
+mo_sysdep_get_orig (const MoSysdep *sysdep, guint32 index, gsize *length)
+{
+        const Entry *entry;
+
+        g_return_val_if_fail (index < sysdep->entries->len, NULL);
+
+        entry = &g_array_index (sysdep->entries, Entry, index);
+
+        if (length)
+                *length = entry->orig_length;
+
+        return (const gchar *) sysdep->strings->data + entry->orig_offset;
+}
+
+const gchar *
+mo_sysdep_get_trans (const MoSysdep *sysdep, guint32 index, gsize *length)
+{
+        const Entry *entry;
+
+        g_return_val_if_fail (index < sysdep->entries->len, NULL);
+
+        entry = &g_array_index (sysdep->entries, Entry, index);
+
+        if (length)
+                *length = entry->trans_length;
+
+        return (const gchar *) sysdep->strings->data + entry->trans_offset;
+}
@@ -0,0 +1,59 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#if !defined(MO_COMPILATION)
+#error "mosysdep.h is private to libmo"
+#endif
+
+G_BEGIN_DECLS
+
+typedef struct _MoSysdep MoSysdep;
+
+G_GNUC_INTERNAL
+MoSysdep *mo_sysdep_new (const guint8 *data,
+                         gsize length,
+                         gboolean swapped,
+                         guint32 n_segments,
+                         guint32 segments_offset,
+                         guint32 n_strings,
+                         guint32 orig_tab_offset,
+                         guint32 trans_tab_offset,
+                         GError **error);
+G_GNUC_INTERNAL
+void mo_sysdep_free (MoSysdep *sysdep);
+
+G_GNUC_INTERNAL
+guint32 mo_sysdep_get_n_strings (const MoSysdep *sysdep);
+G_GNUC_INTERNAL
+const gchar *mo_sysdep_get_orig (const MoSysdep *sysdep,
+                                 guint32 index,
+                                 gsize *length);
+G_GNUC_INTERNAL
+const gchar *mo_sysdep_get_trans (const MoSysdep *sysdep,
+                                  guint32 index,
+                                  gsize *length);
+
+G_END_DECLS
@@ -0,0 +1,169 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "moview.h"
+#include "moview-private.h"
+
+/**
+ * SECTION:moview
+ * @short_description: Tables of borrowed strings.
+ * @title: MoView
+ * @stability: unstable
+ * @include: libmo/mo.h
+ *
+ * A #MoView is a string keyed #GHashTable whose keys and values are
+ * borrowed from a #MoFile or #MoGroup, together with a reference on that
+ * object which keeps them valid for as long as the view is alive. Building
+ * one copies nothing but the table itself, which makes it much cheaper than
+ * mo_file_get_translations() for a large file.
+ *
+ * The table, from mo_view_get_table(), belongs to the view and must not be
+ * modified.
+ */
+
+struct _MoView {
+        gint ref_count;
+        GObject *owner;
+        GHashTable *table;
+};
+
+G_DEFINE_BOXED_TYPE (MoView, mo_view, mo_view_ref, mo_view_unref)
+
+/*
+ * Create an empty view of strings borrowed from @owner. Its values are freed
+ * with @value_destroy_func, which may be NULL if they are borrowed too.
+ */
+MoView *
+mo_view_new (GObject *owner, GDestroyNotify value_destroy_func)
+{
+        MoView *view = g_new (MoView, 1);
+
+        view->ref_count = 1;
+        view->owner = g_object_ref (owner);
+        view->table = g_hash_table_new_full (g_str_hash,
+                                             g_str_equal,
+                                             NULL,
+                                             value_destroy_func);
+
+        return view;
+}
+
+/*
+ * Add @key, which is borrowed from the view's owner, to @view. A repeated
+ * key replaces the value, as g_hash_table_insert() does.
+ */
+void
+mo_view_insert (MoView *view, const gchar *key, gpointer value)
+{
+        g_hash_table_insert (view->table, (gpointer) key, value);
+}
+
+/**
+ * mo_view_ref:
+ * @view: A #MoView.
+ *
+ * Take a reference on @view.
+ *
+ * Returns: (transfer full): @view.
+ */
+MoView *
+mo_view_ref (MoView *view)
+{
+        g_return_val_if_fail (view != NULL, NULL);
+
+        g_atomic_int_inc (&view->ref_count);
+
+        return view;
+}
+
+/**
+ * mo_view_unref:
+ * @view: (transfer full): A #MoView.
+ *
+ * Drop a reference on @view. Once the last one has gone, the view is freed,
+ * and with it the reference it holds on the object its strings are
+ * borrowed from.
+ */
+void
+mo_view_unref (MoView *view)
+{
+        g_return_if_fail (view != NULL);
+
+        if (!g_atomic_int_dec_and_test (&view->ref_count))
+                return;
+
+        g_hash_table_unref (view->table);
+        g_object_unref (view->owner);
+        g_free (view);
+}
+
+/**
+ * mo_view_get_table:
+ * @view: A #MoView.
+ *
+ * Get the table of @view. Its strings are valid for as long as @view is
+ * alive.
+ *
+ * Returns: (transfer none): The table, which must not be modified.
+ */
+GHashTable *
+mo_view_get_table (MoView *view)
+{
+        g_return_val_if_fail (view != NULL, NULL);
+
+        return view->table;
+}
+
+/**
+ * mo_view_get_size:
+ * @view: A #MoView.
+ *
+ * Get the number of entries in @view.
+ *
+ * Returns: The number of entries.
+ */
+guint
+mo_view_get_size (MoView *view)
+{
+        g_return_val_if_fail (view != NULL, 0);
+
+        return g_hash_table_size (view->table);
+}
+
+/**
+ * mo_view_lookup:
+ * @view: A #MoView.
+ * @key: The key to look up.
+ *
+ * Look @key up in @view.
+ *
+ * Returns: (transfer none) (nullable): The value for @key, valid for as
+ * long as @view is alive, or %NULL if it has none.
+ */
+gpointer
+mo_view_lookup (MoView *view, const gchar *key)
+{
+        g_return_val_if_fail (view != NULL, NULL);
+        g_return_val_if_fail (key != NULL, NULL);
+
+        return g_hash_table_lookup (view->table, key);
+}
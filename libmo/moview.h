@@ -0,0 +1,60 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+#if !(defined(_IN_MO_H) || defined(MO_COMPILATION))
+#error "moview.h must not be included individually, include mo.h instead"
+#endif
+
+G_BEGIN_DECLS
+
+/**
+ * MO_TYPE_VIEW:
+ *
+ * #GType for #MoView.
+ */
+#define MO_TYPE_VIEW (mo_view_get_type ())
+
+/**
+ * MoView:
+ *
+ * A table of strings borrowed from a #MoFile or #MoGroup, as returned by
+ * mo_file_get_translations_view() and mo_group_get_translations_view(). All
+ * of its fields are private.
+ */
+typedef struct _MoView MoView;
+
+GType mo_view_get_type (void) G_GNUC_CONST;
+
+MoView *mo_view_ref (MoView *view);
+void mo_view_unref (MoView *view);
+
+GHashTable *mo_view_get_table (MoView *view);
+guint mo_view_get_size (MoView *view);
+gpointer mo_view_lookup (MoView *view, const gchar *key);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (MoView, mo_view_unref)
+
+G_END_DECLS
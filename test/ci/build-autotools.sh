@@ -12,6 +12,7 @@ list_output_dir () {
 NOCONFIGURE=1 ./autogen.sh
 ./configure --disable-silent-rules --enable-werror CC=${CC} --prefix=${HOME}/test
 make
+make check
 make install
 list_output_dir
 example/sample-query
@@ -13,6 +13,7 @@ mkdir build
 cd build
 CC=${CC} meson --prefix=${HOME}/test ..
 ninja
+ninja test
 ninja install
 list_output_dir
 ./sample-query
@@ -0,0 +1,238 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "mo-test-util.h"
+
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MO_MAGIC 0x950412de
+#define HEADER_SIZE 28
+
+static gint
+compare_entries (gconstpointer a, gconstpointer b)
+{
+        const MoTestEntry *entry_a = a;
+        const MoTestEntry *entry_b = b;
+
+        /* As msgfmt does, which only looks at the singular msgid */
+        return strcmp (entry_a->msgid, entry_b->msgid);
+}
+
+static guint32
+hashpjw (const gchar *str)
+{
+        guint32 hval = 0, g;
+
+        for (; *str; ++str) {
+                hval = (hval << 4) + (guchar) *str;
+                g = hval & ((guint32) 0xf << 28);
+
+                if (g != 0) {
+                        hval ^= g >> 24;
+                        hval ^= g;
+                }
+        }
+
+        return hval;
+}
+
+static gboolean
+is_prime (guint32 n)
+{
+        if (n < 2)
+                return FALSE;
+
+        for (guint32 i = 2; i * i <= n; ++i) {
+                if (n % i == 0)
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+static void
+put_u32 (GByteArray *data, gsize offset, guint32 value)
+{
+        memcpy (data->data + offset, &value, sizeof (value));
+}
+
+/* Append @length bytes of @str and its NUL, returning where they went */
+static guint32
+append_string (GByteArray *data, const gchar *str, gsize length)
+{
+        guint32 offset = data->len;
+
+        g_byte_array_append (data, (const guint8 *) str, length);
+        g_byte_array_append (data, (const guint8 *) "", 1);
+
+        return offset;
+}
+
+/*
+ * Build a .mo file, in the machine's byte order, holding @entries, with a
+ * hash table like the one msgfmt writes if @hash_table is set.
+ */
+GBytes *
+mo_test_build (const MoTestEntry *entries,
+               guint n_entries,
+               gboolean hash_table)
+{
+        g_autofree MoTestEntry *sorted = NULL;
+        GByteArray *data;
+        guint32 orig_tab, trans_tab, hash_tab, hash_size = 0;
+        guint32 offset, hval, idx, incr;
+
+        sorted = g_new (MoTestEntry, n_entries);
+        memcpy (sorted, entries, n_entries * sizeof (MoTestEntry));
+        qsort (sorted, n_entries, sizeof (MoTestEntry), compare_entries);
+
+        if (hash_table) {
+                hash_size = MAX (3, n_entries * 4 / 3);
+
+                while (!is_prime (hash_size))
+                        hash_size++;
+        }
+
+        orig_tab = HEADER_SIZE;
+        trans_tab = orig_tab + n_entries * 8;
+        hash_tab = trans_tab + n_entries * 8;
+
+        data = g_byte_array_new ();
+        g_byte_array_set_size (data, hash_tab + hash_size * 4);
+        memset (data->data, 0, data->len);
+
+        put_u32 (data, 0, MO_MAGIC);
+        put_u32 (data, 4, 0);
+        put_u32 (data, 8, n_entries);
+        put_u32 (data, 12, orig_tab);
+        put_u32 (data, 16, trans_tab);
+        put_u32 (data, 20, hash_size);
+        put_u32 (data, 24, hash_tab);
+
+        for (guint i = 0; i < n_entries; ++i) {
+                offset = append_string (data, sorted[i].msgid, sorted[i].msgid_length);
+                put_u32 (data, orig_tab + i * 8, sorted[i].msgid_length);
+                put_u32 (data, orig_tab + i * 8 + 4, offset);
+
+                offset = append_string (data, sorted[i].msgstr, sorted[i].msgstr_length);
+                put_u32 (data, trans_tab + i * 8, sorted[i].msgstr_length);
+                put_u32 (data, trans_tab + i * 8 + 4, offset);
+
+                if (!hash_size)
+                        continue;
+
+                hval = hashpjw (sorted[i].msgid);
+                idx = hval % hash_size;
+                incr = 1 + hval % (hash_size - 2);
+
+                while (data->data[hash_tab + idx * 4] ||
+                       data->data[hash_tab + idx * 4 + 1] ||
+                       data->data[hash_tab + idx * 4 + 2] ||
+                       data->data[hash_tab + idx * 4 + 3])
+                        idx = idx >= hash_size - incr ? idx - (hash_size - incr)
+                                                      : idx + incr;
+
+                put_u32 (data, hash_tab + idx * 4, i + 1);
+        }
+
+        return g_byte_array_free_to_bytes (data);
+}
+
+/*
+ * Build a .mo file, as mo_test_build() does, and load it.
+ */
+MoFile *
+mo_test_file_new (const MoTestEntry *entries,
+                  guint n_entries,
+                  gboolean hash_table)
+{
+        GError *error = NULL;
+        GBytes *bytes;
+        MoFile *mofile;
+
+        bytes = mo_test_build (entries, n_entries, hash_table);
+        mofile = mo_file_new_from_bytes (bytes, &error);
+        g_assert_no_error (error);
+
+        /* The file borrows the bytes rather than taking a reference */
+        g_object_set_data_full (G_OBJECT (mofile),
+                                "mo-test-bytes",
+                                bytes,
+                                (GDestroyNotify) g_bytes_unref);
+
+        return mofile;
+}
+
+/*
+ * Write @bytes as the file of @locale for @domain under @directory,
+ * returning its name.
+ */
+gchar *
+mo_test_write_locale (const gchar *directory,
+                      const gchar *locale,
+                      const gchar *domain,
+                      GBytes *bytes)
+{
+        g_autofree gchar *messages = NULL;
+        g_autofree gchar *basename = NULL;
+        GError *error = NULL;
+        gchar *filename;
+        gconstpointer data;
+        gsize length;
+
+        messages = g_build_filename (directory, locale, "LC_MESSAGES", NULL);
+        g_assert_cmpint (g_mkdir_with_parents (messages, 0755), ==, 0);
+
+        basename = g_strdup_printf ("%s.mo", domain);
+        filename = g_build_filename (messages, basename, NULL);
+
+        data = g_bytes_get_data (bytes, &length);
+        g_file_set_contents (filename, data, length, &error);
+        g_assert_no_error (error);
+
+        return filename;
+}
+
+/*
+ * Remove @path and, if it is a directory, everything in it.
+ */
+void
+mo_test_remove_tree (const gchar *path)
+{
+        g_autoptr(GDir) dir = NULL;
+        const gchar *name;
+
+        if (g_file_test (path, G_FILE_TEST_IS_DIR) &&
+            !g_file_test (path, G_FILE_TEST_IS_SYMLINK)) {
+                dir = g_dir_open (path, 0, NULL);
+
+                while (dir && (name = g_dir_read_name (dir))) {
+                        g_autofree gchar *child = g_build_filename (path, name, NULL);
+
+                        mo_test_remove_tree (child);
+                }
+        }
+
+        g_remove (path);
+}
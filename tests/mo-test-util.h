@@ -0,0 +1,59 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <libmo/mo.h>
+
+G_BEGIN_DECLS
+
+/*
+ * One entry of a .mo file built by mo_test_build(). Both strings may contain
+ * NULs, to give an entry plural forms, so their lengths are explicit.
+ */
+typedef struct {
+        const gchar *msgid;
+        gsize msgid_length;
+        const gchar *msgstr;
+        gsize msgstr_length;
+} MoTestEntry;
+
+#define MO_TEST_ENTRY(msgid, msgstr) \
+        { (msgid), sizeof (msgid) - 1, (msgstr), sizeof (msgstr) - 1 }
+
+#define MO_TEST_HEADER \
+        MO_TEST_ENTRY ("", "Content-Type: text/plain; charset=UTF-8\n" \
+                           "Plural-Forms: nplurals=2; plural=(n != 1);\n")
+
+GBytes *mo_test_build (const MoTestEntry *entries,
+                       guint n_entries,
+                       gboolean hash_table);
+MoFile *mo_test_file_new (const MoTestEntry *entries,
+                          guint n_entries,
+                          gboolean hash_table);
+gchar *mo_test_write_locale (const gchar *directory,
+                             const gchar *locale,
+                             const gchar *domain,
+                             GBytes *bytes);
+void mo_test_remove_tree (const gchar *path);
+
+G_END_DECLS
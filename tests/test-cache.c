@@ -0,0 +1,172 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "libmo/mocache.h"
+#include "libmo/mofile-private.h"
+
+#include <string.h>
+
+/*
+ * The cache is internal to libmo, so this is built with its sources rather
+ * than linked against the library.
+ */
+
+/* Every shard gets this many slots from a budget of N_SLOTS * 16 */
+#define N_SLOTS 4
+
+static const gchar *keys[] = { "zero", "one", "two", "three", "four" };
+static const gchar *values[] = { "null", "eins", "zwei", "drei", "vier" };
+
+static gboolean
+is_cached (MoCache *cache, const gchar *key, guint32 hash, const gchar **value)
+{
+        const gchar *dummy;
+
+        return mo_cache_lookup (cache, key, hash, value ? value : &dummy);
+}
+
+static void
+test_eviction (void)
+{
+        MoCache *cache = mo_cache_new (N_SLOTS * 16, 0);
+        const gchar *value;
+
+        /* With the same hash, these all go to one shard, which they fill */
+        for (guint i = 0; i < N_SLOTS; ++i)
+                mo_cache_insert (cache, keys[i], 0, values[i]);
+
+        for (guint i = 0; i < N_SLOTS; ++i) {
+                g_assert_true (is_cached (cache, keys[i], 0, &value));
+                g_assert_cmpstr (value, ==, values[i]);
+        }
+
+        /* Every entry has now been used, so the clock hand goes all the way
+         * round, clearing their reference bits, and takes the first one */
+        mo_cache_insert (cache, keys[4], 0, values[4]);
+        g_assert_false (is_cached (cache, keys[0], 0, NULL));
+        g_assert_true (is_cached (cache, keys[4], 0, &value));
+        g_assert_cmpstr (value, ==, values[4]);
+
+        /* The hand now passes over the second, which has been used since */
+        g_assert_true (is_cached (cache, keys[1], 0, NULL));
+        mo_cache_insert (cache, keys[0], 0, values[0]);
+        g_assert_true (is_cached (cache, keys[1], 0, NULL));
+        g_assert_false (is_cached (cache, keys[2], 0, NULL));
+        g_assert_true (is_cached (cache, keys[0], 0, NULL));
+
+        mo_cache_clear (cache);
+
+        for (guint i = 0; i < G_N_ELEMENTS (keys); ++i)
+                g_assert_false (is_cached (cache, keys[i], 0, NULL));
+
+        mo_cache_free (cache);
+}
+
+static void
+test_negative (void)
+{
+        MoCache *cache = mo_cache_new (N_SLOTS * 16, 16);
+        g_autofree gchar *miss = NULL;
+        const gchar *value;
+
+        for (guint i = 0; i < N_SLOTS; ++i)
+                mo_cache_insert (cache, keys[i], 0, values[i]);
+
+        /* A miss is remembered as one */
+        mo_cache_insert (cache, "nothing", 0, NULL);
+        g_assert_true (is_cached (cache, "nothing", 0, &value));
+        g_assert_null (value);
+
+        /* and a flood of them doesn't push out what was found */
+        for (guint i = 0; i < 100; ++i) {
+                g_free (miss);
+                miss = g_strdup_printf ("miss %u", i);
+                mo_cache_insert (cache, miss, 0, NULL);
+        }
+
+        for (guint i = 0; i < N_SLOTS; ++i)
+                g_assert_true (is_cached (cache, keys[i], 0, NULL));
+
+        /* The shard has room for one miss */
+        g_assert_true (is_cached (cache, miss, 0, NULL));
+        g_assert_false (is_cached (cache, "nothing", 0, NULL));
+
+        mo_cache_free (cache);
+
+        /* Without a budget for them, misses aren't cached at all */
+        cache = mo_cache_new (N_SLOTS * 16, 0);
+        mo_cache_insert (cache, "nothing", 0, NULL);
+        g_assert_false (is_cached (cache, "nothing", 0, NULL));
+        mo_cache_free (cache);
+
+        g_assert_null (mo_cache_new (0, 0));
+        g_assert_false (is_cached (NULL, "nothing", 0, NULL));
+}
+
+static void
+test_shards (void)
+{
+        MoCache *cache = mo_cache_new (16, 0);
+        g_autofree gchar *key = NULL;
+        guint n_cached = 0;
+        gsize size, used;
+
+        /* Strings ending in the same character have hashpjw values with the
+         * same low bits, but should still be spread between the shards,
+         * which have one slot each */
+        for (guint i = 0; i < 16; ++i) {
+                g_free (key);
+                key = g_strdup_printf ("Message %u.", i);
+                mo_cache_insert (cache, key, hashpjw (key, strlen (key)), values[0]);
+        }
+
+        for (guint i = 0; i < 16; ++i) {
+                g_free (key);
+                key = g_strdup_printf ("Message %u.", i);
+
+                if (is_cached (cache, key, hashpjw (key, strlen (key)), NULL))
+                        n_cached++;
+        }
+
+        g_assert_cmpuint (n_cached, >, 4);
+
+        mo_cache_get_memory_usage (cache, &size, &used);
+        g_assert_cmpuint (used, >, 0);
+
+        mo_cache_clear (cache);
+        mo_cache_get_memory_usage (cache, &size, &used);
+        g_assert_cmpuint (used, ==, 0);
+
+        mo_cache_free (cache);
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/cache/eviction", test_eviction);
+        g_test_add_func ("/cache/negative", test_negative);
+        g_test_add_func ("/cache/shards", test_shards);
+
+        return g_test_run ();
+}
@@ -0,0 +1,743 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "mo-test-util.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+static const MoTestEntry entries[] = {
+        MO_TEST_HEADER,
+        MO_TEST_ENTRY ("Open", "Öffnen"),
+        MO_TEST_ENTRY ("Close", "Schließen"),
+        MO_TEST_ENTRY ("menu\004Open", "Öffnen…"),
+        MO_TEST_ENTRY ("%d file\0%d files", "%d Datei\0%d Dateien"),
+        MO_TEST_ENTRY ("Save", "Speichern"),
+        MO_TEST_ENTRY ("Save as", "Speichern unter"),
+};
+
+#define N_ENTRIES G_N_ELEMENTS (entries)
+
+static void
+check_lookups (MoFile *mofile)
+{
+        g_autofree gchar *copy = NULL;
+        const gchar *translation;
+        gsize length;
+
+        translation = mo_file_lookup_translation (mofile, "Open", &length);
+        g_assert_cmpstr (translation, ==, "Öffnen");
+        g_assert_cmpuint (length, ==, strlen ("Öffnen"));
+
+        translation = mo_file_lookup_translation_len (mofile, "Save as", 4, NULL);
+        g_assert_cmpstr (translation, ==, "Speichern");
+
+        g_assert_null (mo_file_lookup_translation (mofile, "Quit", NULL));
+        g_assert_null (mo_file_lookup_translation (mofile, "Ope", NULL));
+
+        copy = mo_file_get_translation (mofile, "Close", NULL);
+        g_assert_cmpstr (copy, ==, "Schließen");
+
+        translation = mo_file_lookup_translation_with_context (mofile,
+                                                               "menu",
+                                                               "Open",
+                                                               NULL);
+        g_assert_cmpstr (translation, ==, "Öffnen…");
+        g_assert_null (mo_file_lookup_translation_with_context (mofile,
+                                                                "toolbar",
+                                                                "Open",
+                                                                NULL));
+
+        translation = mo_file_lookup_plural (mofile, "%d file", "%d files", 1, NULL);
+        g_assert_cmpstr (translation, ==, "%d Datei");
+        translation = mo_file_lookup_plural (mofile, "%d file", "%d files", 5, &length);
+        g_assert_cmpstr (translation, ==, "%d Dateien");
+        g_assert_cmpuint (length, ==, strlen ("%d Dateien"));
+
+        /* An untranslated string falls back to the English rule */
+        translation = mo_file_lookup_plural (mofile, "%d dir", "%d dirs", 1, NULL);
+        g_assert_cmpstr (translation, ==, "%d dir");
+        translation = mo_file_lookup_plural (mofile, "%d dir", "%d dirs", 0, NULL);
+        g_assert_cmpstr (translation, ==, "%d dirs");
+}
+
+static void
+check_batch (MoFile *mofile)
+{
+        const gchar *strs[] = { "Save", "Quit", "Close", "Open" };
+        const gchar *translations[G_N_ELEMENTS (strs)];
+        gsize lengths[G_N_ELEMENTS (strs)];
+        g_autoptr(MoKey) key = NULL;
+        guint n_found;
+
+        n_found = mo_file_lookup_translations (mofile,
+                                               strs,
+                                               G_N_ELEMENTS (strs),
+                                               translations,
+                                               lengths);
+        g_assert_cmpuint (n_found, ==, 3);
+        g_assert_cmpstr (translations[0], ==, "Speichern");
+        g_assert_null (translations[1]);
+        g_assert_cmpstr (translations[2], ==, "Schließen");
+        g_assert_cmpstr (translations[3], ==, "Öffnen");
+        g_assert_cmpuint (lengths[3], ==, strlen ("Öffnen"));
+
+        key = mo_key_new ("Save as");
+        g_assert_cmpstr (mo_file_lookup_key (mofile, key, NULL), ==, "Speichern unter");
+}
+
+static void
+test_lookup (void)
+{
+        g_autoptr(MoFile) mofile = mo_test_file_new (entries, N_ENTRIES, TRUE);
+
+        check_lookups (mofile);
+        check_batch (mofile);
+}
+
+static void
+test_lookup_no_hash_table (void)
+{
+        g_autoptr(MoFile) mofile = mo_test_file_new (entries, N_ENTRIES, FALSE);
+
+        check_lookups (mofile);
+        check_batch (mofile);
+}
+
+static void
+test_lookup_index (void)
+{
+        g_autoptr(GBytes) bytes = mo_test_build (entries, N_ENTRIES, FALSE);
+        g_autoptr(MoFile) mofile = NULL;
+        GError *error = NULL;
+        MoFileStats stats;
+
+        mofile = g_initable_new (MO_TYPE_FILE,
+                                 NULL,
+                                 &error,
+                                 "bytes", bytes,
+                                 "build-index", TRUE,
+                                 "validate", TRUE,
+                                 NULL);
+        g_assert_no_error (error);
+
+        check_lookups (mofile);
+        check_batch (mofile);
+
+        mo_file_get_stats (mofile, &stats);
+        g_assert_cmpuint (stats.n_strings, ==, N_ENTRIES);
+        g_assert_cmpuint (stats.index_size, >, 0);
+}
+
+static MoFile *
+new_validated_file (GBytes *bytes, GError **error)
+{
+        return g_initable_new (MO_TYPE_FILE,
+                               NULL,
+                               error,
+                               "bytes", bytes,
+                               "validate", TRUE,
+                               NULL);
+}
+
+/*
+ * A copy of @bytes, with the 32-bit word at @offset set to @value.
+ */
+static GBytes *
+set_word (GBytes *bytes, gsize offset, guint32 value)
+{
+        GByteArray *data = g_byte_array_new ();
+        gsize size;
+        const guint8 *old = g_bytes_get_data (bytes, &size);
+
+        g_byte_array_append (data, old, size);
+        memcpy (data->data + offset, &value, sizeof (value));
+
+        return g_byte_array_free_to_bytes (data);
+}
+
+/*
+ * A copy of @bytes, as built by mo_test_build(), in the other byte order.
+ */
+static GBytes *
+swap_file (GBytes *bytes)
+{
+        GByteArray *data = g_byte_array_new ();
+        const guint8 *old;
+        guint32 n_strings, hash_size, word;
+        gsize size, n_words;
+
+        old = g_bytes_get_data (bytes, &size);
+        g_byte_array_append (data, old, size);
+
+        memcpy (&n_strings, old + 8, sizeof (guint32));
+        memcpy (&hash_size, old + 20, sizeof (guint32));
+
+        /* The header, both string tables and the hash table are contiguous */
+        n_words = 7 + 4 * (gsize) n_strings + hash_size;
+
+        for (gsize i = 0; i < n_words; ++i) {
+                memcpy (&word, data->data + 4 * i, sizeof (word));
+                word = GUINT32_SWAP_LE_BE (word);
+                memcpy (data->data + 4 * i, &word, sizeof (word));
+        }
+
+        return g_byte_array_free_to_bytes (data);
+}
+
+static void
+test_swapped (void)
+{
+        g_autoptr(GBytes) bytes = mo_test_build (entries, N_ENTRIES, TRUE);
+        g_autoptr(GBytes) swapped = swap_file (bytes);
+        g_autoptr(MoFile) mofile = NULL;
+        GError *error = NULL;
+
+        mofile = mo_file_new_from_bytes (swapped, &error);
+        g_assert_no_error (error);
+        check_lookups (mofile);
+        check_batch (mofile);
+        g_clear_object (&mofile);
+
+        mofile = new_validated_file (swapped, &error);
+        g_assert_no_error (error);
+        check_lookups (mofile);
+        check_batch (mofile);
+}
+
+static void
+check_invalid (GBytes *bytes)
+{
+        g_autoptr(MoFile) mofile = NULL;
+        GError *error = NULL;
+
+        mofile = new_validated_file (bytes, &error);
+        g_assert_error (error, MO_FILE_ERROR, MO_FILE_INVALID_FILE_ERROR);
+        g_assert_null (mofile);
+        g_clear_error (&error);
+}
+
+static void
+test_validate (void)
+{
+        g_autoptr(GBytes) bytes = mo_test_build (entries, N_ENTRIES, TRUE);
+        g_autoptr(GBytes) sorted = mo_test_build (entries, N_ENTRIES, FALSE);
+        g_autoptr(GBytes) header = NULL;
+        g_autoptr(GBytes) unsorted = NULL;
+        g_autoptr(GBytes) invalid = NULL;
+        const guint8 *data = g_bytes_get_data (bytes, NULL);
+        gsize orig_tab = 28, hash_tab = 28 + 16 * N_ENTRIES;
+        guint32 length, open_offset, save_offset;
+
+        /* In order, the strings are "", "%d file", "Close", "Open", "Save",
+         * ... */
+        memcpy (&length, data + orig_tab + 8, sizeof (guint32));
+        data = g_bytes_get_data (sorted, NULL);
+        memcpy (&open_offset, data + orig_tab + 3 * 8 + 4, sizeof (guint32));
+        memcpy (&save_offset, data + orig_tab + 4 * 8 + 4, sizeof (guint32));
+
+        /* The header alone, claiming far more strings than it has */
+        header = g_bytes_new_from_bytes (bytes, 0, 28);
+        invalid = set_word (header, 8, G_MAXUINT32);
+        check_invalid (invalid);
+        g_clear_pointer (&invalid, g_bytes_unref);
+
+        /* Each of the tables running off the end */
+        for (gsize field = 12; field <= 24; field += 4) {
+                invalid = set_word (bytes, field, g_bytes_get_size (bytes) - 4);
+                check_invalid (invalid);
+                g_clear_pointer (&invalid, g_bytes_unref);
+        }
+
+        /* A string running off the end */
+        invalid = set_word (bytes, orig_tab + 8, G_MAXUINT32 - 1);
+        check_invalid (invalid);
+        g_clear_pointer (&invalid, g_bytes_unref);
+
+        /* or not ending with a NUL */
+        invalid = set_word (bytes, orig_tab + 8, length - 1);
+        check_invalid (invalid);
+        g_clear_pointer (&invalid, g_bytes_unref);
+
+        /* A hash table entry for a string which isn't there */
+        invalid = set_word (bytes, hash_tab, N_ENTRIES + 1);
+        check_invalid (invalid);
+        g_clear_pointer (&invalid, g_bytes_unref);
+
+        /* A hash table which is too small to probe */
+        invalid = set_word (bytes, 20, 2);
+        check_invalid (invalid);
+        g_clear_pointer (&invalid, g_bytes_unref);
+
+        /* Without a hash table, strings which aren't sorted */
+        unsorted = set_word (sorted, orig_tab + 3 * 8 + 4, save_offset);
+        invalid = set_word (unsorted, orig_tab + 4 * 8 + 4, open_offset);
+        check_invalid (invalid);
+        g_clear_pointer (&invalid, g_bytes_unref);
+
+        invalid = set_word (bytes, 0, 0x12345678);
+        check_invalid (invalid);
+}
+
+static void
+test_metadata (void)
+{
+        g_autoptr(MoFile) mofile = mo_test_file_new (entries, N_ENTRIES, TRUE);
+
+        g_assert_cmpstr (mo_file_get_charset (mofile), ==, "UTF-8");
+        g_assert_cmpuint (mo_file_get_n_plurals (mofile), ==, 2);
+        g_assert_cmpstr (mo_file_get_header_value (mofile, "Content-Type"),
+                         ==,
+                         "text/plain; charset=UTF-8");
+        g_assert_null (mo_file_get_header_value (mofile, "Language-Team"));
+}
+
+static void
+test_iter (void)
+{
+        g_autoptr(MoFile) mofile = mo_test_file_new (entries, N_ENTRIES, TRUE);
+        const gchar *form;
+        MoFileIter iter;
+        MoEntry entry;
+        gboolean seen_plural = FALSE, seen_context = FALSE;
+        guint n = 0;
+        gsize length;
+
+        g_assert_cmpuint (mo_file_get_n_entries (mofile), ==, N_ENTRIES);
+
+        mo_file_iter_init (&iter, mofile);
+
+        while (mo_file_iter_next (&iter, &entry, NULL)) {
+                g_assert_cmpuint (entry.index, ==, n);
+                n++;
+
+                if (entry.msgid_plural) {
+                        g_assert_cmpstr (entry.msgid, ==, "%d file");
+                        g_assert_cmpstr (entry.msgid_plural, ==, "%d files");
+                        g_assert_cmpuint (entry.n_translations, ==, 2);
+
+                        form = mo_entry_get_plural_form (&entry, 1, &length);
+                        g_assert_cmpstr (form, ==, "%d Dateien");
+                        g_assert_cmpuint (length, ==, strlen ("%d Dateien"));
+                        g_assert_null (mo_entry_get_plural_form (&entry, 2, NULL));
+                        seen_plural = TRUE;
+                }
+
+                if (entry.context) {
+                        g_assert_cmpmem (entry.context, entry.context_length, "menu", 4);
+                        g_assert_cmpstr (entry.msgid, ==, "Open");
+                        seen_context = TRUE;
+                }
+        }
+
+        g_assert_cmpuint (n, ==, N_ENTRIES);
+        g_assert_true (seen_plural);
+        g_assert_true (seen_context);
+
+        /* A range stops where it is told to */
+        mo_file_iter_init_range (&iter, mofile, 2, 4);
+        n = 0;
+
+        while (mo_file_iter_next (&iter, &entry, NULL))
+                g_assert_cmpuint (entry.index, ==, 2 + n++);
+
+        g_assert_cmpuint (n, ==, 2);
+
+        g_assert_false (mo_file_get_entry (mofile, N_ENTRIES, &entry, NULL));
+}
+
+static void
+test_view (void)
+{
+        g_autoptr(MoFile) mofile = mo_test_file_new (entries, N_ENTRIES, TRUE);
+        g_autoptr(MoView) view = NULL;
+        GError *error = NULL;
+
+        view = mo_file_get_translations_view (mofile, &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (mo_view_get_size (view), ==, N_ENTRIES);
+        g_assert_cmpstr (mo_view_lookup (view, "Save"), ==, "Speichern");
+        g_assert_null (mo_view_lookup (view, "Quit"));
+
+        /* The view keeps the file alive */
+        g_clear_object (&mofile);
+        g_assert_cmpstr (mo_view_lookup (view, "Close"), ==, "Schließen");
+}
+
+static void
+test_search (void)
+{
+        g_autoptr(MoFile) mofile = mo_test_file_new (entries, N_ENTRIES, TRUE);
+        g_autoptr(GArray) matches = NULL;
+        MoEntry entry;
+
+        matches = mo_file_search (mofile, "Speich", 0, MO_SEARCH_TRANSLATIONS);
+        g_assert_cmpuint (matches->len, ==, 2);
+        g_clear_pointer (&matches, g_array_unref);
+
+        /* The same, with and without the index */
+        g_assert_true (mo_file_build_search_index (mofile, 0, 0));
+
+        matches = mo_file_search (mofile, "Speich", 0, MO_SEARCH_TRANSLATIONS);
+        g_assert_cmpuint (matches->len, ==, 2);
+        g_clear_pointer (&matches, g_array_unref);
+
+        /* One substitution away */
+        matches = mo_file_search (mofile, "Schliessen", 2, MO_SEARCH_TRANSLATIONS);
+        g_assert_cmpuint (matches->len, ==, 1);
+        g_assert_true (mo_file_get_entry (mofile,
+                                          g_array_index (matches, guint, 0),
+                                          &entry,
+                                          NULL));
+        g_assert_cmpstr (entry.msgid, ==, "Close");
+        g_clear_pointer (&matches, g_array_unref);
+
+        matches = mo_file_search (mofile,
+                                  "SAVE",
+                                  0,
+                                  MO_SEARCH_ORIGINALS | MO_SEARCH_CASE_INSENSITIVE);
+        g_assert_cmpuint (matches->len, ==, 2);
+}
+
+static void
+test_lookup_originals (void)
+{
+        const MoTestEntry reverse_entries[] = {
+                MO_TEST_HEADER,
+                MO_TEST_ENTRY ("a document", "Datei"),
+                MO_TEST_ENTRY ("file\0files", "Datei\0Dateien"),
+                MO_TEST_ENTRY ("some files", "Dateien"),
+                MO_TEST_ENTRY ("the document", "Datei"),
+        };
+        g_autoptr(MoFile) mofile = NULL;
+        MoEntry found[4];
+
+        mofile = mo_test_file_new (reverse_entries,
+                                   G_N_ELEMENTS (reverse_entries),
+                                   TRUE);
+
+        /* "file" is on both chains, and mustn't join them together */
+        g_assert_cmpuint (mo_file_lookup_originals (mofile, "Datei", found, 4), ==, 3);
+        g_assert_cmpstr (found[0].msgid, ==, "a document");
+        g_assert_cmpstr (found[1].msgid, ==, "file");
+        g_assert_cmpstr (found[2].msgid, ==, "the document");
+
+        g_assert_cmpuint (mo_file_lookup_originals (mofile, "Dateien", found, 4), ==, 2);
+        g_assert_cmpstr (found[0].msgid, ==, "file");
+        g_assert_cmpstr (found[1].msgid, ==, "some files");
+
+        /* Only as many as there is room for are filled in */
+        g_assert_cmpuint (mo_file_lookup_originals (mofile, "Datei", found, 1), ==, 3);
+        g_assert_cmpuint (mo_file_lookup_originals (mofile, "Dokument", NULL, 0), ==, 0);
+        g_assert_cmpuint (mo_file_lookup_originals (mofile, "", NULL, 0), ==, 0);
+}
+
+/*
+ * Load a file whose header has @plural_forms as its Plural-Forms field, and
+ * one entry with three plural forms.
+ */
+static MoFile *
+new_plural_file (const gchar *plural_forms)
+{
+        g_autofree gchar *header = NULL;
+        MoTestEntry plural_entries[] = {
+                MO_TEST_HEADER,
+                MO_TEST_ENTRY ("%d file\0%d files", "zero\0one\0two"),
+        };
+
+        header = g_strdup_printf ("Content-Type: text/plain; charset=UTF-8\n"
+                                  "Plural-Forms: %s\n",
+                                  plural_forms);
+        plural_entries[0].msgstr = header;
+        plural_entries[0].msgstr_length = strlen (header);
+
+        return mo_test_file_new (plural_entries, G_N_ELEMENTS (plural_entries), TRUE);
+}
+
+static const gchar *
+lookup_form (MoFile *mofile, gulong n)
+{
+        return mo_file_lookup_plural (mofile, "%d file", "%d files", n, NULL);
+}
+
+static void
+test_plural_forms (void)
+{
+        static const gchar slavic[] =
+                "nplurals=3; plural=n%10==1 && n%100!=11 ? 0 : "
+                "n%10>=2 && n%10<=4 && (n%100<10 || n%100>=20) ? 1 : 2;";
+        static const gchar *invalid[] = {
+                "nplurals=2; plural=n +;",
+                "nplurals=2; plural=(n != 1;",
+                "nplurals=0; plural=0;",
+                "nplurals=2;",
+        };
+        g_autoptr(GString) expression = g_string_new (NULL);
+        g_autoptr(MoFile) mofile = NULL;
+
+        mofile = new_plural_file (slavic);
+        g_assert_cmpuint (mo_file_get_n_plurals (mofile), ==, 3);
+        g_assert_cmpstr (lookup_form (mofile, 1), ==, "zero");
+        g_assert_cmpstr (lookup_form (mofile, 3), ==, "one");
+        g_assert_cmpstr (lookup_form (mofile, 5), ==, "two");
+        g_assert_cmpstr (lookup_form (mofile, 11), ==, "two");
+        g_assert_cmpstr (lookup_form (mofile, 22), ==, "one");
+        /* Beyond the precomputed table */
+        g_assert_cmpstr (lookup_form (mofile, 1000001), ==, "zero");
+        g_assert_cmpstr (lookup_form (mofile, 1000011), ==, "two");
+        g_clear_object (&mofile);
+
+        /* Dividing by zero gives zero, and an out of range form is taken to
+         * be the first */
+        mofile = new_plural_file ("nplurals=2; plural=n / (n - 2) + 1;");
+        g_assert_cmpstr (lookup_form (mofile, 2), ==, "one");
+        g_assert_cmpstr (lookup_form (mofile, 3), ==, "zero");
+        g_clear_object (&mofile);
+
+        /* Anything which can't be understood gets the Germanic rule */
+        for (guint i = 0; i < G_N_ELEMENTS (invalid); ++i) {
+                mofile = new_plural_file (invalid[i]);
+                g_assert_cmpstr (mo_file_get_plural_expression (mofile), ==, "(n != 1)");
+                g_assert_cmpstr (lookup_form (mofile, 1), ==, "zero");
+                g_assert_cmpstr (lookup_form (mofile, 0), ==, "one");
+                g_clear_object (&mofile);
+        }
+
+        /* as does nesting too deep to evaluate */
+        g_string_assign (expression, "nplurals=2; plural=");
+        for (guint i = 0; i < 1000; ++i)
+                g_string_append_c (expression, '(');
+        g_string_append_c (expression, 'n');
+        for (guint i = 0; i < 1000; ++i)
+                g_string_append_c (expression, ')');
+        g_string_append_c (expression, ';');
+
+        mofile = new_plural_file (expression->str);
+        g_assert_cmpstr (mo_file_get_plural_expression (mofile), ==, "(n != 1)");
+        g_clear_object (&mofile);
+
+        g_string_assign (expression, "nplurals=2; plural=");
+        for (guint i = 0; i < 40; ++i)
+                g_string_append (expression, "n+(");
+        g_string_append_c (expression, 'n');
+        for (guint i = 0; i < 40; ++i)
+                g_string_append_c (expression, ')');
+        g_string_append_c (expression, ';');
+
+        mofile = new_plural_file (expression->str);
+        g_assert_cmpstr (mo_file_get_plural_expression (mofile), ==, "(n != 1)");
+        g_clear_object (&mofile);
+
+        /* A long run of negations mustn't exhaust the stack */
+        g_string_assign (expression, "nplurals=2; plural=");
+        for (guint i = 0; i < 2000000; ++i)
+                g_string_append_c (expression, '!');
+        g_string_append (expression, "n;");
+
+        mofile = new_plural_file (expression->str);
+        g_assert_cmpstr (lookup_form (mofile, 0), ==, "zero");
+        g_assert_cmpstr (lookup_form (mofile, 5), ==, "one");
+        g_clear_object (&mofile);
+
+        mofile = new_plural_file ("nplurals=2; plural=!!!n;");
+        g_assert_cmpstr (lookup_form (mofile, 0), ==, "one");
+        g_assert_cmpstr (lookup_form (mofile, 2), ==, "zero");
+}
+
+static MoFile *
+new_converting_file (GBytes *bytes, const gchar *target_charset, GError **error)
+{
+        return g_initable_new (MO_TYPE_FILE,
+                               NULL,
+                               error,
+                               "bytes", bytes,
+                               "target-charset", target_charset,
+                               NULL);
+}
+
+static void
+test_convert (void)
+{
+        const MoTestEntry latin1_entries[] = {
+                MO_TEST_ENTRY ("", "Content-Type: text/plain; charset=ISO-8859-1\n"),
+                MO_TEST_ENTRY ("Open", "\326ffnen"),
+        };
+        const MoTestEntry template_entries[] = {
+                MO_TEST_ENTRY ("", "Content-Type: text/plain; charset=CHARSET\n"),
+                MO_TEST_ENTRY ("Open", "Open"),
+        };
+        g_autoptr(GBytes) latin1 = NULL;
+        g_autoptr(GBytes) template = NULL;
+        g_autoptr(MoFile) mofile = NULL;
+        GError *error = NULL;
+
+        latin1 = mo_test_build (latin1_entries, G_N_ELEMENTS (latin1_entries), TRUE);
+        mofile = new_converting_file (latin1, "UTF-8", &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (mo_file_lookup_translation (mofile, "Open", NULL), ==, "Öffnen");
+        g_clear_object (&mofile);
+
+        /* A template is read as it is */
+        template = mo_test_build (template_entries, G_N_ELEMENTS (template_entries), TRUE);
+        mofile = new_converting_file (template, "UTF-8", &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (mo_file_lookup_translation (mofile, "Open", NULL), ==, "Open");
+        g_clear_object (&mofile);
+
+        /* but a charset which can't be converted to is an error */
+        mofile = new_converting_file (latin1, "NO-SUCH-CHARSET", &error);
+        g_assert_error (error, MO_FILE_ERROR, MO_FILE_UNSUPPORTED_CHARSET_ERROR);
+        g_assert_null (mofile);
+        g_clear_error (&error);
+}
+
+static void
+put_word (GByteArray *data, gsize offset, guint32 value)
+{
+        memcpy (data->data + offset, &value, sizeof (value));
+}
+
+static guint32
+append_words (GByteArray *data, const guint32 *words, gsize n_words)
+{
+        guint32 offset = data->len;
+
+        g_byte_array_append (data, (const guint8 *) words, n_words * sizeof (guint32));
+
+        return offset;
+}
+
+static guint32
+append_bytes (GByteArray *data, const gchar *str, gsize length)
+{
+        guint32 offset = data->len;
+
+        g_byte_array_append (data, (const guint8 *) str, length);
+
+        return offset;
+}
+
+/*
+ * Build a revision 1 file with one static entry, the header, and two
+ * system dependent ones: "%<PRIu64> file", and one using a segment which
+ * isn't known, so is left out.
+ */
+static GBytes *
+build_sysdep_file (void)
+{
+        static const gchar header[] = "Content-Type: text/plain; charset=UTF-8\n";
+        GByteArray *data = g_byte_array_new ();
+        guint32 segments[4], strings[4], descriptor[5];
+        guint32 orig_tab, trans_tab;
+        guint32 static_part, string;
+
+        /* The header, and where the sysdep tables go, filled in below */
+        g_byte_array_set_size (data, 48);
+        memset (data->data, 0, data->len);
+        put_word (data, 0, 0x950412de);
+        put_word (data, 4, 1);
+        put_word (data, 8, 1);
+
+        segments[0] = sizeof ("PRIu64");
+        segments[1] = append_bytes (data, "PRIu64", sizeof ("PRIu64"));
+        segments[2] = sizeof ("FOO");
+        segments[3] = append_bytes (data, "FOO", sizeof ("FOO"));
+
+        /* Each string is its static parts, with a segment between them */
+        for (guint i = 0; i < 4; ++i) {
+                const gchar *rest = i % 2 ? " Datei" : " file";
+
+                static_part = append_bytes (data, "%", 1);
+                append_bytes (data, rest, strlen (rest) + 1);
+
+                descriptor[0] = static_part;
+                descriptor[1] = 1;
+                descriptor[2] = i < 2 ? 0 : 1;
+                descriptor[3] = strlen (rest) + 1;
+                descriptor[4] = G_MAXUINT32;
+                strings[i] = append_words (data, descriptor, G_N_ELEMENTS (descriptor));
+        }
+
+        string = append_bytes (data, "", 1);
+        orig_tab = append_words (data, (guint32[]) { 0, string }, 2);
+        string = append_bytes (data, header, sizeof (header));
+        trans_tab = append_words (data, (guint32[]) { sizeof (header) - 1, string }, 2);
+
+        put_word (data, 12, orig_tab);
+        put_word (data, 16, trans_tab);
+        put_word (data, 28, 2);
+        put_word (data, 32, append_words (data, segments, 4));
+        put_word (data, 36, 2);
+        put_word (data, 40, append_words (data, (guint32[]) { strings[0], strings[2] }, 2));
+        put_word (data, 44, append_words (data, (guint32[]) { strings[1], strings[3] }, 2));
+
+        return g_byte_array_free_to_bytes (data);
+}
+
+static void
+test_sysdep (void)
+{
+        g_autoptr(GBytes) bytes = build_sysdep_file ();
+        g_autoptr(GBytes) truncated = NULL;
+        g_autoptr(MoFile) mofile = NULL;
+        GError *error = NULL;
+
+        mofile = mo_file_new_from_bytes (bytes, &error);
+        g_assert_no_error (error);
+
+        g_assert_cmpstr (mo_file_lookup_translation (mofile, "%" PRIu64 " file", NULL),
+                         ==,
+                         "%" PRIu64 " Datei");
+        g_assert_null (mo_file_lookup_translation (mofile, "%<PRIu64> file", NULL));
+        g_assert_null (mo_file_lookup_translation (mofile, "% file", NULL));
+        g_assert_nonnull (mo_file_lookup_translation (mofile, "", NULL));
+        g_clear_object (&mofile);
+
+        /* Without the sysdep tables, which come last */
+        truncated = g_bytes_new_from_bytes (bytes, 0, g_bytes_get_size (bytes) - 8);
+        mofile = mo_file_new_from_bytes (truncated, &error);
+        g_assert_error (error, MO_FILE_ERROR, MO_FILE_INVALID_FILE_ERROR);
+        g_assert_null (mofile);
+        g_clear_error (&error);
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/file/lookup", test_lookup);
+        g_test_add_func ("/file/lookup-no-hash-table", test_lookup_no_hash_table);
+        g_test_add_func ("/file/lookup-index", test_lookup_index);
+        g_test_add_func ("/file/swapped", test_swapped);
+        g_test_add_func ("/file/validate", test_validate);
+        g_test_add_func ("/file/metadata", test_metadata);
+        g_test_add_func ("/file/iter", test_iter);
+        g_test_add_func ("/file/view", test_view);
+        g_test_add_func ("/file/search", test_search);
+        g_test_add_func ("/file/lookup-originals", test_lookup_originals);
+        g_test_add_func ("/file/plural-forms", test_plural_forms);
+        g_test_add_func ("/file/convert", test_convert);
+        g_test_add_func ("/file/sysdep", test_sysdep);
+
+        return g_test_run ();
+}
@@ -0,0 +1,393 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "mo-test-util.h"
+
+#include <string.h>
+
+static const MoTestEntry de_entries[] = {
+        MO_TEST_HEADER,
+        MO_TEST_ENTRY ("Open", "Öffnen"),
+        MO_TEST_ENTRY ("Close", "Schließen"),
+        MO_TEST_ENTRY ("menu\004Open", "Öffnen…"),
+        MO_TEST_ENTRY ("%d file\0%d files", "%d Datei\0%d Dateien"),
+};
+
+static const MoTestEntry fr_entries[] = {
+        MO_TEST_ENTRY ("", "Content-Type: text/plain; charset=UTF-8\n"
+                           "Plural-Forms: nplurals=2; plural=(n > 1);\n"),
+        MO_TEST_ENTRY ("Open", "Ouvrir"),
+        MO_TEST_ENTRY ("%d file\0%d files", "%d fichier\0%d fichiers"),
+};
+
+typedef struct {
+        gchar *directory;
+        MoGroup *group;
+} Fixture;
+
+static void
+fixture_set_up (Fixture *fixture, gconstpointer user_data)
+{
+        g_autoptr(GBytes) de = mo_test_build (de_entries, G_N_ELEMENTS (de_entries), TRUE);
+        g_autoptr(GBytes) fr = mo_test_build (fr_entries, G_N_ELEMENTS (fr_entries), FALSE);
+        g_autofree gchar *empty = NULL;
+        GError *error = NULL;
+
+        fixture->directory = g_dir_make_tmp ("libmo-test-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        g_free (mo_test_write_locale (fixture->directory, "fr", "test", fr));
+        g_free (mo_test_write_locale (fixture->directory, "de", "test", de));
+        g_free (mo_test_write_locale (fixture->directory, "de", "other", fr));
+
+        /* A locale without a file for the domain is left out */
+        empty = g_build_filename (fixture->directory, "it", "LC_MESSAGES", NULL);
+        g_assert_cmpint (g_mkdir_with_parents (empty, 0755), ==, 0);
+
+        fixture->group = mo_group_new_for_directory ("test",
+                                                     fixture->directory,
+                                                     &error);
+        g_assert_no_error (error);
+}
+
+static void
+fixture_tear_down (Fixture *fixture, gconstpointer user_data)
+{
+        g_clear_object (&fixture->group);
+        mo_test_remove_tree (fixture->directory);
+        g_free (fixture->directory);
+}
+
+static void
+check_group (MoGroup *group)
+{
+        const gchar *translations[2];
+        gsize lengths[2];
+        g_autoptr(GHashTable) all = NULL;
+
+        g_assert_cmpuint (mo_group_get_n_locales (group), ==, 2);
+
+        /* Handles are in order of name */
+        g_assert_cmpint (mo_group_get_locale_handle (group, "de"), ==, 0);
+        g_assert_cmpint (mo_group_get_locale_handle (group, "fr"), ==, 1);
+        g_assert_cmpint (mo_group_get_locale_handle (group, "it"), ==, -1);
+        g_assert_cmpstr (mo_group_get_locale_name (group, 1), ==, "fr");
+        g_assert_null (mo_group_get_locale_name (group, 2));
+
+        g_assert_cmpstr (mo_group_lookup_translation (group, 1, "Open", NULL),
+                         ==,
+                         "Ouvrir");
+        g_assert_null (mo_group_lookup_translation (group, 1, "Close", NULL));
+
+        g_assert_cmpuint (mo_group_lookup_translations (group,
+                                                        "Open",
+                                                        translations,
+                                                        lengths),
+                          ==,
+                          2);
+        g_assert_cmpstr (translations[0], ==, "Öffnen");
+        g_assert_cmpstr (translations[1], ==, "Ouvrir");
+        g_assert_cmpuint (lengths[1], ==, strlen ("Ouvrir"));
+
+        g_assert_cmpuint (mo_group_lookup_translations (group,
+                                                        "Close",
+                                                        translations,
+                                                        NULL),
+                          ==,
+                          1);
+        g_assert_null (translations[1]);
+
+        g_assert_cmpuint (mo_group_lookup_translations_with_context (group,
+                                                                     "menu",
+                                                                     "Open",
+                                                                     translations,
+                                                                     NULL),
+                          ==,
+                          1);
+        g_assert_cmpstr (translations[0], ==, "Öffnen…");
+
+        /* Each locale uses its own plural rule */
+        g_assert_cmpstr (mo_group_lookup_plural (group, 0, "%d file", "%d files", 0, NULL),
+                         ==,
+                         "%d Dateien");
+        g_assert_cmpstr (mo_group_lookup_plural (group, 1, "%d file", "%d files", 0, NULL),
+                         ==,
+                         "%d fichier");
+
+        all = mo_group_get_translations (group, "Open");
+        g_assert_cmpuint (g_hash_table_size (all), ==, 2);
+        g_assert_cmpstr (g_hash_table_lookup (all, "fr"), ==, "Ouvrir");
+}
+
+static void
+test_directory (Fixture *fixture, gconstpointer user_data)
+{
+        check_group (fixture->group);
+}
+
+static void
+test_lazy (Fixture *fixture, gconstpointer user_data)
+{
+        g_autoptr(MoGroup) group = NULL;
+        GError *error = NULL;
+        MoGroupStats stats;
+
+        group = g_initable_new (MO_TYPE_GROUP,
+                                NULL,
+                                &error,
+                                "domain", "test",
+                                "directory", fixture->directory,
+                                "lazy", TRUE,
+                                NULL);
+        g_assert_no_error (error);
+
+        mo_group_get_stats (group, &stats);
+        g_assert_cmpuint (stats.n_locales, ==, 2);
+        g_assert_cmpuint (stats.n_loaded, ==, 0);
+
+        check_group (group);
+
+        mo_group_get_stats (group, &stats);
+        g_assert_cmpuint (stats.n_loaded, ==, 2);
+}
+
+static void
+test_bundle (Fixture *fixture, gconstpointer user_data)
+{
+        g_autoptr(MoGroup) group = NULL;
+        g_autofree gchar *bundle = NULL;
+        GError *error = NULL;
+
+        bundle = g_build_filename (fixture->directory, "test.bundle", NULL);
+
+        g_assert_true (mo_group_write_bundle (fixture->group, bundle, &error));
+        g_assert_no_error (error);
+
+        group = mo_group_new_from_bundle (bundle, &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (mo_group_get_domain (group), ==, "test");
+
+        check_group (group);
+}
+
+static void
+test_view (Fixture *fixture, gconstpointer user_data)
+{
+        g_autoptr(MoView) view = NULL;
+        MoView *fr;
+        GError *error = NULL;
+
+        view = mo_group_get_translations_view (fixture->group, &error);
+        g_assert_no_error (error);
+        g_assert_cmpuint (mo_view_get_size (view), ==, 2);
+
+        fr = mo_view_lookup (view, "fr");
+        g_assert_nonnull (fr);
+        g_assert_cmpstr (mo_view_lookup (fr, "Open"), ==, "Ouvrir");
+
+        /* The views keep the group and its files alive */
+        g_clear_object (&fixture->group);
+        g_assert_cmpstr (mo_view_lookup (mo_view_lookup (view, "de"), "Close"),
+                         ==,
+                         "Schließen");
+}
+
+static void
+test_search (Fixture *fixture, gconstpointer user_data)
+{
+        g_autoptr(GArray) results = NULL;
+        MoSearchResult *result;
+
+        mo_group_build_search_index (fixture->group, MO_SEARCH_TRANSLATIONS);
+
+        results = mo_group_search (fixture->group, "fichier", 0, MO_SEARCH_TRANSLATIONS);
+        g_assert_cmpuint (results->len, ==, 1);
+
+        result = &g_array_index (results, MoSearchResult, 0);
+        g_assert_cmpuint (result->handle, ==, 1);
+}
+
+static void
+locale_changed_cb (MoGroup *group, const gchar *locale, gpointer user_data)
+{
+        guint *n_changes = user_data;
+
+        (*n_changes)++;
+}
+
+/*
+ * Iterate the main context until there has been at least one change, and no
+ * more for half a second, as one write can be seen more than once. Gives up
+ * after ten seconds.
+ */
+static void
+wait_for_changes (guint *n_changes)
+{
+        gint64 now = g_get_monotonic_time ();
+        gint64 end = now + 10 * G_USEC_PER_SEC;
+        gint64 quiet = now;
+        guint n_before = *n_changes;
+        guint n_seen = *n_changes;
+
+        while (now < end) {
+                if (*n_changes != n_seen) {
+                        n_seen = *n_changes;
+                        quiet = now;
+                } else if (n_seen > n_before &&
+                           now - quiet > G_USEC_PER_SEC / 2) {
+                        break;
+                }
+
+                if (!g_main_context_iteration (NULL, FALSE))
+                        g_usleep (10000);
+
+                now = g_get_monotonic_time ();
+        }
+
+        g_assert_cmpuint (*n_changes, >, n_before);
+}
+
+static void
+test_watch (Fixture *fixture, gconstpointer user_data)
+{
+        g_autoptr(GBytes) de = mo_test_build (de_entries, G_N_ELEMENTS (de_entries), TRUE);
+        g_autoptr(GBytes) fr = mo_test_build (fr_entries, G_N_ELEMENTS (fr_entries), FALSE);
+        g_autoptr(MoGroup) group = NULL;
+        const gchar *borrowed;
+        GError *error = NULL;
+        MoGroupStats stats;
+        guint n_changes = 0;
+
+        group = g_initable_new (MO_TYPE_GROUP,
+                                NULL,
+                                &error,
+                                "domain", "test",
+                                "directory", fixture->directory,
+                                "lazy", TRUE,
+                                "watch", TRUE,
+                                NULL);
+        g_assert_no_error (error);
+
+        g_signal_connect (group,
+                          "locale-changed",
+                          G_CALLBACK (locale_changed_cb),
+                          &n_changes);
+
+        /* A locale which has never been loaded takes the reloaded file */
+        g_free (mo_test_write_locale (fixture->directory, "de", "test", fr));
+        wait_for_changes (&n_changes);
+        g_assert_cmpuint (n_changes, ==, 1);
+
+        borrowed = mo_group_lookup_translation (group, 0, "Open", NULL);
+        g_assert_cmpstr (borrowed, ==, "Ouvrir");
+
+        /* Each replacement is reloaded once, and every replaced file is kept
+         * until mo_group_update() */
+        for (guint i = 0; i < 3; ++i) {
+                g_free (mo_test_write_locale (fixture->directory,
+                                              "de",
+                                              "test",
+                                              i % 2 ? fr : de));
+                wait_for_changes (&n_changes);
+                g_assert_cmpuint (n_changes, ==, i + 2);
+        }
+
+        mo_group_get_stats (group, &stats);
+        g_assert_cmpuint (stats.n_retired, ==, 3);
+        g_assert_cmpstr (borrowed, ==, "Ouvrir");
+        g_assert_cmpstr (mo_group_lookup_translation (group, 0, "Open", NULL),
+                         ==,
+                         "Öffnen");
+
+        g_assert_cmpuint (mo_group_update (group), ==, 0);
+
+        mo_group_get_stats (group, &stats);
+        g_assert_cmpuint (stats.n_retired, ==, 0);
+}
+
+static void
+test_watch_new_locale (Fixture *fixture, gconstpointer user_data)
+{
+        g_autoptr(GBytes) fr = mo_test_build (fr_entries, G_N_ELEMENTS (fr_entries), FALSE);
+        g_autoptr(MoGroup) group = NULL;
+        GError *error = NULL;
+        MoGroupStats stats;
+        guint n_changes = 0;
+
+        group = g_initable_new (MO_TYPE_GROUP,
+                                NULL,
+                                &error,
+                                "domain", "test",
+                                "directory", fixture->directory,
+                                "watch", TRUE,
+                                NULL);
+        g_assert_no_error (error);
+
+        g_signal_connect (group,
+                          "locale-changed",
+                          G_CALLBACK (locale_changed_cb),
+                          &n_changes);
+
+        /* Into the existing LC_MESSAGES directory, and a new locale's */
+        g_free (mo_test_write_locale (fixture->directory, "it", "test", fr));
+        wait_for_changes (&n_changes);
+        g_free (mo_test_write_locale (fixture->directory, "pt", "test", fr));
+        wait_for_changes (&n_changes);
+
+        mo_group_get_stats (group, &stats);
+        g_assert_cmpuint (stats.n_pending, ==, 2);
+        g_assert_cmpuint (mo_group_get_n_locales (group), ==, 2);
+
+        /* New locales' handles follow on from the existing ones */
+        g_assert_cmpuint (mo_group_update (group), ==, 2);
+        g_assert_cmpuint (mo_group_get_n_locales (group), ==, 4);
+        g_assert_cmpint (mo_group_get_locale_handle (group, "de"), ==, 0);
+        g_assert_cmpstr (mo_group_lookup_translation (group,
+                                                      mo_group_get_locale_handle (group, "pt"),
+                                                      "Open",
+                                                      NULL),
+                         ==,
+                         "Ouvrir");
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add ("/group/directory", Fixture, NULL,
+                    fixture_set_up, test_directory, fixture_tear_down);
+        g_test_add ("/group/lazy", Fixture, NULL,
+                    fixture_set_up, test_lazy, fixture_tear_down);
+        g_test_add ("/group/bundle", Fixture, NULL,
+                    fixture_set_up, test_bundle, fixture_tear_down);
+        g_test_add ("/group/view", Fixture, NULL,
+                    fixture_set_up, test_view, fixture_tear_down);
+        g_test_add ("/group/search", Fixture, NULL,
+                    fixture_set_up, test_search, fixture_tear_down);
+        g_test_add ("/group/watch", Fixture, NULL,
+                    fixture_set_up, test_watch, fixture_tear_down);
+        g_test_add ("/group/watch-new-locale", Fixture, NULL,
+                    fixture_set_up, test_watch_new_locale, fixture_tear_down);
+
+        return g_test_run ();
+}
@@ -0,0 +1,233 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2016 Iain Lane <iain@orangesquash.org.uk>
+ *
+ * Licensed under the GNU Lesser General Public License Version 3
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "mo-test-util.h"
+
+#include <string.h>
+
+/*
+ * Many threads querying one shared #MoFile, with caches small enough that
+ * they are evicting all of the time, and one lazy #MoGroup whose files are
+ * loaded by whichever thread gets to them first.
+ */
+
+#define N_STRINGS 2000
+#define N_MISSING 500
+#define N_THREADS 8
+#define N_ITERATIONS 20000
+#define BATCH_SIZE 16
+
+static gchar *msgids[N_STRINGS + N_MISSING];
+static gchar *msgstrs[N_STRINGS];
+
+/* Each thread's own, so that runs are repeatable */
+static gint seed;
+
+static GBytes *
+build_strings (void)
+{
+        g_autofree MoTestEntry *entries = g_new (MoTestEntry, N_STRINGS + 1);
+        const MoTestEntry header = MO_TEST_HEADER;
+
+        entries[0] = header;
+
+        for (guint i = 0; i < N_STRINGS; ++i) {
+                entries[i + 1].msgid = msgids[i];
+                entries[i + 1].msgid_length = strlen (msgids[i]);
+                entries[i + 1].msgstr = msgstrs[i];
+                entries[i + 1].msgstr_length = strlen (msgstrs[i]);
+        }
+
+        return mo_test_build (entries, N_STRINGS + 1, TRUE);
+}
+
+static gpointer
+file_thread (gpointer data)
+{
+        MoFile *mofile = data;
+        const gchar *strs[BATCH_SIZE];
+        const gchar *translations[BATCH_SIZE];
+        guint indexes[BATCH_SIZE];
+        g_autoptr(GRand) rand = g_rand_new_with_seed (g_atomic_int_add (&seed, 1));
+        gchar *translation;
+        guint n;
+
+        for (guint i = 0; i < N_ITERATIONS; ++i) {
+                n = g_rand_int_range (rand, 0, N_STRINGS + N_MISSING);
+                translation = mo_file_get_translation (mofile, msgids[n], NULL);
+
+                if (n < N_STRINGS)
+                        g_assert_cmpstr (translation, ==, msgstrs[n]);
+                else
+                        g_assert_null (translation);
+
+                g_free (translation);
+
+                if (i % BATCH_SIZE)
+                        continue;
+
+                for (guint j = 0; j < BATCH_SIZE; ++j) {
+                        indexes[j] = (n + j * 97) % (N_STRINGS + N_MISSING);
+                        strs[j] = msgids[indexes[j]];
+                }
+
+                mo_file_lookup_translations (mofile,
+                                             strs,
+                                             BATCH_SIZE,
+                                             translations,
+                                             NULL);
+
+                for (guint j = 0; j < BATCH_SIZE; ++j) {
+                        if (indexes[j] < N_STRINGS)
+                                g_assert_cmpstr (translations[j], ==, msgstrs[indexes[j]]);
+                        else
+                                g_assert_null (translations[j]);
+                }
+        }
+
+        return NULL;
+}
+
+static void
+test_shared_file (void)
+{
+        g_autoptr(GBytes) bytes = build_strings ();
+        g_autoptr(MoFile) mofile = NULL;
+        GThread *threads[N_THREADS];
+        GError *error = NULL;
+        MoFileStats stats;
+
+        mofile = g_initable_new (MO_TYPE_FILE,
+                                 NULL,
+                                 &error,
+                                 "bytes", bytes,
+                                 "cache-size", 64,
+                                 "negative-cache-size", 16,
+                                 NULL);
+        g_assert_no_error (error);
+
+        for (guint i = 0; i < N_THREADS; ++i)
+                threads[i] = g_thread_new ("file", file_thread, mofile);
+
+        for (guint i = 0; i < N_THREADS; ++i)
+                g_thread_join (threads[i]);
+
+        mo_file_get_stats (mofile, &stats);
+        g_assert_cmpuint (stats.arena_used, <=, stats.arena_size);
+}
+
+static gpointer
+group_thread (gpointer data)
+{
+        MoGroup *group = data;
+        g_autoptr(GRand) rand = g_rand_new_with_seed (g_atomic_int_add (&seed, 1));
+        guint n_locales = mo_group_get_n_locales (group);
+        g_autofree const gchar **translations = g_new (const gchar *, n_locales);
+        const gchar *translation;
+        guint n;
+
+        for (guint i = 0; i < N_ITERATIONS / 4; ++i) {
+                n = g_rand_int_range (rand, 0, N_STRINGS);
+                translation = mo_group_lookup_translation (group,
+                                                          n % n_locales,
+                                                          msgids[n],
+                                                          NULL);
+                g_assert_cmpstr (translation, ==, msgstrs[n]);
+
+                g_assert_cmpuint (mo_group_lookup_translations (group,
+                                                                msgids[n],
+                                                                translations,
+                                                                NULL),
+                                  ==,
+                                  n_locales);
+        }
+
+        return NULL;
+}
+
+static void
+test_lazy_group (void)
+{
+        const gchar *locales[] = { "de", "fr", "it", "nl" };
+        g_autoptr(GBytes) bytes = build_strings ();
+        g_autoptr(MoGroup) group = NULL;
+        g_autofree gchar *directory = NULL;
+        GThread *threads[N_THREADS];
+        GError *error = NULL;
+        MoGroupStats stats;
+
+        directory = g_dir_make_tmp ("libmo-test-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        for (guint i = 0; i < G_N_ELEMENTS (locales); ++i)
+                g_free (mo_test_write_locale (directory, locales[i], "test", bytes));
+
+        group = g_initable_new (MO_TYPE_GROUP,
+                                NULL,
+                                &error,
+                                "domain", "test",
+                                "directory", directory,
+                                "lazy", TRUE,
+                                NULL);
+        g_assert_no_error (error);
+
+        mo_group_get_stats (group, &stats);
+        g_assert_cmpuint (stats.n_loaded, ==, 0);
+
+        for (guint i = 0; i < N_THREADS; ++i)
+                threads[i] = g_thread_new ("group", group_thread, group);
+
+        for (guint i = 0; i < N_THREADS; ++i)
+                g_thread_join (threads[i]);
+
+        mo_group_get_stats (group, &stats);
+        g_assert_cmpuint (stats.n_loaded, ==, G_N_ELEMENTS (locales));
+
+        mo_test_remove_tree (directory);
+}
+
+int
+main (int argc, char *argv[])
+{
+        gint ret;
+
+        g_test_init (&argc, &argv, NULL);
+
+        for (guint i = 0; i < N_STRINGS + N_MISSING; ++i)
+                msgids[i] = g_strdup_printf ("message %u", i);
+
+        for (guint i = 0; i < N_STRINGS; ++i)
+                msgstrs[i] = g_strdup_printf ("Nachricht %u", i);
+
+        g_test_add_func ("/threads/shared-file", test_shared_file);
+        g_test_add_func ("/threads/lazy-group", test_lazy_group);
+
+        ret = g_test_run ();
+
+        for (guint i = 0; i < N_STRINGS + N_MISSING; ++i)
+                g_free (msgids[i]);
+
+        for (guint i = 0; i < N_STRINGS; ++i)
+                g_free (msgstrs[i]);
+
+        return ret;
+}